@@ -0,0 +1,319 @@
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QThreadPool>
+#include <QtEndian>
+#include <QDebug>
+
+#include <limits>
+
+#include "archiveindex.h"
+#include "ioscheduler.h"
+
+
+static const QStringList zipSuffixes = {".zip", ".jar"};
+static const QStringList tarSuffixes = {".tar"};
+static const QStringList compressedTarSuffixes = {".tar.gz", ".tgz", ".tar.bz2", ".tbz2", ".tar.xz", ".txz",
+                                                  ".tar.zst"};
+
+static bool hasSuffix(const QString& path, const QStringList& suffixes) {
+    for (const QString& suffix: suffixes) {
+        if (path.endsWith(suffix, Qt::CaseInsensitive)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Directories are listed as members too, with a trailing slash that the
+// name search does not want. Anything else is kept as stored, since the
+// name is handed back to the tools to extract the member.
+static QString memberName(QString name) {
+    while (name.endsWith('/')) {
+        name.chop(1);
+    }
+    return name;
+}
+
+
+bool ArchiveIndex::isArchive(const QString& path) {
+    return hasSuffix(path, zipSuffixes) || hasSuffix(path, tarSuffixes) || hasSuffix(path, compressedTarSuffixes);
+}
+
+bool ArchiveIndex::list(const QString& archivePath, QStringList& members) {
+    if (hasSuffix(archivePath, zipSuffixes)) {
+        return listZip(archivePath, members);
+    }
+    if (hasSuffix(archivePath, tarSuffixes)) {
+        return listTar(archivePath, members);
+    }
+    return listWithTool(archivePath, members);
+}
+
+QStringList ArchiveIndex::findMembers(const QStringList& archivePaths, const QString& term) {
+    QStringList found;
+    if (archivePaths.isEmpty()) {
+        return found;
+    }
+
+    QMutex mutex;
+    QThreadPool pool;
+    pool.setMaxThreadCount(IoScheduler::instance().device(archivePaths.first()).concurrency);
+    for (const QString& archivePath: archivePaths) {
+        pool.start([archivePath, &term, &found, &mutex]() {
+            QStringList members;
+            if (!list(archivePath, members)) {
+                qWarning() << "Could not read archive:" << archivePath;
+                return;
+            }
+            QStringList matches;
+            for (const QString& member: members) {
+                if (member.mid(member.lastIndexOf('/') + 1).contains(term, Qt::CaseInsensitive)) {
+                    matches.append(memberPath(archivePath, member));
+                }
+            }
+            QMutexLocker locker(&mutex);
+            found.append(matches);
+        });
+    }
+    pool.waitForDone();
+    found.sort();
+    return found;
+}
+
+QString ArchiveIndex::memberPath(const QString& archivePath, const QString& member) {
+    return archivePath + separator + member;
+}
+
+bool ArchiveIndex::splitMemberPath(const QString& path, QString& archivePath, QString& member) {
+    // A directory name may end in "!" as well; the archive is the first
+    // prefix that is one.
+    for (int at = path.indexOf(separator); at >= 0; at = path.indexOf(separator, at + 1)) {
+        const QString candidate = path.left(at);
+        if (isArchive(candidate) && QFileInfo(candidate).isFile()) {
+            archivePath = candidate;
+            member = path.mid(at + int(qstrlen(separator)));
+            return !member.isEmpty();
+        }
+    }
+    return false;
+}
+
+bool ArchiveIndex::extractMember(const QString& archivePath, const QString& member, const QString& destinationPath) {
+    // Member names come from the archive, so none may be taken for an
+    // option. unzip has no "--", and reads options after the archive too.
+    const bool zip = hasSuffix(archivePath, zipSuffixes);
+    if (zip && member.startsWith('-')) {
+        qWarning() << "Refusing to extract" << member << "from" << archivePath;
+        return false;
+    }
+
+    QProcess process;
+    process.setStandardOutputFile(destinationPath);
+    if (zip) {
+        // unzip takes member names as patterns.
+        QString pattern;
+        for (const QChar character: member) {
+            pattern += character == '[' || character == '*' || character == '?' ? QString("[%1]").arg(character)
+                                                                               : QString(character);
+        }
+        process.start("unzip", QStringList() << "-p" << archivePath << pattern);
+    } else {
+        process.start("tar", QStringList() << "-xOf" << archivePath << "--" << member);
+    }
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        qWarning() << "Could not extract" << member << "from" << archivePath << "-"
+                   << process.readAllStandardError().trimmed();
+        QFile::remove(destinationPath);
+        return false;
+    }
+    return true;
+}
+
+bool ArchiveIndex::listZip(const QString& archivePath, QStringList& members) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // The end of central directory record sits in the last 64 KiB + 22
+    // bytes, behind an archive comment of unknown length.
+    const qint64 tailSize = qMin<qint64>(file.size(), 65535 + 22);
+    if (tailSize < 22 || !file.seek(file.size() - tailSize)) {
+        return false;
+    }
+    const QByteArray tail = file.read(tailSize);
+    const int end = tail.lastIndexOf(QByteArray("PK\x05\x06", 4));
+    if (end < 0 || tail.size() - end < 22) {
+        return false;
+    }
+    const uchar* record = reinterpret_cast<const uchar*>(tail.constData()) + end;
+    quint64 entries = qFromLittleEndian<quint16>(record + 10);
+    quint64 directorySize = qFromLittleEndian<quint32>(record + 12);
+    quint64 directoryOffset = qFromLittleEndian<quint32>(record + 16);
+
+    // Archives past 4 GiB or 65535 members keep the real numbers in a
+    // ZIP64 record, found through a locator right before this one.
+    if ((entries == 0xffff || directorySize == 0xffffffff || directoryOffset == 0xffffffff) && end >= 20
+        && tail.mid(end - 20, 4) == QByteArray("PK\x06\x07", 4)) {
+        const quint64 zip64Offset = qFromLittleEndian<quint64>(record - 20 + 8);
+        if (!file.seek(qint64(zip64Offset))) {
+            return false;
+        }
+        const QByteArray zip64 = file.read(56);
+        if (zip64.size() < 56 || !zip64.startsWith(QByteArray("PK\x06\x06", 4))) {
+            return false;
+        }
+        const uchar* zip64Record = reinterpret_cast<const uchar*>(zip64.constData());
+        entries = qFromLittleEndian<quint64>(zip64Record + 32);
+        directorySize = qFromLittleEndian<quint64>(zip64Record + 40);
+        directoryOffset = qFromLittleEndian<quint64>(zip64Record + 48);
+    }
+
+    if (directorySize > quint64(file.size()) || directoryOffset > quint64(file.size()) - directorySize
+        || !file.seek(qint64(directoryOffset))) {
+        return false;
+    }
+    const QByteArray directory = file.read(qint64(directorySize));
+    const uchar* data = reinterpret_cast<const uchar*>(directory.constData());
+    qint64 position = 0;
+    for (quint64 i = 0; i < entries; ++i) {
+        if (position + 46 > directory.size() || qFromLittleEndian<quint32>(data + position) != 0x02014b50) {
+            return false;
+        }
+        const quint16 flags = qFromLittleEndian<quint16>(data + position + 8);
+        const int nameLength = qFromLittleEndian<quint16>(data + position + 28);
+        const int extraLength = qFromLittleEndian<quint16>(data + position + 30);
+        const int commentLength = qFromLittleEndian<quint16>(data + position + 32);
+        if (position + 46 + nameLength > directory.size()) {
+            return false;
+        }
+        const char* name = directory.constData() + position + 46;
+        // Bit 11 marks UTF-8 names; older archives use the system's code page.
+        const QString member = memberName(flags & 0x800 ? QString::fromUtf8(name, nameLength)
+                                                        : QString::fromLocal8Bit(name, nameLength));
+        if (!member.isEmpty()) {
+            members.append(member);
+        }
+        position += 46 + nameLength + extraLength + commentLength;
+    }
+    return true;
+}
+
+// Numeric tar fields are octal text, or big-endian binary when the first
+// byte has its high bit set. Negative numbers and ones too large for a
+// qint64 come back as -1.
+static qint64 tarNumber(const char* field, int length) {
+    if (uchar(field[0]) & 0x80) {
+        if (uchar(field[0]) & 0x40) {
+            return -1;
+        }
+        qint64 value = uchar(field[0]) & 0x3f;
+        for (int i = 1; i < length; ++i) {
+            if (value > (std::numeric_limits<qint64>::max() >> 8)) {
+                return -1;
+            }
+            value = (value << 8) | uchar(field[i]);
+        }
+        return value;
+    }
+    return QByteArray(field, length).replace('\0', ' ').trimmed().toLongLong(nullptr, 8);
+}
+
+// Long names and pax headers are read whole; real ones are a few KiB.
+static const qint64 maxRecordSize = 1 << 20;
+
+static QByteArray tarString(const char* field, int length) {
+    return QByteArray(field, int(qstrnlen(field, uint(length))));
+}
+
+bool ArchiveIndex::listTar(const QString& archivePath, QStringList& members) {
+    QFile file(archivePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QByteArray longName;
+    qint64 position = 0;
+    forever {
+        if (!file.seek(position)) {
+            return false;
+        }
+        const QByteArray header = file.read(512);
+        if (header.size() < 512) {
+            return header.isEmpty();
+        }
+        const char* block = header.constData();
+        // An empty block marks the end.
+        if (block[0] == '\0') {
+            return true;
+        }
+
+        // The checksum is the byte sum with its own field read as spaces.
+        qint64 sum = 8 * ' ';
+        for (int i = 0; i < 512; ++i) {
+            sum += i >= 148 && i < 156 ? 0 : uchar(block[i]);
+        }
+        if (sum != tarNumber(block + 148, 8)) {
+            return false;
+        }
+
+        // The header is not trusted: the data must lie within the file, and
+        // names are kept to a sane length.
+        const qint64 size = tarNumber(block + 124, 12);
+        if (size < 0 || size > file.size() - position - 512) {
+            return false;
+        }
+        const char type = block[156];
+        if ((type == 'L' || type == 'x') && size > maxRecordSize) {
+            return false;
+        }
+        if (type == 'L' || type == 'x') {
+            // GNU long names and pax headers name the member that follows.
+            const QByteArray data = file.read(size);
+            if (type == 'L') {
+                longName = tarString(data.constData(), int(data.size()));
+            } else {
+                for (const QByteArray& record: data.split('\n')) {
+                    const int key = record.indexOf(" path=");
+                    if (key > 0) {
+                        longName = record.mid(key + 6);
+                    }
+                }
+            }
+        } else if (type != 'K' && type != 'g') {
+            QByteArray name = longName;
+            if (name.isEmpty()) {
+                name = tarString(block, 100);
+                const QByteArray prefix = tarString(block + 345, 155);
+                if (header.mid(257, 5) == "ustar" && !prefix.isEmpty()) {
+                    name = prefix + "/" + name;
+                }
+            }
+            const QString member = memberName(QString::fromUtf8(name));
+            if (!member.isEmpty() && member != ".") {
+                members.append(member);
+            }
+            longName.clear();
+        }
+        position += 512 + (size + 511) / 512 * 512;
+    }
+}
+
+bool ArchiveIndex::listWithTool(const QString& archivePath, QStringList& members) {
+    QProcess process;
+    process.start("tar", QStringList() << "-tf" << archivePath);
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        return false;
+    }
+    const QList<QByteArray> lines = process.readAllStandardOutput().split('\n');
+    for (const QByteArray& line: lines) {
+        const QString member = memberName(QString::fromUtf8(line));
+        if (!member.isEmpty()) {
+            members.append(member);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef ARCHIVEINDEX_H
+#define ARCHIVEINDEX_H
+
+#include <QString>
+#include <QStringList>
+
+// Looks into zip and tar archives without extracting them.
+//
+// The member list of a zip is read from its central directory at the end
+// of the file, and that of an uncompressed tar by hopping from header to
+// header past the data; neither reads any member data. A compressed tar
+// has no index, so it is listed by streaming it through "tar -t", which
+// decompresses but writes nothing. A single member is extracted by
+// streaming just that member out of the archive.
+//
+// Members are named "archive.zip!/path/in/archive".
+class ArchiveIndex {
+public:
+    static constexpr const char* separator = "!/";
+
+    static bool isArchive(const QString& path);
+    static bool list(const QString& archivePath, QStringList& members);
+
+    // Members of any of the archives whose file name contains term. The
+    // archives are read in parallel.
+    static QStringList findMembers(const QStringList& archivePaths, const QString& term);
+
+    static QString memberPath(const QString& archivePath, const QString& member);
+    static bool splitMemberPath(const QString& path, QString& archivePath, QString& member);
+    static bool extractMember(const QString& archivePath, const QString& member, const QString& destinationPath);
+
+private:
+    static bool listZip(const QString& archivePath, QStringList& members);
+    static bool listTar(const QString& archivePath, QStringList& members);
+    static bool listWithTool(const QString& archivePath, QStringList& members);
+};
+
+#endif // ARCHIVEINDEX_H
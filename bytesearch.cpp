@@ -0,0 +1,149 @@
+#include <QThread>
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BYTESEARCH_HAVE_SSE2
+#endif
+
+#include "bytesearch.h"
+#include "mappedfile.h"
+
+
+ByteSearch::ByteSearch(QObject *parent)
+        : QObject(parent),
+          from(0),
+          worker(nullptr),
+          cancelled(false) {
+}
+
+ByteSearch::~ByteSearch() {
+    cancel();
+}
+
+void ByteSearch::start(const QString& path, const QByteArray& searchPattern, qint64 startOffset) {
+    cancel();
+
+    filePath = path;
+    pattern = searchPattern.left(maxPatternSize);
+    from = startOffset;
+
+    worker = QThread::create([this]() { run(); });
+    worker->start(QThread::LowPriority);
+}
+
+void ByteSearch::cancel() {
+    if (!worker) {
+        return;
+    }
+    cancelled = true;
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    cancelled = false;
+}
+
+qint64 ByteSearch::find(const uchar* data, qint64 length, const QByteArray& pattern) {
+    const qint64 patternSize = pattern.size();
+    if (patternSize == 0 || length < patternSize) {
+        return -1;
+    }
+
+    const uchar* needle = reinterpret_cast<const uchar*>(pattern.constData());
+    const qint64 lastStart = length - patternSize;
+    qint64 i = 0;
+
+#ifdef BYTESEARCH_HAVE_SSE2
+    // Test 16 candidate positions at once by comparing both the first and
+    // the last byte of the pattern; only positions where both match are
+    // compared in full.
+    if (patternSize > 1) {
+        const __m128i first = _mm_set1_epi8(char(needle[0]));
+        const __m128i last = _mm_set1_epi8(char(needle[patternSize - 1]));
+        for (; i + 15 <= lastStart; i += 16) {
+            const __m128i head = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i tail = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + patternSize - 1));
+            uint mask = uint(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first),
+                                                             _mm_cmpeq_epi8(tail, last))));
+            while (mask) {
+                const qint64 candidate = i + qCountTrailingZeroBits(mask);
+                if (std::memcmp(data + candidate + 1, needle + 1, patternSize - 2) == 0) {
+                    return candidate;
+                }
+                mask &= mask - 1;
+            }
+        }
+    }
+#endif
+
+    // memchr on the first byte covers the tail, single-byte patterns and
+    // platforms without SSE2.
+    while (i <= lastStart) {
+        const void* hit = std::memchr(data + i, needle[0], lastStart - i + 1);
+        if (!hit) {
+            break;
+        }
+        const qint64 candidate = static_cast<const uchar*>(hit) - data;
+        if (std::memcmp(data + candidate, needle, patternSize) == 0) {
+            return candidate;
+        }
+        i = candidate + 1;
+    }
+    return -1;
+}
+
+void ByteSearch::run() {
+    MappedFile file;
+    if (pattern.isEmpty() || !file.open(filePath)) {
+        emit notFound();
+        return;
+    }
+
+    qint64 scanned = 0;
+    const qint64 start = qBound<qint64>(0, from, file.size());
+    qint64 offset = scan(file, start, file.size(), scanned);
+    if (offset < 0 && start > 0) {
+        offset = scan(file, 0, start, scanned);
+    }
+
+    if (cancelled) {
+        return;
+    }
+    if (offset >= 0) {
+        emit found(offset);
+    } else {
+        emit notFound();
+    }
+}
+
+// Returns the first match that starts in [begin, end), or -1.
+qint64 ByteSearch::scan(MappedFile& file, qint64 begin, qint64 end, qint64& scanned) {
+    const qint64 overlap = pattern.size() - 1;
+    qint64 position = begin;
+
+    while (position < end && !cancelled) {
+        const qint64 length = qMin(MappedFile::windowSize, file.size() - position);
+        if (length <= overlap) {
+            break;
+        }
+        const uchar* data = file.map(position, length);
+        if (!data) {
+            break;
+        }
+
+        const qint64 hit = find(data, length, pattern);
+        if (hit >= 0) {
+            return position + hit < end ? position + hit : -1;
+        }
+        if (position + length >= file.size()) {
+            break;
+        }
+
+        scanned += length - overlap;
+        emit progress(scanned, file.size());
+        position += length - overlap;
+    }
+    return -1;
+}
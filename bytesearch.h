@@ -0,0 +1,48 @@
+#ifndef BYTESEARCH_H
+#define BYTESEARCH_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+
+#include <atomic>
+
+class QThread;
+class MappedFile;
+
+// Searches a file of any size for a byte pattern on a background thread.
+//
+// The file is scanned one mapped window at a time, with consecutive windows
+// overlapping by the pattern length, so memory use does not depend on the
+// file size. The search starts at a given offset and wraps around once.
+class ByteSearch : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int maxPatternSize = 4096;
+
+    explicit ByteSearch(QObject *parent = nullptr);
+    ~ByteSearch();
+
+    void start(const QString& path, const QByteArray& pattern, qint64 from);
+    void cancel();
+
+    static qint64 find(const uchar* data, qint64 length, const QByteArray& pattern);
+
+signals:
+    void progress(qint64 scanned, qint64 total);
+    void found(qint64 offset);
+    void notFound();
+
+private:
+    void run();
+    qint64 scan(MappedFile& file, qint64 begin, qint64 end, qint64& scanned);
+
+    QString filePath;
+    QByteArray pattern;
+    qint64 from;
+    QThread *worker;
+    std::atomic<bool> cancelled;
+};
+
+#endif // BYTESEARCH_H
@@ -0,0 +1,235 @@
+#include <QThread>
+#include <QtEndian>
+
+#include <cstring>
+
+#include "checksum.h"
+
+
+static constexpr quint64 prime1 = 11400714785074694791ULL;
+static constexpr quint64 prime2 = 14029467366897019727ULL;
+static constexpr quint64 prime3 = 1609587929392839161ULL;
+static constexpr quint64 prime4 = 9650029242287828579ULL;
+static constexpr quint64 prime5 = 2870177450012600261ULL;
+
+static inline quint64 rotateLeft(quint64 value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static inline quint64 read64(const char* data) {
+    quint64 value;
+    std::memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint32 read32(const char* data) {
+    quint32 value;
+    std::memcpy(&value, data, sizeof(value));
+    return qFromLittleEndian(value);
+}
+
+static inline quint64 mixRound(quint64 accumulator, quint64 input) {
+    accumulator += input * prime2;
+    accumulator = rotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+static inline quint64 mergeRound(quint64 hash, quint64 accumulator) {
+    hash ^= mixRound(0, accumulator);
+    return hash * prime1 + prime4;
+}
+
+
+Checksum::Checksum(quint64 seed)
+        : seed(seed),
+          totalSize(0),
+          pendingSize(0) {
+    accumulators[0] = seed + prime1 + prime2;
+    accumulators[1] = seed + prime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - prime1;
+}
+
+void Checksum::update(const char* data, qint64 size) {
+    totalSize += quint64(size);
+
+    if (pendingSize + size < 32) {
+        std::memcpy(pending + pendingSize, data, size_t(size));
+        pendingSize += int(size);
+        return;
+    }
+
+    if (pendingSize > 0) {
+        const int fill = 32 - pendingSize;
+        std::memcpy(pending + pendingSize, data, size_t(fill));
+        for (int lane = 0; lane < 4; ++lane) {
+            accumulators[lane] = mixRound(accumulators[lane], read64(pending + 8 * lane));
+        }
+        data += fill;
+        size -= fill;
+        pendingSize = 0;
+    }
+
+    // The four lanes are independent, so the compiler can keep them all in
+    // flight at once.
+    quint64 a0 = accumulators[0];
+    quint64 a1 = accumulators[1];
+    quint64 a2 = accumulators[2];
+    quint64 a3 = accumulators[3];
+    for (; size >= 32; data += 32, size -= 32) {
+        a0 = mixRound(a0, read64(data));
+        a1 = mixRound(a1, read64(data + 8));
+        a2 = mixRound(a2, read64(data + 16));
+        a3 = mixRound(a3, read64(data + 24));
+    }
+    accumulators[0] = a0;
+    accumulators[1] = a1;
+    accumulators[2] = a2;
+    accumulators[3] = a3;
+
+    std::memcpy(pending, data, size_t(size));
+    pendingSize = int(size);
+}
+
+void Checksum::updateZeros(qint64 size) {
+    static const char zeros[64 << 10] = {};
+    while (size > 0) {
+        const qint64 part = qMin(size, qint64(sizeof(zeros)));
+        update(zeros, part);
+        size -= part;
+    }
+}
+
+quint64 Checksum::digest() const {
+    quint64 hash;
+    if (totalSize >= 32) {
+        hash = rotateLeft(accumulators[0], 1) + rotateLeft(accumulators[1], 7)
+               + rotateLeft(accumulators[2], 12) + rotateLeft(accumulators[3], 18);
+        for (int lane = 0; lane < 4; ++lane) {
+            hash = mergeRound(hash, accumulators[lane]);
+        }
+    } else {
+        hash = seed + prime5;
+    }
+    hash += totalSize;
+
+    const char* data = pending;
+    int remaining = pendingSize;
+    for (; remaining >= 8; data += 8, remaining -= 8) {
+        hash ^= mixRound(0, read64(data));
+        hash = rotateLeft(hash, 27) * prime1 + prime4;
+    }
+    if (remaining >= 4) {
+        hash ^= quint64(read32(data)) * prime1;
+        hash = rotateLeft(hash, 23) * prime2 + prime3;
+        data += 4;
+        remaining -= 4;
+    }
+    for (; remaining > 0; ++data, --remaining) {
+        hash ^= quint64(uchar(*data)) * prime5;
+        hash = rotateLeft(hash, 11) * prime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+quint64 Checksum::of(const char* data, qint64 size, quint64 seed) {
+    Checksum checksum(seed);
+    checksum.update(data, size);
+    return checksum.digest();
+}
+
+
+ChecksumPipe::ChecksumPipe(qint64 bufferSize, bool threaded)
+        : worker(nullptr),
+          finishing(false) {
+    buffers.resize(threaded ? bufferCount : 1);
+    for (QByteArray& buffer: buffers) {
+        buffer.resize(bufferSize);
+        freeBuffers.append(buffer.data());
+    }
+
+    if (threaded) {
+        worker = QThread::create([this]() { run(); });
+        worker->start();
+    }
+}
+
+ChecksumPipe::~ChecksumPipe() {
+    finish();
+    delete worker;
+}
+
+char* ChecksumPipe::acquire() {
+    if (!worker) {
+        return buffers.first().data();
+    }
+
+    QMutexLocker locker(&mutex);
+    while (freeBuffers.isEmpty()) {
+        bufferFreed.wait(&mutex);
+    }
+    return freeBuffers.takeLast();
+}
+
+void ChecksumPipe::submit(const char* data, qint64 size) {
+    if (!worker) {
+        hash({data, size});
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    queued.enqueue({data, size});
+    workAvailable.wakeOne();
+}
+
+void ChecksumPipe::submitZeros(qint64 size) {
+    submit(nullptr, size);
+}
+
+quint64 ChecksumPipe::finish() {
+    if (worker) {
+        {
+            QMutexLocker locker(&mutex);
+            finishing = true;
+            workAvailable.wakeOne();
+        }
+        worker->wait();
+    }
+    return checksum.digest();
+}
+
+void ChecksumPipe::run() {
+    QMutexLocker locker(&mutex);
+    while (true) {
+        while (queued.isEmpty() && !finishing) {
+            workAvailable.wait(&mutex);
+        }
+        if (queued.isEmpty()) {
+            return;
+        }
+
+        const Block block = queued.dequeue();
+        locker.unlock();
+        hash(block);
+        locker.relock();
+
+        if (block.data) {
+            freeBuffers.append(const_cast<char*>(block.data));
+            bufferFreed.wakeOne();
+        }
+    }
+}
+
+void ChecksumPipe::hash(const Block& block) {
+    if (block.data) {
+        checksum.update(block.data, block.size);
+    } else {
+        checksum.updateZeros(block.size);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QWaitCondition>
+
+class QThread;
+
+// Streaming XXH64, used to check copies. It is not a cryptographic hash, but
+// at several GB/s it keeps up with any disk, and the 64-bit result makes an
+// accidental match of two different files practically impossible.
+class Checksum {
+public:
+    explicit Checksum(quint64 seed = 0);
+
+    void update(const char* data, qint64 size);
+    void updateZeros(qint64 size);
+    quint64 digest() const;
+
+    static quint64 of(const char* data, qint64 size, quint64 seed = 0);
+
+private:
+    quint64 seed;
+    quint64 accumulators[4];
+    quint64 totalSize;
+    char pending[32];
+    int pendingSize;
+};
+
+// Hashes buffers on a separate thread while the caller goes on reading and
+// writing the next ones.
+//
+// The caller takes a buffer with acquire(), fills it, and hands it over with
+// submit(); the buffer comes back to the free list once it is hashed. With
+// threaded set to false everything is hashed inline, which is cheaper than
+// starting a thread for a file that fits into one buffer.
+class ChecksumPipe {
+public:
+    static constexpr int bufferCount = 4;
+
+    ChecksumPipe(qint64 bufferSize, bool threaded);
+    ~ChecksumPipe();
+
+    char* acquire();
+    void submit(const char* data, qint64 size);
+    void submitZeros(qint64 size);
+    quint64 finish();
+
+private:
+    Q_DISABLE_COPY(ChecksumPipe)
+
+    struct Block {
+        const char* data;
+        qint64 size;
+    };
+
+    void run();
+    void hash(const Block& block);
+
+    Checksum checksum;
+    QVector<QByteArray> buffers;
+    QThread *worker;
+
+    QMutex mutex;
+    QWaitCondition workAvailable;
+    QWaitCondition bufferFreed;
+    QQueue<Block> queued;
+    QVector<char*> freeBuffers;
+    bool finishing;
+};
+
+#endif // CHECKSUM_H
@@ -0,0 +1,339 @@
+#include <QDir>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QUrl>
+#include <QUuid>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "copyjournal.h"
+
+
+static const QByteArray journalMagic = "FMJOURNAL 1";
+
+static QByteArray encodePath(const QString& path) {
+    return QUrl::toPercentEncoding(path, "/");
+}
+
+static QString decodePath(const QByteArray& encoded) {
+    return QUrl::fromPercentEncoding(encoded);
+}
+
+static bool syncToDisk(QFile& file) {
+    if (!file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+
+CopyJournal::CopyJournal()
+        : op(Copy) {
+}
+
+CopyJournal::~CopyJournal() {
+    close();
+}
+
+QString CopyJournal::journalDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/journal";
+}
+
+QStringList CopyJournal::pendingJournals() {
+    QStringList journals;
+    QDir dir(journalDirectory());
+    for (const QFileInfo& fileInfo: dir.entryInfoList(QStringList() << "*.journal", QDir::Files, QDir::Time)) {
+        // A journal whose lock is held belongs to a job that is still running
+        // in another instance of the application.
+        QLockFile probe(fileInfo.absoluteFilePath() + ".lock");
+        if (probe.tryLock(0)) {
+            probe.unlock();
+            journals << fileInfo.absoluteFilePath();
+        }
+    }
+    return journals;
+}
+
+bool CopyJournal::lock(const QString& journalPath) {
+    lockFile.reset(new QLockFile(journalPath + ".lock"));
+    lockFile->setStaleLockTime(0);
+    if (!lockFile->tryLock(0)) {
+        lockFile.reset();
+        return false;
+    }
+    return true;
+}
+
+bool CopyJournal::create(Operation operation, const QString& sourcePath, const QString& destinationPath) {
+    return create(operation, QStringList{sourcePath}, QStringList{destinationPath});
+}
+
+bool CopyJournal::create(Operation operation, const QStringList& sourcePaths, const QStringList& destinationPaths) {
+    close();
+    if (sourcePaths.isEmpty() || sourcePaths.size() != destinationPaths.size()) {
+        return false;
+    }
+
+    QDir().mkpath(journalDirectory());
+    QString journalPath = QDir(journalDirectory()).absoluteFilePath(
+            QUuid::createUuid().toString(QUuid::WithoutBraces) + ".journal");
+
+    if (!lock(journalPath)) {
+        qWarning() << "Could not lock journal:" << journalPath;
+        return false;
+    }
+
+    file.setFileName(journalPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "Could not create journal:" << journalPath;
+        lockFile.reset();
+        return false;
+    }
+
+    op = operation;
+    sources = sourcePaths;
+    destinations = destinationPaths;
+    completed.clear();
+    partial.clear();
+    confirmed.clear();
+    removed.clear();
+
+    // A journal that cannot even hold its header (a full disk, say) would
+    // not hold the records a move depends on either.
+    const QByteArray header = journalMagic + "\n";
+    bool written = file.write(header) == header.size() && append("OP", operation == Move ? "move" : "copy");
+    for (int i = 0; written && i < sources.size(); ++i) {
+        written = append("SRC", encodePath(sources.at(i))) && append("DST", encodePath(destinations.at(i)));
+    }
+    if (!written || !syncToDisk(file)) {
+        qWarning() << "Could not write journal:" << journalPath;
+        close();
+        QFile::remove(journalPath);
+        return false;
+    }
+    return true;
+}
+
+bool CopyJournal::load(const QString& journalPath) {
+    close();
+
+    if (!lock(journalPath)) {
+        return false;
+    }
+
+    QFile input(journalPath);
+    if (!input.open(QIODevice::ReadOnly)) {
+        lockFile.reset();
+        return false;
+    }
+
+    if (input.readLine().trimmed() != journalMagic) {
+        qWarning() << "Not a journal file:" << journalPath;
+        lockFile.reset();
+        return false;
+    }
+
+    op = Copy;
+    sources.clear();
+    destinations.clear();
+    completed.clear();
+    partial.clear();
+    confirmed.clear();
+    removed.clear();
+    bool allConfirmed = false;
+
+    while (!input.atEnd()) {
+        QByteArray line = input.readLine();
+        // A record without its newline was being written when the job died.
+        if (!line.endsWith('\n')) {
+            break;
+        }
+        line.chop(1);
+
+        int space = line.indexOf(' ');
+        QByteArray tag = space < 0 ? line : line.left(space);
+        QByteArray payload = space < 0 ? QByteArray() : line.mid(space + 1);
+
+        if (tag == "OP") {
+            op = payload == "move" ? Move : Copy;
+        } else if (tag == "SRC") {
+            sources.append(decodePath(payload));
+        } else if (tag == "DST") {
+            destinations.append(decodePath(payload));
+        } else if (tag == "PART") {
+            int split = payload.indexOf(' ');
+            if (split > 0) {
+                partial.insert(decodePath(payload.mid(split + 1)), payload.left(split).toLongLong());
+            }
+        } else if (tag == "DONE") {
+            QString relativePath = decodePath(payload);
+            partial.remove(relativePath);
+            completed.insert(relativePath);
+        } else if (tag == "COPIED") {
+            // Without an item, the record confirms all of them.
+            if (payload.isEmpty()) {
+                allConfirmed = true;
+            } else {
+                confirmed.insert(payload.toInt());
+            }
+        } else if (tag == "REMOVED") {
+            removed.insert(payload.toInt());
+        }
+    }
+    input.close();
+
+    if (allConfirmed) {
+        for (int i = 0; i < sources.size(); ++i) {
+            confirmed.insert(i);
+        }
+    }
+
+    if (sources.isEmpty() || sources.size() != destinations.size()) {
+        qWarning() << "Incomplete journal header:" << journalPath;
+        lockFile.reset();
+        return false;
+    }
+
+    file.setFileName(journalPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        lockFile.reset();
+        return false;
+    }
+    return true;
+}
+
+bool CopyJournal::isOpen() const {
+    return file.isOpen();
+}
+
+CopyJournal::Operation CopyJournal::operation() const {
+    return op;
+}
+
+int CopyJournal::itemCount() const {
+    return sources.size();
+}
+
+QString CopyJournal::sourcePath(int item) const {
+    return sources.value(item);
+}
+
+QString CopyJournal::destinationPath(int item) const {
+    return destinations.value(item);
+}
+
+QString CopyJournal::itemKey(int item) const {
+    // A journal for a single item keeps the layout it has always had.
+    return sources.size() == 1 ? QString() : QString::number(item);
+}
+
+QString CopyJournal::journalPath() const {
+    return file.fileName();
+}
+
+bool CopyJournal::isCompleted(const QString& relativePath) const {
+    QMutexLocker locker(&mutex);
+    return completed.contains(relativePath);
+}
+
+qint64 CopyJournal::resumeOffset(const QString& relativePath) const {
+    QMutexLocker locker(&mutex);
+    return partial.value(relativePath, 0);
+}
+
+bool CopyJournal::isCopyConfirmed(int item) const {
+    QMutexLocker locker(&mutex);
+    return confirmed.contains(item);
+}
+
+bool CopyJournal::isRemoved(int item) const {
+    QMutexLocker locker(&mutex);
+    return removed.contains(item);
+}
+
+void CopyJournal::recordPartial(const QString& relativePath, qint64 offset) {
+    QMutexLocker locker(&mutex);
+    if (append("PART", QByteArray::number(offset) + ' ' + encodePath(relativePath))) {
+        partial.insert(relativePath, offset);
+    }
+}
+
+void CopyJournal::recordCompleted(const QString& relativePath) {
+    QMutexLocker locker(&mutex);
+    if (append("DONE", encodePath(relativePath))) {
+        partial.remove(relativePath);
+        completed.insert(relativePath);
+    }
+}
+
+bool CopyJournal::confirmCopy(const QList<int>& items) {
+    QMutexLocker locker(&mutex);
+    if (!isOpen()) {
+        return false;
+    }
+    QList<int> unconfirmed;
+    for (int item: items) {
+        if (!confirmed.contains(item)) {
+            if (!append("COPIED", QByteArray::number(item))) {
+                return false;
+            }
+            unconfirmed.append(item);
+        }
+    }
+    if (unconfirmed.isEmpty()) {
+        return true;
+    }
+    if (!syncToDisk(file)) {
+        return false;
+    }
+    for (int item: unconfirmed) {
+        confirmed.insert(item);
+    }
+    return true;
+}
+
+void CopyJournal::recordRemoved(int item) {
+    QMutexLocker locker(&mutex);
+    if (append("REMOVED", QByteArray::number(item))) {
+        removed.insert(item);
+    }
+}
+
+void CopyJournal::finish() {
+    if (!isOpen()) {
+        return;
+    }
+    QString journalPath = file.fileName();
+    close();
+    QFile::remove(journalPath);
+}
+
+bool CopyJournal::append(const QByteArray& tag, const QByteArray& payload) {
+    if (!isOpen()) {
+        return false;
+    }
+    QByteArray record = payload.isEmpty() ? tag : tag + ' ' + payload;
+    record += '\n';
+    if (file.write(record) != record.size()) {
+        qWarning() << "Failed to write journal:" << file.fileName();
+        return false;
+    }
+    // Flushing hands the record to the OS, which is enough to survive the
+    // application dying; phase changes are additionally synced to disk.
+    file.flush();
+    return true;
+}
+
+void CopyJournal::close() {
+    if (file.isOpen()) {
+        file.close();
+    }
+    lockFile.reset();
+}
@@ -0,0 +1,82 @@
+#ifndef COPYJOURNAL_H
+#define COPYJOURNAL_H
+
+#include <QFile>
+#include <QHash>
+#include <QLockFile>
+#include <QMutex>
+#include <QScopedPointer>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+// Write-ahead journal for long-running copy and move jobs.
+//
+// Every job appends records to a small text file under the application data
+// directory: which files have been copied completely and how far partially
+// copied files got. If the application dies, the journal survives and the
+// next start can resume the job instead of starting from scratch. A move only
+// removes its source after the journal has durably recorded that the copy is
+// complete.
+//
+// One journal can cover several items, like the files of a drop, so that an
+// interrupted job is resumed as a whole and one sync confirms a batch of
+// copies. Records for item n are keyed below itemKey(n), and may be written
+// from several threads at once.
+class CopyJournal {
+public:
+    enum Operation {
+        Copy,
+        Move
+    };
+
+    CopyJournal();
+    ~CopyJournal();
+
+    static QString journalDirectory();
+    static QStringList pendingJournals();
+
+    bool create(Operation operation, const QString& sourcePath, const QString& destinationPath);
+    bool create(Operation operation, const QStringList& sourcePaths, const QStringList& destinationPaths);
+    bool load(const QString& journalPath);
+
+    bool isOpen() const;
+    Operation operation() const;
+    int itemCount() const;
+    QString sourcePath(int item = 0) const;
+    QString destinationPath(int item = 0) const;
+    // The relative path an item's own records are kept under.
+    QString itemKey(int item) const;
+    QString journalPath() const;
+
+    bool isCompleted(const QString& relativePath) const;
+    qint64 resumeOffset(const QString& relativePath) const;
+    bool isCopyConfirmed(int item = 0) const;
+    bool isRemoved(int item) const;
+
+    void recordPartial(const QString& relativePath, qint64 offset);
+    void recordCompleted(const QString& relativePath);
+    // Records the copies of items as complete, with a single sync.
+    bool confirmCopy(const QList<int>& items);
+    void recordRemoved(int item);
+
+    void finish();
+
+private:
+    bool lock(const QString& journalPath);
+    bool append(const QByteArray& tag, const QByteArray& payload = QByteArray());
+    void close();
+
+    QFile file;
+    QScopedPointer<QLockFile> lockFile;
+    mutable QMutex mutex;
+    Operation op;
+    QStringList sources;
+    QStringList destinations;
+    QSet<QString> completed;
+    QHash<QString, qint64> partial;
+    QSet<int> confirmed;
+    QSet<int> removed;
+};
+
+#endif // COPYJOURNAL_H
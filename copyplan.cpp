@@ -0,0 +1,219 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QDebug>
+
+#include <algorithm>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+#include <linux/fiemap.h>
+#include <cstring>
+#endif
+
+#include "copyplan.h"
+#include "ioscheduler.h"
+#include "uringbackend.h"
+
+
+static QString childPath(const QString& relativePath, const QString& name) {
+    return relativePath.isEmpty() ? name : relativePath + "/" + name;
+}
+
+#ifdef Q_OS_LINUX
+// Physical byte offset of the first extent of an open file, or false when
+// the filesystem cannot tell (no FIEMAP support, empty or inline files).
+static bool firstExtent(int fd, quint64& position) {
+    alignas(struct fiemap) char buffer[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+    std::memset(buffer, 0, sizeof(buffer));
+
+    auto map = reinterpret_cast<struct fiemap*>(buffer);
+    map->fm_start = 0;
+    map->fm_length = FIEMAP_MAX_OFFSET;
+    map->fm_extent_count = 1;
+
+    if (::ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) {
+        return false;
+    }
+    position = map->fm_extents[0].fe_physical;
+    return true;
+}
+#endif
+
+
+bool CopyPlan::collect(const QString& sourcePath, const QString& destinationPath,
+                       const QString& relativePath, QVector<Item>& items) {
+    QDir sourceDir(sourcePath);
+    if (!sourceDir.exists()) {
+        qWarning() << "Source directory does not exist:" << sourcePath;
+        return false;
+    }
+
+    // Directories are created while planning, so empty ones are copied too.
+    QDir().mkpath(destinationPath);
+
+    // System, or broken links, FIFOs and sockets would be left out of the
+    // plan without a word, and a move would delete them with the source.
+    QFileInfoList fileInfoList = sourceDir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& fileInfo: fileInfoList) {
+        const QString sourceFilePath = fileInfo.absoluteFilePath();
+        const QString destFilePath = destinationPath + QDir::separator() + fileInfo.fileName();
+        const QString childRelativePath = childPath(relativePath, fileInfo.fileName());
+
+        // The entry itself is classified, never what a link points to.
+#ifdef Q_OS_LINUX
+        struct stat info;
+        if (::lstat(QFile::encodeName(sourceFilePath).constData(), &info) != 0) {
+            qWarning() << "Could not stat:" << sourceFilePath;
+            return false;
+        }
+        const bool isLink = S_ISLNK(info.st_mode);
+        const bool isDir = S_ISDIR(info.st_mode);
+        const bool isFile = S_ISREG(info.st_mode);
+#else
+        const bool isLink = fileInfo.isSymLink();
+        const bool isDir = !isLink && fileInfo.isDir();
+        const bool isFile = !isLink && fileInfo.isFile();
+#endif
+
+        if (isDir) {
+            if (!collect(sourceFilePath, destFilePath, childRelativePath, items)) {
+                return false;
+            }
+        } else if (isFile) {
+            items.append({sourceFilePath, destFilePath, childRelativePath});
+        } else if (isLink) {
+            Item item = {sourceFilePath, destFilePath, childRelativePath};
+            item.symLink = true;
+            items.append(item);
+        } else {
+            qWarning() << "Unsupported file type:" << sourceFilePath;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void CopyPlan::stat(QVector<Item>& items) {
+    // One batched io_uring pass when available, one stat() per file if not.
+    if (UringBackend::statFiles(items)) {
+        return;
+    }
+
+    for (Item& item: items) {
+#ifdef Q_OS_LINUX
+        struct stat info;
+        if (::lstat(QFile::encodeName(item.sourcePath).constData(), &info) == 0) {
+            item.size = qint64(info.st_size);
+            item.mode = info.st_mode;
+            item.inode = quint64(info.st_ino);
+            item.device = quint64(info.st_dev);
+            item.links = uint(info.st_nlink);
+        }
+#else
+        item.size = QFileInfo(item.sourcePath).size();
+#endif
+    }
+}
+
+QVector<int> CopyPlan::findHardLinks(const QVector<Item>& items) {
+    // For every item, the index of the first item with the same inode, or -1
+    // when the item is the first (or only) name of its file. Only files with
+    // more than one link are remembered, so the table stays small for trees
+    // that do not use hard links at all.
+    QVector<int> linkedTo(items.size(), -1);
+    QHash<QPair<quint64, quint64>, int> firstNames;
+    for (int i = 0; i < items.size(); ++i) {
+        const Item& item = items.at(i);
+        if (item.links < 2 || item.size < 0 || item.symLink) {
+            continue;
+        }
+
+        auto found = firstNames.constFind(qMakePair(item.device, item.inode));
+        if (found != firstNames.constEnd()) {
+            linkedTo[i] = found.value();
+        } else {
+            firstNames.insert(qMakePair(item.device, item.inode), i);
+        }
+    }
+    return linkedTo;
+}
+
+void CopyPlan::sortByPhysicalOrder(QVector<Item>& items) {
+    if (items.isEmpty()) {
+        return;
+    }
+
+    // Extent lookups cost an open and an ioctl per file; only spinning disks
+    // pay that back.
+    const bool useExtents = IoScheduler::instance().device(items.first().sourcePath).rotational;
+    QVector<Key> keys;
+    keys.reserve(items.size());
+    for (const Item& item: items) {
+        keys.append(physicalKey(item, useExtents));
+    }
+
+    std::vector<int> order(items.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&keys](int a, int b) {
+        return std::tie(keys[a].hasExtent, keys[a].position, keys[a].inode)
+               < std::tie(keys[b].hasExtent, keys[b].position, keys[b].inode);
+    });
+
+    QVector<Item> sorted;
+    sorted.reserve(items.size());
+    for (int index: order) {
+        sorted.append(items.at(index));
+    }
+    items = sorted;
+}
+
+void CopyPlan::sortByPhysicalOrder(QStringList& paths) {
+    QVector<Item> items;
+    items.reserve(paths.size());
+    for (const QString& path: paths) {
+        items.append({path, QString(), QString()});
+    }
+    stat(items);
+    sortByPhysicalOrder(items);
+
+    paths.clear();
+    for (const Item& item: items) {
+        paths.append(item.sourcePath);
+    }
+}
+
+CopyPlan::Key CopyPlan::physicalKey(const Item& item, bool useExtents) {
+    // Files without a known extent sort first, by inode: reading them only
+    // touches the inode table.
+    Key key = {false, 0, item.inode};
+
+#ifdef Q_OS_LINUX
+    // Opening a link would open what it points to.
+    if (useExtents && !item.symLink) {
+        const QByteArray encoded = QFile::encodeName(item.sourcePath);
+        int fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd < 0) {
+            // O_NOATIME is refused for files the user does not own.
+            fd = ::open(encoded.constData(), O_RDONLY | O_CLOEXEC);
+        }
+        if (fd >= 0) {
+            key.hasExtent = firstExtent(fd, key.position);
+            ::close(fd);
+        }
+    }
+#else
+    Q_UNUSED(useExtents);
+#endif
+
+    return key;
+}
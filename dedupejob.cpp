@@ -0,0 +1,449 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QDebug>
+
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#include "dedupejob.h"
+#include "checksum.h"
+#include "fileoperations.h"
+#include "ioscheduler.h"
+
+
+// Hashes the first `limit` bytes of a file, or all of it for a negative
+// limit.
+static bool hashFile(const QString& path, qint64 limit, quint64& digest) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+    Checksum checksum;
+    QByteArray buffer(DedupeJob::bufferSize, Qt::Uninitialized);
+    qint64 remaining = limit < 0 ? file.size() : limit;
+    while (remaining > 0) {
+        const qint64 bytesRead = file.read(buffer.data(), qMin<qint64>(buffer.size(), remaining));
+        if (bytesRead <= 0) {
+            return false;
+        }
+        checksum.update(buffer.constData(), bytesRead);
+        remaining -= bytesRead;
+    }
+    digest = checksum.digest();
+    return true;
+}
+
+static bool sameContents(const QString& firstPath, const QString& secondPath) {
+    QFile first(firstPath);
+    QFile second(secondPath);
+    if (!first.open(QIODevice::ReadOnly | QIODevice::Unbuffered)
+        || !second.open(QIODevice::ReadOnly | QIODevice::Unbuffered) || first.size() != second.size()) {
+        return false;
+    }
+    QByteArray firstBuffer(DedupeJob::bufferSize, Qt::Uninitialized);
+    QByteArray secondBuffer(DedupeJob::bufferSize, Qt::Uninitialized);
+    forever {
+        const qint64 firstRead = first.read(firstBuffer.data(), firstBuffer.size());
+        const qint64 secondRead = second.read(secondBuffer.data(), secondBuffer.size());
+        if (firstRead != secondRead || firstRead < 0) {
+            return false;
+        }
+        if (firstRead == 0) {
+            return true;
+        }
+        if (std::memcmp(firstBuffer.constData(), secondBuffer.constData(), size_t(firstRead)) != 0) {
+            return false;
+        }
+    }
+}
+
+
+#ifdef Q_OS_LINUX
+namespace {
+
+struct Extent {
+    qint64 logical;
+    qint64 physical;
+    qint64 length;
+};
+
+struct Span {
+    qint64 begin;
+    qint64 end;
+};
+
+}
+
+// Where the first size bytes of a file lie on disk, in file order. Extents
+// without a place yet are left out, and so is everything if the file
+// system cannot tell.
+static QVector<Extent> extentMap(int fd, qint64 size) {
+    static const int batch = 128;
+    QVector<Extent> extents;
+    QByteArray request(int(sizeof(fiemap) + batch * sizeof(fiemap_extent)), '\0');
+    auto map = reinterpret_cast<fiemap*>(request.data());
+    for (qint64 start = 0; start < size;) {
+        std::memset(request.data(), 0, size_t(request.size()));
+        map->fm_start = quint64(start);
+        map->fm_length = quint64(size - start);
+        map->fm_flags = FIEMAP_FLAG_SYNC;
+        map->fm_extent_count = batch;
+        if (::ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) {
+            break;
+        }
+        bool last = false;
+        for (quint32 i = 0; i < map->fm_mapped_extents; ++i) {
+            const fiemap_extent& extent = map->fm_extents[i];
+            if (!(extent.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC))) {
+                extents.append({qint64(extent.fe_logical), qint64(extent.fe_physical), qint64(extent.fe_length)});
+            }
+            start = qint64(extent.fe_logical + extent.fe_length);
+            last = extent.fe_flags & FIEMAP_EXTENT_LAST;
+        }
+        if (last) {
+            break;
+        }
+    }
+    return extents;
+}
+
+// The parts of two files that sit on the same blocks at the same offset.
+static QVector<Span> sharedSpans(const QVector<Extent>& first, const QVector<Extent>& second) {
+    QVector<Span> spans;
+    for (int i = 0, j = 0; i < first.size() && j < second.size();) {
+        const Extent& a = first.at(i);
+        const Extent& b = second.at(j);
+        const qint64 begin = qMax(a.logical, b.logical);
+        const qint64 end = qMin(a.logical + a.length, b.logical + b.length);
+        if (end > begin && a.physical - a.logical == b.physical - b.logical) {
+            spans.append({begin, end});
+        }
+        if (a.logical + a.length < b.logical + b.length) {
+            ++i;
+        } else {
+            ++j;
+        }
+    }
+    return spans;
+}
+
+static qint64 bytesWithin(const QVector<Span>& spans, qint64 begin, qint64 end) {
+    qint64 bytes = 0;
+    for (const Span& span: spans) {
+        bytes += qMax<qint64>(0, qMin(span.end, end) - qMax(span.begin, begin));
+    }
+    return bytes;
+}
+#endif
+
+
+DedupeJob::DedupeJob(const QString& rootPath, bool allowHardLinks, QObject *parent)
+        : QObject(parent),
+          root(rootPath),
+          hardLinks(allowHardLinks),
+          worker(nullptr),
+          cancelled(false),
+          reclaimed(0),
+          deduplicated(0),
+          groups(0),
+          unshareable(0) {
+}
+
+DedupeJob::~DedupeJob() {
+    cancel();
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void DedupeJob::start() {
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+}
+
+void DedupeJob::cancel() {
+    cancelled = true;
+}
+
+void DedupeJob::run() {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Only sizes that occur more than once can hide duplicates.
+    QHash<qint64, QVector<File>> filesBySize;
+    const QStringList paths = FileOperations::filesRecursively(root);
+    for (const QString& path: paths) {
+#ifdef Q_OS_UNIX
+        struct stat info;
+        if (::lstat(QFile::encodeName(path).constData(), &info) != 0 || !S_ISREG(info.st_mode)
+            || info.st_size < minimumSize) {
+            continue;
+        }
+        filesBySize[info.st_size].append({path, quint64(info.st_dev), quint64(info.st_ino), quint64(info.st_nlink)});
+#else
+        const QFileInfo info(path);
+        if (info.isSymLink() || info.size() < minimumSize) {
+            continue;
+        }
+        filesBySize[info.size()].append({path, 0, 0, 1});
+#endif
+    }
+
+    QHash<QString, QThreadPool*> pools;
+    for (auto it = filesBySize.cbegin(); it != filesBySize.cend(); ++it) {
+        // Names that are already links to one file are one file.
+        QVector<File> files;
+        QSet<QPair<quint64, quint64>> seen;
+        for (const File& file: it.value()) {
+            if (file.inode == 0 || !seen.contains({file.device, file.inode})) {
+                seen.insert({file.device, file.inode});
+                files.append(file);
+            }
+        }
+        if (files.size() < 2) {
+            continue;
+        }
+
+        const IoScheduler::Device device = IoScheduler::instance().device(files.first().path);
+        QThreadPool*& pool = pools[device.name];
+        if (!pool) {
+            pool = new QThreadPool;
+            pool->setMaxThreadCount(device.concurrency);
+        }
+        const qint64 size = it.key();
+        pool->start([this, files, size]() { processGroup(files, size); });
+    }
+    for (QThreadPool* pool: pools) {
+        pool->waitForDone();
+    }
+    qDeleteAll(pools);
+
+    qInfo() << "Deduplicated" << deduplicated.load() << "files in" << groups.load() << "groups below" << root
+            << "reclaiming" << reclaimed.load() << "bytes in" << timer.elapsed() << "ms";
+    if (unshareable > 0) {
+        failures.append(tr("%n duplicate(s) left alone: the file system cannot share extents, "
+                           "and replacing them with hard links was not allowed.", "", unshareable.load()));
+    }
+    emit finished(reclaimed.load(), deduplicated.load(), groups.load(), failures);
+}
+
+void DedupeJob::processGroup(const QVector<File>& files, qint64 size) {
+    for (const QVector<File>& identical: identicalFiles(files, size)) {
+        // Extents and links both stay within one file system; the first
+        // file on each keeps its data and the others are pointed at it.
+        QHash<quint64, QVector<File>> byDevice;
+        for (const File& file: identical) {
+            byDevice[file.device].append(file);
+        }
+
+        for (const QVector<File>& sameDevice: byDevice) {
+            if (sameDevice.size() < 2) {
+                continue;
+            }
+            ++groups;
+            const File& source = sameDevice.first();
+            for (int i = 1; i < sameDevice.size() && !cancelled; ++i) {
+                const File& duplicate = sameDevice.at(i);
+                qint64 shared = 0;
+                bool unsupported = false;
+                if (shareExtents(source, duplicate, size, shared, unsupported)) {
+                    // A copy that shared every block already is not one.
+                    if (shared > 0) {
+                        reclaimed += shared;
+                        ++deduplicated;
+                    }
+                } else if (unsupported && hardLinks) {
+                    if (replaceWithLink(source, duplicate)) {
+                        // With other names left, the data stays where it is.
+                        if (duplicate.links == 1) {
+                            reclaimed += size;
+                        }
+                        ++deduplicated;
+                    }
+                } else if (unsupported) {
+                    ++unshareable;
+                }
+            }
+        }
+    }
+}
+
+QVector<QVector<DedupeJob::File>> DedupeJob::identicalFiles(const QVector<File>& files, qint64 size) {
+    // The first 64 KiB tell most files of equal size apart; only those that
+    // agree there are read completely.
+    QHash<quint64, QVector<File>> byHead;
+    for (const File& file: files) {
+        quint64 digest;
+        if (cancelled) {
+            return {};
+        }
+        if (hashFile(file.path, qMin(size, headSize), digest)) {
+            byHead[digest].append(file);
+        }
+    }
+
+    QVector<QVector<File>> result;
+    for (const QVector<File>& candidates: byHead) {
+        if (candidates.size() < 2) {
+            continue;
+        }
+        if (size <= headSize) {
+            result.append(candidates);
+            continue;
+        }
+        QHash<quint64, QVector<File>> byContents;
+        for (const File& file: candidates) {
+            quint64 digest;
+            if (cancelled) {
+                return {};
+            }
+            if (hashFile(file.path, -1, digest)) {
+                byContents[digest].append(file);
+            }
+        }
+        for (const QVector<File>& identical: byContents) {
+            if (identical.size() >= 2) {
+                result.append(identical);
+            }
+        }
+    }
+    return result;
+}
+
+bool DedupeJob::shareExtents(const File& source, const File& duplicate, qint64 size, qint64& shared,
+                             bool& unsupported) {
+#ifdef Q_OS_LINUX
+    const int sourceFd = ::open(QFile::encodeName(source.path).constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        addFailure(source.path, qt_error_string(errno));
+        return false;
+    }
+    // Newer kernels accept a read-only descriptor for files the caller owns.
+    const QByteArray duplicatePath = QFile::encodeName(duplicate.path);
+    int duplicateFd = ::open(duplicatePath.constData(), O_RDWR | O_CLOEXEC);
+    if (duplicateFd < 0) {
+        duplicateFd = ::open(duplicatePath.constData(), O_RDONLY | O_CLOEXEC);
+    }
+    if (duplicateFd < 0) {
+        addFailure(duplicate.path, qt_error_string(errno));
+        ::close(sourceFd);
+        return false;
+    }
+
+    // The kernel reports shared bytes as deduplicated too, so blocks the
+    // files share already, from an earlier run or a reflink copy, are
+    // skipped and not counted as reclaimed.
+    const QVector<Span> alreadyShared = sharedSpans(extentMap(sourceFd, size), extentMap(duplicateFd, size));
+
+    QByteArray request(int(sizeof(file_dedupe_range) + sizeof(file_dedupe_range_info)), '\0');
+    auto range = reinterpret_cast<file_dedupe_range*>(request.data());
+    bool ok = true;
+    for (qint64 offset = 0; offset < size && ok;) {
+        const qint64 length = qMin(dedupeChunk, size - offset);
+        if (bytesWithin(alreadyShared, offset, offset + length) == length) {
+            offset += length;
+            continue;
+        }
+        std::memset(request.data(), 0, size_t(request.size()));
+        range->src_offset = quint64(offset);
+        range->src_length = quint64(length);
+        range->dest_count = 1;
+        range->info[0].dest_fd = duplicateFd;
+        range->info[0].dest_offset = quint64(offset);
+
+        int error = 0;
+        if (::ioctl(sourceFd, FIDEDUPERANGE, range) != 0) {
+            error = errno;
+        } else if (range->info[0].status < 0) {
+            error = -range->info[0].status;
+        }
+
+        if (error == EOPNOTSUPP || error == ENOTTY || error == EINVAL || error == EXDEV) {
+            unsupported = true;
+            ok = false;
+        } else if (error != 0) {
+            addFailure(duplicate.path, qt_error_string(error));
+            ok = false;
+        } else if (range->info[0].status == FILE_DEDUPE_RANGE_DIFFERS) {
+            // Changed since it was hashed; the kernel shares nothing then.
+            addFailure(duplicate.path, tr("contents changed"));
+            ok = false;
+        } else if (range->info[0].bytes_deduped == 0) {
+            addFailure(duplicate.path, tr("the file system shared nothing"));
+            ok = false;
+        } else {
+            const qint64 deduped = qint64(range->info[0].bytes_deduped);
+            shared += deduped - bytesWithin(alreadyShared, offset, offset + deduped);
+            offset += deduped;
+        }
+    }
+
+    ::close(duplicateFd);
+    ::close(sourceFd);
+    return ok;
+#else
+    Q_UNUSED(source);
+    Q_UNUSED(duplicate);
+    Q_UNUSED(size);
+    Q_UNUSED(shared);
+    unsupported = true;
+    return false;
+#endif
+}
+
+bool DedupeJob::replaceWithLink(const File& source, const File& duplicate) {
+#ifdef Q_OS_UNIX
+    // The hashes only make a match near certain, and a link cannot be taken
+    // back, so the bytes are compared first.
+    if (!sameContents(source.path, duplicate.path)) {
+        addFailure(duplicate.path, tr("contents differ"));
+        return false;
+    }
+
+    // The link is made next to the duplicate and renamed over it, so the
+    // duplicate's name never goes missing.
+    const QByteArray target = QFile::encodeName(duplicate.path);
+    const QByteArray temporary = target + ".dedupe-" + QByteArray::number(QCoreApplication::applicationPid());
+    if (::link(QFile::encodeName(source.path).constData(), temporary.constData()) != 0) {
+        addFailure(duplicate.path, qt_error_string(errno));
+        return false;
+    }
+    if (::rename(temporary.constData(), target.constData()) != 0) {
+        addFailure(duplicate.path, qt_error_string(errno));
+        ::unlink(temporary.constData());
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(source);
+    addFailure(duplicate.path, tr("hard links are not supported here"));
+    return false;
+#endif
+}
+
+void DedupeJob::addFailure(const QString& path, const QString& reason) {
+    qWarning() << "Could not deduplicate" << path << "-" << reason;
+    QMutexLocker locker(&failureMutex);
+    failures.append(path + ": " + reason);
+}
@@ -0,0 +1,76 @@
+#ifndef DEDUPEJOB_H
+#define DEDUPEJOB_H
+
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+
+// Reclaims the space taken by identical files below a directory.
+//
+// Files are enumerated the way compareDirectories() does, grouped by size,
+// and within a size group narrowed down by a hash of their first 64 KiB and
+// then of their whole contents. Each group of identical files is handled as
+// a task of its own, in a thread pool per disk sized like MoveJob's.
+//
+// Where the file system can share extents (btrfs, XFS), the copies are made
+// to share the first file's blocks with FIDEDUPERANGE. The kernel compares
+// the bytes itself under lock, so a file that differs or changes meanwhile
+// is simply left alone. Blocks the files share already are skipped, so
+// only newly shared space counts as reclaimed. Elsewhere, and only if
+// allowed, the copies are replaced by hard links to the first file after
+// a byte-by-byte comparison; they then share permissions and timestamps
+// as well as data.
+class DedupeJob : public QObject {
+    Q_OBJECT
+
+public:
+    // Extents are shared in whole blocks, so smaller files gain nothing.
+    static constexpr qint64 minimumSize = 4096;
+    static constexpr qint64 headSize = 64 << 10;
+    static constexpr qint64 bufferSize = 1 << 20;
+    // The most some file systems share in one call.
+    static constexpr qint64 dedupeChunk = 16 << 20;
+
+    DedupeJob(const QString& rootPath, bool allowHardLinks, QObject *parent = nullptr);
+    ~DedupeJob();
+
+    void start();
+    void cancel();
+
+signals:
+    void finished(qint64 reclaimed, int deduplicated, int groups, const QStringList& failures);
+
+private:
+    struct File {
+        QString path;
+        quint64 device;
+        quint64 inode;
+        quint64 links;
+    };
+
+    void run();
+    void processGroup(const QVector<File>& files, qint64 size);
+    QVector<QVector<File>> identicalFiles(const QVector<File>& files, qint64 size);
+    bool shareExtents(const File& source, const File& duplicate, qint64 size, qint64& shared, bool& unsupported);
+    bool replaceWithLink(const File& source, const File& duplicate);
+    void addFailure(const QString& path, const QString& reason);
+
+    QString root;
+    bool hardLinks;
+    QThread *worker;
+    std::atomic<bool> cancelled;
+
+    std::atomic<qint64> reclaimed;
+    std::atomic<int> deduplicated;
+    std::atomic<int> groups;
+    std::atomic<int> unshareable;
+    QMutex failureMutex;
+    QStringList failures;
+};
+
+#endif // DEDUPEJOB_H
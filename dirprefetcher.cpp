@@ -0,0 +1,182 @@
+#include <QDir>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "dirprefetcher.h"
+
+
+DirPrefetcher::DirPrefetcher(QObject *parent)
+        : QObject(parent),
+          listings(cacheCost),
+          stopping(false) {
+    worker = QThread::create([this]() { run(); });
+    worker->start(QThread::LowestPriority);
+}
+
+DirPrefetcher::~DirPrefetcher() {
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        requestAvailable.wakeAll();
+    }
+    worker->wait();
+    delete worker;
+}
+
+void DirPrefetcher::prefetch(const QString& directory, bool withNeighbours) {
+    const QString path = QDir::cleanPath(directory);
+    if (path.isEmpty()) {
+        return;
+    }
+
+    QMutexLocker locker(&mutex);
+    // The user has moved on: what was next to the previous directory is no
+    // longer likely to be opened.
+    neighbours.clear();
+    for (int i = 0; i < targets.size(); ++i) {
+        if (targets.at(i).path == path) {
+            targets.removeAt(i);
+            break;
+        }
+    }
+    targets.append({path, withNeighbours});
+    if (targets.size() > maxTargets) {
+        targets.removeFirst();
+    }
+    requestAvailable.wakeOne();
+}
+
+void DirPrefetcher::run() {
+    forever {
+        Request request;
+        bool isTarget;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopping && targets.isEmpty() && neighbours.isEmpty()) {
+                requestAvailable.wait(&mutex);
+            }
+            if (stopping) {
+                return;
+            }
+            // The newest request first, then what lies around it.
+            isTarget = !targets.isEmpty();
+            request = isTarget ? targets.takeLast() : Request{neighbours.takeFirst(), false};
+        }
+
+        QStringList subdirectories;
+        if (!warm(request.path, subdirectories) || !isTarget) {
+            continue;
+        }
+        emit prefetched(request.path);
+
+        if (!request.withNeighbours) {
+            continue;
+        }
+        QStringList siblings;
+        const QString parent = QFileInfo(request.path).path();
+        if (parent != request.path) {
+            warm(parent, siblings);
+        }
+
+        QMutexLocker locker(&mutex);
+        for (const QString& name: subdirectories) {
+            neighbours.append(QDir(request.path).filePath(name));
+        }
+        for (const QString& name: siblings) {
+            const QString sibling = QDir(parent).filePath(name);
+            if (sibling != request.path) {
+                neighbours.append(sibling);
+            }
+        }
+        if (neighbours.size() > maxNeighbours) {
+            neighbours.erase(neighbours.begin() + maxNeighbours, neighbours.end());
+        }
+    }
+}
+
+// Reads a directory unless the cache has it at its current modification
+// time, and returns the names of its subdirectories either way.
+bool DirPrefetcher::warm(const QString& directory, QStringList& subdirectories) {
+#ifdef Q_OS_UNIX
+    DIR* handle = ::opendir(QFile::encodeName(directory).constData());
+    if (!handle) {
+        return false;
+    }
+    const int fd = ::dirfd(handle);
+    struct stat info;
+    if (::fstat(fd, &info) != 0) {
+        ::closedir(handle);
+        return false;
+    }
+    const qint64 modified = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+
+    {
+        QMutexLocker locker(&mutex);
+        if (const Listing* listing = listings.object(directory); listing && listing->modified == modified) {
+            subdirectories = listing->subdirectories;
+            ::closedir(handle);
+            return true;
+        }
+    }
+
+    int statted = 0;
+    while (const dirent* entry = ::readdir(handle)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        // The model stats every entry it lists; doing that here is what
+        // brings the inodes into memory. Links are not followed, so a link
+        // to a dead mount cannot hang the thread.
+        bool isDir = entry->d_type == DT_DIR;
+        if (statted < maxStatsPerDirectory) {
+            ++statted;
+            if (::fstatat(fd, name, &info, AT_SYMLINK_NOFOLLOW) == 0) {
+                isDir = S_ISDIR(info.st_mode);
+            }
+        }
+        if (isDir) {
+            subdirectories.append(QFile::decodeName(name));
+        }
+        if (stopping) {
+            break;
+        }
+    }
+    ::closedir(handle);
+#else
+    const QFileInfo directoryInfo(directory);
+    if (!directoryInfo.isDir()) {
+        return false;
+    }
+    const qint64 modified = directoryInfo.lastModified().toMSecsSinceEpoch();
+
+    {
+        QMutexLocker locker(&mutex);
+        if (const Listing* listing = listings.object(directory); listing && listing->modified == modified) {
+            subdirectories = listing->subdirectories;
+            return true;
+        }
+    }
+
+    const QFileInfoList entries = QDir(directory).entryInfoList(
+            QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& entry: entries) {
+        if (entry.isDir() && !entry.isSymLink()) {
+            subdirectories.append(entry.fileName());
+        }
+    }
+#endif
+
+    QMutexLocker locker(&mutex);
+    listings.insert(directory, new Listing{modified, subdirectories}, 1 + int(subdirectories.size()));
+    return true;
+}
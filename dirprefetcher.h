@@ -0,0 +1,70 @@
+#ifndef DIRPREFETCHER_H
+#define DIRPREFETCHER_H
+
+#include <QCache>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <atomic>
+
+class QThread;
+
+// Lists and stats the directories the user is likely to open next, before
+// they are opened.
+//
+// QFileSystemModel only reads a directory once it is shown, which on a cold
+// cache or a network mount means a visible pause on every click. Hovering,
+// selecting or expanding a directory in a tree hands it to the prefetcher,
+// whose low-priority thread reads it, stats every entry so the kernel keeps
+// the inodes, and then moves on to its children and siblings. When the model
+// gets to the directory, everything it asks for is already in memory.
+//
+// The disk is not flooded: one directory is read at a time, only the most
+// recent requests are kept, each new request drops the neighbours queued
+// for the previous one, and directories whose modification time has not
+// changed since they were read are skipped using a bounded cache of
+// listings.
+class DirPrefetcher : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr int maxTargets = 8;
+    static constexpr int maxNeighbours = 64;
+    static constexpr int maxStatsPerDirectory = 10000;
+    static constexpr int cacheCost = 65536;
+
+    explicit DirPrefetcher(QObject *parent = nullptr);
+    ~DirPrefetcher();
+
+    void prefetch(const QString& directory, bool withNeighbours);
+
+signals:
+    // A directory asked for with prefetch() has been read.
+    void prefetched(const QString& directory);
+
+private:
+    struct Listing {
+        qint64 modified;
+        QStringList subdirectories;
+    };
+
+    struct Request {
+        QString path;
+        bool withNeighbours;
+    };
+
+    void run();
+    bool warm(const QString& directory, QStringList& subdirectories);
+
+    QThread *worker;
+    QMutex mutex;
+    QWaitCondition requestAvailable;
+    QList<Request> targets;
+    QStringList neighbours;
+    QCache<QString, Listing> listings;
+    std::atomic<bool> stopping;
+};
+
+#endif // DIRPREFETCHER_H
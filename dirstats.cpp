@@ -0,0 +1,355 @@
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThreadPool>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include "dirstats.h"
+#include "ioscheduler.h"
+#include "uringbackend.h"
+
+
+static QString joinPath(const QString& directory, const QString& name) {
+    return directory.endsWith('/') ? directory + name : directory + '/' + name;
+}
+
+// Lists one directory without descending; false if it cannot be opened.
+static bool listDirectory(const QString& directory, QHash<QString, DirStats::Entry>& listing) {
+#ifdef Q_OS_UNIX
+    DIR* handle = ::opendir(QFile::encodeName(directory).constData());
+    if (!handle) {
+        return false;
+    }
+    const int fd = ::dirfd(handle);
+    QVector<QByteArray> names;
+    while (const dirent* entry = ::readdir(handle)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+        names.append(QByteArray(name));
+    }
+
+    // Batched through io_uring when available, fstatat() per name if not.
+    QVector<UringBackend::EntryStatus> statuses;
+    if (!UringBackend::statEntries(fd, names, statuses)) {
+        statuses.fill(UringBackend::EntryStatus(), names.size());
+        for (int i = 0; i < names.size(); ++i) {
+            struct stat info;
+            if (::fstatat(fd, names.at(i).constData(), &info, AT_SYMLINK_NOFOLLOW) == 0) {
+                UringBackend::EntryStatus& status = statuses[i];
+                status.size = qint64(info.st_size);
+                status.mode = info.st_mode;
+                status.modified = qint64(info.st_mtim.tv_sec);
+            }
+        }
+    }
+    ::closedir(handle);
+
+    for (int i = 0; i < names.size(); ++i) {
+        const UringBackend::EntryStatus& status = statuses.at(i);
+        if (status.size < 0) {
+            continue;
+        }
+        DirStats::Entry item;
+        item.directory = S_ISDIR(status.mode);
+        item.size = S_ISREG(status.mode) ? status.size : 0;
+        item.modified = status.modified;
+        listing.insert(QFile::decodeName(names.at(i)), item);
+    }
+    return true;
+#else
+    QDir dir(directory);
+    if (!dir.exists()) {
+        return false;
+    }
+    QDirIterator it(directory, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    while (it.hasNext()) {
+        it.next();
+        const QFileInfo info = it.fileInfo();
+        DirStats::Entry item;
+        item.directory = info.isDir() && !info.isSymLink();
+        item.size = info.isFile() && !info.isSymLink() ? info.size() : 0;
+        item.modified = info.lastModified().toSecsSinceEpoch();
+        listing.insert(it.fileName(), item);
+    }
+    return true;
+#endif
+}
+
+namespace {
+
+// Each directory found is a task of its own in the same pool.
+struct Walk {
+    QThreadPool pool;
+    QMutex mutex;
+    QHash<QString, QHash<QString, DirStats::Entry>> listings;
+    const std::atomic<bool>& cancelled;
+
+    explicit Walk(const std::atomic<bool>& cancelled)
+            : cancelled(cancelled) {
+    }
+
+    void addDirectory(const QString& path) {
+        pool.start([this, path]() { list(path); });
+    }
+
+    void list(const QString& directory) {
+        if (cancelled) {
+            return;
+        }
+        QHash<QString, DirStats::Entry> listing;
+        if (!listDirectory(directory, listing)) {
+            return;
+        }
+        for (auto it = listing.cbegin(); it != listing.cend(); ++it) {
+            if (it->directory) {
+                addDirectory(joinPath(directory, it.key()));
+            }
+        }
+        QMutexLocker locker(&mutex);
+        listings.insert(directory, listing);
+    }
+};
+
+}
+
+static void walkTree(const QString& root, QHash<QString, QHash<QString, DirStats::Entry>>& listings,
+                     const std::atomic<bool>& cancelled) {
+    Walk walk(cancelled);
+    walk.pool.setMaxThreadCount(IoScheduler::instance().device(root).concurrency);
+    walk.addDirectory(root);
+    walk.pool.waitForDone();
+    listings.swap(walk.listings);
+}
+
+static int bucketOf(qint64 size) {
+    if (size <= 0) {
+        return 0;
+    }
+    int bucket = 1;
+    for (qint64 limit = 4096; bucket < DirStats::bucketCount - 1 && size >= limit; limit *= 16) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+// The extension in lower case, or nothing for names without one and for
+// hidden files like ".profile".
+static QString typeOf(const QString& name) {
+    const int dot = name.lastIndexOf('.');
+    if (dot <= 0 || dot == name.size() - 1) {
+        return QString();
+    }
+    return name.mid(dot + 1).toLower();
+}
+
+
+qint64 DirStats::bucketLimit(int bucket) {
+    if (bucket <= 0) {
+        return 0;
+    }
+    if (bucket >= bucketCount - 1) {
+        return -1;
+    }
+    return qint64(4096) << (4 * (bucket - 1));
+}
+
+bool DirStats::scan(const QString& rootPath, const std::atomic<bool>& cancelled) {
+    *this = DirStats();
+    root = QDir(rootPath).absolutePath();
+    walkTree(root, listings, cancelled);
+    if (cancelled) {
+        return false;
+    }
+    for (auto listing = listings.cbegin(); listing != listings.cend(); ++listing) {
+        for (auto entry = listing->cbegin(); entry != listing->cend(); ++entry) {
+            add(listing.key(), entry.key(), entry.value(), 1);
+        }
+    }
+    return true;
+}
+
+void DirStats::updateDirectory(const QString& directory, QStringList& appeared, QStringList& removed) {
+    if (!listings.contains(directory)) {
+        return;
+    }
+    Listing fresh;
+    if (!listDirectory(directory, fresh)) {
+        // Its entry goes when its parent is listed again.
+        removeTree(directory, removed);
+        return;
+    }
+
+    // Copied, as growing or shrinking the tree rehashes listings.
+    const Listing previous = listings.value(directory);
+    auto differs = [](const Entry& first, const Entry& second) {
+        return first.directory != second.directory || first.size != second.size
+               || first.modified != second.modified;
+    };
+    for (auto old = previous.cbegin(); old != previous.cend(); ++old) {
+        const auto now = fresh.constFind(old.key());
+        if (now == fresh.cend() || differs(old.value(), now.value())) {
+            add(directory, old.key(), old.value(), -1);
+            if (old->directory && (now == fresh.cend() || !now->directory)) {
+                removeTree(joinPath(directory, old.key()), removed);
+            }
+        }
+    }
+    for (auto now = fresh.cbegin(); now != fresh.cend(); ++now) {
+        const auto old = previous.constFind(now.key());
+        if (old == previous.cend() || differs(old.value(), now.value())) {
+            add(directory, now.key(), now.value(), 1);
+            if (now->directory && (old == previous.cend() || !old->directory)) {
+                appeared.append(joinPath(directory, now.key()));
+            }
+        }
+    }
+    listings.insert(directory, fresh);
+}
+
+QString DirStats::rootPath() const {
+    return root;
+}
+
+QStringList DirStats::directories() const {
+    return listings.keys();
+}
+
+bool DirStats::contains(const QString& directory) const {
+    return listings.contains(directory);
+}
+
+DirStats::Totals DirStats::totals() const {
+    return fileTotals;
+}
+
+qint64 DirStats::directoryCount() const {
+    return subdirectories;
+}
+
+DirStats::Totals DirStats::bucket(int bucket) const {
+    return buckets[bucket];
+}
+
+const QHash<QString, DirStats::Totals>& DirStats::types() const {
+    return typeTotals;
+}
+
+DirStats::Extreme DirStats::oldest() {
+    if (extremesStale) {
+        findExtremes();
+    }
+    return oldestFile;
+}
+
+DirStats::Extreme DirStats::newest() {
+    if (extremesStale) {
+        findExtremes();
+    }
+    return newestFile;
+}
+
+void DirStats::add(const QString& directory, const QString& name, const Entry& entry, int sign) {
+    if (entry.directory) {
+        subdirectories += sign;
+        return;
+    }
+    fileTotals.files += sign;
+    fileTotals.bytes += sign * entry.size;
+    Totals& sizeBucket = buckets[bucketOf(entry.size)];
+    sizeBucket.files += sign;
+    sizeBucket.bytes += sign * entry.size;
+
+    const QString type = typeOf(name);
+    Totals& typeTotal = typeTotals[type];
+    typeTotal.files += sign;
+    typeTotal.bytes += sign * entry.size;
+    if (typeTotal.files <= 0) {
+        typeTotals.remove(type);
+    }
+
+    if (extremesStale) {
+        return;
+    }
+    // Most files are neither, so the path is only put together when needed.
+    if (sign > 0) {
+        if (oldestFile.path.isEmpty() || entry.modified < oldestFile.modified) {
+            oldestFile = {joinPath(directory, name), entry.modified};
+        }
+        if (newestFile.path.isEmpty() || entry.modified > newestFile.modified) {
+            newestFile = {joinPath(directory, name), entry.modified};
+        }
+    } else if (entry.modified == oldestFile.modified || entry.modified == newestFile.modified) {
+        const QString path = joinPath(directory, name);
+        extremesStale = path == oldestFile.path || path == newestFile.path;
+    }
+}
+
+bool DirStats::listTree(const QString& directory, QHash<QString, Listing>& tree,
+                        const std::atomic<bool>& cancelled) {
+    walkTree(directory, tree, cancelled);
+    return !cancelled;
+}
+
+void DirStats::addTree(const QString& directory, const QHash<QString, Listing>& tree, QStringList& added) {
+    // Its parent may have been listed again while the tree was read.
+    const QFileInfo info(directory);
+    const auto parent = listings.constFind(info.path());
+    if (listings.contains(directory) || parent == listings.cend() || !parent->value(info.fileName()).directory) {
+        return;
+    }
+    for (auto listing = tree.cbegin(); listing != tree.cend(); ++listing) {
+        if (listings.contains(listing.key())) {
+            continue;
+        }
+        for (auto entry = listing->cbegin(); entry != listing->cend(); ++entry) {
+            add(listing.key(), entry.key(), entry.value(), 1);
+        }
+        listings.insert(listing.key(), listing.value());
+        added.append(listing.key());
+    }
+}
+
+void DirStats::removeTree(const QString& directory, QStringList& removed) {
+    const QString prefix = joinPath(directory, QString());
+    for (auto listing = listings.begin(); listing != listings.end();) {
+        if (listing.key() != directory && !listing.key().startsWith(prefix)) {
+            ++listing;
+            continue;
+        }
+        for (auto entry = listing->cbegin(); entry != listing->cend(); ++entry) {
+            add(listing.key(), entry.key(), entry.value(), -1);
+        }
+        removed.append(listing.key());
+        listing = listings.erase(listing);
+    }
+}
+
+void DirStats::findExtremes() {
+    oldestFile = Extreme();
+    newestFile = Extreme();
+    extremesStale = false;
+    for (auto listing = listings.cbegin(); listing != listings.cend(); ++listing) {
+        for (auto entry = listing->cbegin(); entry != listing->cend(); ++entry) {
+            if (entry->directory) {
+                continue;
+            }
+            if (oldestFile.path.isEmpty() || entry->modified < oldestFile.modified) {
+                oldestFile = {joinPath(listing.key(), entry.key()), entry->modified};
+            }
+            if (newestFile.path.isEmpty() || entry->modified > newestFile.modified) {
+                newestFile = {joinPath(listing.key(), entry.key()), entry->modified};
+            }
+        }
+    }
+}
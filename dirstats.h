@@ -0,0 +1,89 @@
+#ifndef DIRSTATS_H
+#define DIRSTATS_H
+
+#include <QHash>
+#include <QStringList>
+
+#include <atomic>
+
+// File count, size, size histogram, breakdown by type and the oldest and
+// newest file of a directory tree.
+//
+// The first scan walks the tree in parallel, one task per directory, like
+// Preflight. It keeps every directory's listing, so that a change reported
+// for one directory is applied by listing just that directory again and
+// adding or subtracting the difference; the totals never need a walk of
+// the whole tree after that. A subdirectory that appears is read with
+// listTree(), which can run on another thread, and counted by addTree().
+class DirStats {
+public:
+    struct Entry {
+        qint64 size = 0;
+        qint64 modified = 0;
+        bool directory = false;
+    };
+
+    typedef QHash<QString, Entry> Listing;
+
+    struct Totals {
+        qint64 files = 0;
+        qint64 bytes = 0;
+    };
+
+    struct Extreme {
+        QString path;
+        qint64 modified = 0;
+    };
+
+    // Files are bucketed by size: empty, then below 4 KiB, 64 KiB, 1 MiB and
+    // so on by factors of 16, and the rest.
+    static constexpr int bucketCount = 8;
+    static qint64 bucketLimit(int bucket);
+
+    // Returns false if cancelled before it finished.
+    bool scan(const QString& root, const std::atomic<bool>& cancelled);
+
+    // Lists directory again and applies what changed in it. Directories that
+    // disappeared, including whole subtrees, are added to removed. New
+    // subdirectories are added to appeared without being read; their trees
+    // are read with listTree() and handed to addTree().
+    void updateDirectory(const QString& directory, QStringList& appeared, QStringList& removed);
+
+    // Reads the tree below directory, one listing per directory. Touches no
+    // DirStats, so it may run on any thread. Returns false if cancelled.
+    static bool listTree(const QString& directory, QHash<QString, Listing>& tree,
+                         const std::atomic<bool>& cancelled);
+    // Counts a tree read by listTree() and adds its directories to added.
+    // Ignored if directory left the tree or is counted already.
+    void addTree(const QString& directory, const QHash<QString, Listing>& tree, QStringList& added);
+
+    QString rootPath() const;
+    QStringList directories() const;
+    bool contains(const QString& directory) const;
+
+    Totals totals() const;
+    qint64 directoryCount() const;
+    Totals bucket(int bucket) const;
+    const QHash<QString, Totals>& types() const;
+    Extreme oldest();
+    Extreme newest();
+
+private:
+    void add(const QString& directory, const QString& name, const Entry& entry, int sign);
+    void removeTree(const QString& directory, QStringList& removed);
+    void findExtremes();
+
+    QString root;
+    QHash<QString, Listing> listings;
+
+    Totals fileTotals;
+    qint64 subdirectories = 0;
+    Totals buckets[bucketCount];
+    QHash<QString, Totals> typeTotals;
+    Extreme oldestFile;
+    Extreme newestFile;
+    // Set when the oldest or newest file went away; found again on demand.
+    bool extremesStale = false;
+};
+
+#endif // DIRSTATS_H
@@ -0,0 +1,439 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QSocketNotifier>
+#include <QDebug>
+
+#include <algorithm>
+#include <utility>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <sys/statfs.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+#include "dirwatcher.h"
+
+
+static const int defaultBatchInterval = 250;
+static const int defaultRescanInterval = 2000;
+static const int defaultMaxBatchSize = 4096;
+
+#ifdef Q_OS_LINUX
+static const uint32_t inotifyMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_MOVED_FROM | IN_MOVED_TO
+                                    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR;
+
+#ifdef FAN_REPORT_DFID_NAME
+static const uint64_t fanotifyMask = FAN_CREATE | FAN_DELETE | FAN_MODIFY | FAN_ATTRIB | FAN_MOVED_FROM | FAN_MOVED_TO
+                                     | FAN_DELETE_SELF | FAN_MOVE_SELF | FAN_ONDIR | FAN_EVENT_ON_CHILD;
+
+// fanotify reports directories as (filesystem id, file handle) pairs, so a
+// watched directory is identified by the same bytes taken at mark time.
+static QByteArray fanotifyKey(const void *fsid, int handleType, const unsigned char *handle, unsigned int length) {
+    QByteArray key(static_cast<const char*>(fsid), 8);
+    key.append(reinterpret_cast<const char*>(&handleType), sizeof(handleType));
+    key.append(reinterpret_cast<const char*>(handle), length);
+    return key;
+}
+
+static QByteArray fanotifyKeyForPath(const QString& directory) {
+    QByteArray path = QFile::encodeName(directory);
+
+    struct statfs fileSystem;
+    if (::statfs(path.constData(), &fileSystem) != 0) {
+        return QByteArray();
+    }
+
+    alignas(struct file_handle) char storage[sizeof(struct file_handle) + MAX_HANDLE_SZ];
+    auto *handle = reinterpret_cast<struct file_handle*>(storage);
+    handle->handle_bytes = MAX_HANDLE_SZ;
+    int mountId;
+    if (::name_to_handle_at(AT_FDCWD, path.constData(), handle, &mountId, 0) != 0) {
+        return QByteArray();
+    }
+    return fanotifyKey(&fileSystem.f_fsid, handle->handle_type, handle->f_handle, handle->handle_bytes);
+}
+#endif
+#endif
+
+
+DirWatcher::DirWatcher(QObject *parent)
+        : QObject(parent),
+          currentBackend(Polling),
+          notifyFd(-1),
+          notifier(nullptr),
+          pollingWatcher(nullptr),
+          maxBatchSize(defaultMaxBatchSize),
+          overflowMode(false) {
+    batchTimer.setSingleShot(true);
+    batchTimer.setInterval(defaultBatchInterval);
+    connect(&batchTimer, &QTimer::timeout, this, &DirWatcher::flushBatches);
+
+    rescanTimer.setInterval(defaultRescanInterval);
+    connect(&rescanTimer, &QTimer::timeout, this, &DirWatcher::rescanDirtyDirectories);
+
+#ifdef Q_OS_LINUX
+#ifdef FAN_REPORT_DFID_NAME
+    // Needs CAP_SYS_ADMIN; an unbounded queue means no overflows to recover from.
+    notifyFd = ::fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_UNLIMITED_QUEUE
+                               | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY | O_CLOEXEC);
+    if (notifyFd >= 0) {
+        currentBackend = Fanotify;
+    }
+#endif
+    if (notifyFd < 0) {
+        notifyFd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (notifyFd >= 0) {
+            currentBackend = Inotify;
+        }
+    }
+    if (notifyFd >= 0) {
+        notifier = new QSocketNotifier(notifyFd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &DirWatcher::readEvents);
+        return;
+    }
+    qWarning() << "Kernel file notifications unavailable, falling back to QFileSystemWatcher";
+#endif
+
+    currentBackend = Polling;
+    pollingWatcher = new QFileSystemWatcher(this);
+    connect(pollingWatcher, &QFileSystemWatcher::directoryChanged, this, &DirWatcher::pollingDirectoryChanged);
+}
+
+DirWatcher::~DirWatcher() {
+#ifdef Q_OS_LINUX
+    if (notifyFd >= 0) {
+        delete notifier;
+        ::close(notifyFd);
+    }
+#endif
+}
+
+void DirWatcher::setBatchInterval(int msec) {
+    batchTimer.setInterval(qMax(0, msec));
+}
+
+int DirWatcher::batchInterval() const {
+    return batchTimer.interval();
+}
+
+void DirWatcher::setRescanInterval(int msec) {
+    rescanTimer.setInterval(qMax(1, msec));
+}
+
+int DirWatcher::rescanInterval() const {
+    return rescanTimer.interval();
+}
+
+void DirWatcher::setMaxBatchSize(int entries) {
+    maxBatchSize = qMax(1, entries);
+}
+
+DirWatcher::Backend DirWatcher::backend() const {
+    return currentBackend;
+}
+
+QStringList DirWatcher::directories() const {
+    return QStringList(watched.begin(), watched.end());
+}
+
+bool DirWatcher::addPath(const QString& directory) {
+    const QString path = QDir::cleanPath(QFileInfo(directory).absoluteFilePath());
+    if (path.isEmpty() || watched.contains(path)) {
+        return !path.isEmpty();
+    }
+
+    switch (currentBackend) {
+    case Fanotify: {
+#if defined(Q_OS_LINUX) && defined(FAN_REPORT_DFID_NAME)
+        QByteArray key = fanotifyKeyForPath(path);
+        if (key.isEmpty() || ::fanotify_mark(notifyFd, FAN_MARK_ADD | FAN_MARK_ONLYDIR, fanotifyMask,
+                                             AT_FDCWD, QFile::encodeName(path).constData()) != 0) {
+            return false;
+        }
+        fanotifyHandles.insert(key, path);
+        fanotifyKeys.insert(path, key);
+#endif
+        break;
+    }
+    case Inotify: {
+#ifdef Q_OS_LINUX
+        int wd = ::inotify_add_watch(notifyFd, QFile::encodeName(path).constData(), inotifyMask);
+        if (wd < 0) {
+            return false;
+        }
+        inotifyWatches.insert(wd, path);
+        inotifyDescriptors.insert(path, wd);
+#endif
+        break;
+    }
+    case Polling:
+        if (!pollingWatcher->addPath(path)) {
+            return false;
+        }
+        break;
+    }
+
+    watched.insert(path);
+    return true;
+}
+
+void DirWatcher::removePath(const QString& directory) {
+    const QString path = QDir::cleanPath(QFileInfo(directory).absoluteFilePath());
+    if (!watched.remove(path)) {
+        return;
+    }
+    pending.remove(path);
+    dirty.remove(path);
+
+    switch (currentBackend) {
+    case Fanotify:
+#if defined(Q_OS_LINUX) && defined(FAN_REPORT_DFID_NAME)
+        ::fanotify_mark(notifyFd, FAN_MARK_REMOVE | FAN_MARK_ONLYDIR, fanotifyMask,
+                        AT_FDCWD, QFile::encodeName(path).constData());
+        fanotifyHandles.remove(fanotifyKeys.take(path));
+#endif
+        break;
+    case Inotify:
+#ifdef Q_OS_LINUX
+        if (inotifyDescriptors.contains(path)) {
+            int wd = inotifyDescriptors.take(path);
+            inotifyWatches.remove(wd);
+            ::inotify_rm_watch(notifyFd, wd);
+        }
+#endif
+        break;
+    case Polling:
+        pollingWatcher->removePath(path);
+        break;
+    }
+}
+
+void DirWatcher::readEvents() {
+    if (currentBackend == Fanotify) {
+        readFanotifyEvents();
+    } else {
+        readInotifyEvents();
+    }
+}
+
+void DirWatcher::readInotifyEvents() {
+#ifdef Q_OS_LINUX
+    alignas(struct inotify_event) char buffer[64 * 1024];
+    ssize_t length;
+    while ((length = ::read(notifyFd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + length;) {
+            const auto *event = reinterpret_cast<const struct inotify_event*>(ptr);
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                enterOverflowMode();
+                continue;
+            }
+
+            const QString directory = inotifyWatches.value(event->wd);
+            if (directory.isEmpty()) {
+                continue;
+            }
+
+            if (event->mask & IN_IGNORED) {
+                // The kernel dropped the watch, usually because the directory is gone.
+                inotifyWatches.remove(event->wd);
+                inotifyDescriptors.remove(directory);
+                watched.remove(directory);
+                recordRescan(directory);
+                continue;
+            }
+
+            const QString name = event->len ? QFile::decodeName(event->name) : QString();
+            if (name.isEmpty() || (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF))) {
+                recordRescan(directory);
+            } else if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                recordEvent(directory, name, Created);
+            } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                recordEvent(directory, name, Removed);
+            } else {
+                recordEvent(directory, name, Modified);
+            }
+        }
+    }
+#endif
+}
+
+void DirWatcher::readFanotifyEvents() {
+#if defined(Q_OS_LINUX) && defined(FAN_REPORT_DFID_NAME)
+    alignas(struct fanotify_event_metadata) char buffer[64 * 1024];
+    ssize_t length;
+    while ((length = ::read(notifyFd, buffer, sizeof(buffer))) > 0) {
+        auto *metadata = reinterpret_cast<struct fanotify_event_metadata*>(buffer);
+        for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+            if (metadata->fd >= 0) {
+                ::close(metadata->fd);
+            }
+            if (metadata->mask & FAN_Q_OVERFLOW) {
+                enterOverflowMode();
+                continue;
+            }
+            if (metadata->event_len < sizeof(*metadata) + sizeof(struct fanotify_event_info_fid)) {
+                continue;
+            }
+
+            auto *info = reinterpret_cast<struct fanotify_event_info_fid*>(metadata + 1);
+            if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME
+                && info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID) {
+                continue;
+            }
+
+            auto *handle = reinterpret_cast<struct file_handle*>(info->handle);
+            const QString directory = fanotifyHandles.value(
+                    fanotifyKey(&info->fsid, handle->handle_type, handle->f_handle, handle->handle_bytes));
+            if (directory.isEmpty()) {
+                continue;
+            }
+
+            QString name;
+            if (info->hdr.info_type == FAN_EVENT_INFO_TYPE_DFID_NAME) {
+                name = QFile::decodeName(reinterpret_cast<const char*>(handle->f_handle + handle->handle_bytes));
+            }
+
+            const bool appeared = metadata->mask & (FAN_CREATE | FAN_MOVED_TO);
+            const bool vanished = metadata->mask & (FAN_DELETE | FAN_MOVED_FROM);
+
+            if (name.isEmpty() || name == "." || (metadata->mask & (FAN_DELETE_SELF | FAN_MOVE_SELF))) {
+                recordRescan(directory);
+            } else if (appeared && vanished) {
+                // fanotify merges queued events for the same name, losing
+                // their order; the file system knows which one came last.
+                recordEvent(directory, name, QFileInfo::exists(directory + "/" + name) ? Created : Removed);
+            } else if (appeared) {
+                recordEvent(directory, name, Created);
+            } else if (vanished) {
+                recordEvent(directory, name, Removed);
+            } else {
+                recordEvent(directory, name, Modified);
+            }
+        }
+    }
+#endif
+}
+
+void DirWatcher::pollingDirectoryChanged(const QString& directory) {
+    recordRescan(directory);
+}
+
+void DirWatcher::recordEvent(const QString& directory, const QString& name, EventKind kind) {
+    if (overflowMode) {
+        dirty.insert(directory);
+        return;
+    }
+
+    Batch& batch = pending[directory];
+    scheduleFlush();
+    if (batch.rescan) {
+        return;
+    }
+
+    // Collapse the history of a name within the window to its net effect.
+    switch (kind) {
+    case Created:
+        if (batch.removed.remove(name)) {
+            batch.modified.insert(name);
+        } else {
+            batch.created.insert(name);
+        }
+        break;
+    case Modified:
+        if (!batch.created.contains(name)) {
+            batch.modified.insert(name);
+        }
+        break;
+    case Removed:
+        batch.modified.remove(name);
+        if (!batch.created.remove(name)) {
+            batch.removed.insert(name);
+        }
+        break;
+    }
+
+    if (batch.created.size() + batch.modified.size() + batch.removed.size() > maxBatchSize) {
+        recordRescan(directory);
+    }
+}
+
+void DirWatcher::recordRescan(const QString& directory) {
+    if (overflowMode) {
+        dirty.insert(directory);
+        return;
+    }
+
+    Batch& batch = pending[directory];
+    batch.rescan = true;
+    batch.created.clear();
+    batch.modified.clear();
+    batch.removed.clear();
+    scheduleFlush();
+}
+
+void DirWatcher::scheduleFlush() {
+    // The window opens with the first event, so a constant stream of events
+    // still gets delivered once per interval instead of being postponed forever.
+    if (!batchTimer.isActive()) {
+        batchTimer.start();
+    }
+}
+
+void DirWatcher::flushBatches() {
+    const QHash<QString, Batch> batches = std::exchange(pending, {});
+    for (auto it = batches.cbegin(); it != batches.cend(); ++it) {
+        const Batch& batch = it.value();
+        if (batch.rescan) {
+            emit rescanRequired(it.key());
+            continue;
+        }
+        if (batch.created.isEmpty() && batch.modified.isEmpty() && batch.removed.isEmpty()) {
+            continue;
+        }
+
+        QStringList created(batch.created.begin(), batch.created.end());
+        QStringList modified(batch.modified.begin(), batch.modified.end());
+        QStringList removed(batch.removed.begin(), batch.removed.end());
+        std::sort(created.begin(), created.end());
+        std::sort(modified.begin(), modified.end());
+        std::sort(removed.begin(), removed.end());
+        emit directoryChanged(it.key(), created, modified, removed);
+    }
+}
+
+void DirWatcher::enterOverflowMode() {
+    // Individual events were lost, so every watched directory may be stale.
+    if (!overflowMode) {
+        qWarning() << "Directory watcher queue overflowed, switching to periodic rescans";
+    }
+    overflowMode = true;
+    pending.clear();
+    batchTimer.stop();
+    dirty.unite(watched);
+    if (!rescanTimer.isActive()) {
+        rescanTimer.start();
+        rescanDirtyDirectories();
+    }
+}
+
+void DirWatcher::rescanDirtyDirectories() {
+    if (dirty.isEmpty()) {
+        // A whole interval without activity: go back to incremental batches.
+        overflowMode = false;
+        rescanTimer.stop();
+        return;
+    }
+
+    const QSet<QString> directories = std::exchange(dirty, {});
+    for (const QString& directory: directories) {
+        emit rescanRequired(directory);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef DIRWATCHER_H
+#define DIRWATCHER_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+
+class QSocketNotifier;
+class QFileSystemWatcher;
+
+// Directory watcher that coalesces bursts of change events.
+//
+// Busy directories (build output, log spools) produce a steady stream of
+// create/modify/delete events. Instead of refreshing the views for each one,
+// events are collected for a configurable window and delivered as a single
+// batch per directory. If the kernel event queue overflows, or a batch gets
+// too large to be worth describing, the watcher falls back to asking for
+// periodic rescans of the affected directories until things calm down.
+//
+// On Linux fanotify is used when the process is allowed to (it has an
+// unbounded queue), otherwise inotify. Other platforms go through
+// QFileSystemWatcher, which only reports that a directory changed.
+class DirWatcher : public QObject {
+    Q_OBJECT
+
+public:
+    enum Backend {
+        Fanotify,
+        Inotify,
+        Polling
+    };
+
+    explicit DirWatcher(QObject *parent = nullptr);
+    ~DirWatcher();
+
+    void setBatchInterval(int msec);
+    int batchInterval() const;
+    void setRescanInterval(int msec);
+    int rescanInterval() const;
+    void setMaxBatchSize(int entries);
+
+    bool addPath(const QString& directory);
+    void removePath(const QString& directory);
+    QStringList directories() const;
+    Backend backend() const;
+
+signals:
+    void directoryChanged(const QString& directory, const QStringList& created,
+                          const QStringList& modified, const QStringList& removed);
+    void rescanRequired(const QString& directory);
+
+private slots:
+    void readEvents();
+    void flushBatches();
+    void rescanDirtyDirectories();
+    void pollingDirectoryChanged(const QString& directory);
+
+private:
+    enum EventKind {
+        Created,
+        Modified,
+        Removed
+    };
+
+    struct Batch {
+        QSet<QString> created;
+        QSet<QString> modified;
+        QSet<QString> removed;
+        bool rescan = false;
+    };
+
+    void recordEvent(const QString& directory, const QString& name, EventKind kind);
+    void recordRescan(const QString& directory);
+    void enterOverflowMode();
+    void scheduleFlush();
+    void readInotifyEvents();
+    void readFanotifyEvents();
+
+    Backend currentBackend;
+    int notifyFd;
+    QSocketNotifier *notifier;
+    QFileSystemWatcher *pollingWatcher;
+
+    QHash<int, QString> inotifyWatches;
+    QHash<QString, int> inotifyDescriptors;
+    QHash<QByteArray, QString> fanotifyHandles;
+    QHash<QString, QByteArray> fanotifyKeys;
+    QSet<QString> watched;
+
+    QHash<QString, Batch> pending;
+    QSet<QString> dirty;
+    QTimer batchTimer;
+    QTimer rescanTimer;
+    int maxBatchSize;
+    bool overflowMode;
+};
+
+#endif // DIRWATCHER_H
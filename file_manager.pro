@@ -11,12 +11,75 @@ CONFIG += c++17
 SOURCES += \
     main.cpp \
     mainwidget.cpp \
+    copyjournal.cpp \
+    fileoperations.cpp \
+    dirwatcher.cpp \
+    listingsnapshot.cpp \
+    mappedfile.cpp \
+    lineindex.cpp \
+    fileviewer.cpp \
+    hexview.cpp \
+    bytesearch.cpp \
+    movejob.cpp \
+    ioscheduler.cpp \
+    copyplan.cpp \
+    iouring.cpp \
+    uringbackend.cpp \
+    checksum.cpp \
+    panefilter.cpp \
+    pathindex.cpp \
+    pathpalette.cpp \
+    flatlist.cpp \
+    dirprefetcher.cpp \
+    panehistory.cpp \
+    renameplan.cpp \
+    renamedialog.cpp \
+    dedupejob.cpp \
+    preflight.cpp \
+    throttle.cpp \
+    jobpanel.cpp \
+    splitjoin.cpp \
+    archiveindex.cpp \
+    dirstats.cpp \
+    statspanel.cpp \
 
 INCLUDEPATH += /usr/include/
 
 
 HEADERS += \
     mainwidget.h \
+    copyjournal.h \
+    fileoperations.h \
+    dirwatcher.h \
+    listingsnapshot.h \
+    mappedfile.h \
+    lineindex.h \
+    fileviewer.h \
+    hexview.h \
+    bytesearch.h \
+    movejob.h \
+    ioscheduler.h \
+    copyplan.h \
+    iouring.h \
+    uringbackend.h \
+    checksum.h \
+    panefilter.h \
+    pathindex.h \
+    pathpalette.h \
+    flatlist.h \
+    dirprefetcher.h \
+    panehistory.h \
+    renameplan.h \
+    renamedialog.h \
+    dedupejob.h \
+    preflight.h \
+    throttle.h \
+    jobpanel.h \
+    splitjoin.h \
+    archiveindex.h \
+    dirstats.h \
+    statspanel.h \
+    progressring.h \
 
 FORMS += \
     mainwidget.ui
@@ -0,0 +1,716 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QScopedPointer>
+#include <QSet>
+#include <QStorageInfo>
+#include <QDebug>
+
+#include <atomic>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+#include "fileoperations.h"
+#include "ioscheduler.h"
+#include "copyplan.h"
+#include "uringbackend.h"
+#include "checksum.h"
+#include "preflight.h"
+#include "throttle.h"
+
+
+static std::atomic<bool> verifyCopies(false);
+static thread_local TransferProgress* transferProgress = nullptr;
+static thread_local Throttle* jobThrottle = nullptr;
+
+static void reportCopied(qint64 bytes) {
+    if (transferProgress && bytes > 0) {
+        transferProgress->add(bytes);
+    }
+}
+
+static void reportFinished(const QString& path) {
+    if (transferProgress) {
+        transferProgress->fileDone(path);
+    }
+}
+
+static bool isThrottled() {
+    return Throttle::global().isLimited() || (jobThrottle && jobThrottle->isLimited());
+}
+
+// Waits for the global and the job's limits to allow the next request. The
+// job's idle priority is picked up here too, so it can change mid-file.
+static void throttle(qint64 bytes, int operations, const TokenBucket::WaitHandler& aroundWait = nullptr) {
+    Throttle::applyIdlePriority(jobThrottle && jobThrottle->idlePriority());
+    if (!isThrottled()) {
+        return;
+    }
+    Throttle::global().consume(bytes, operations, aroundWait);
+    if (jobThrottle) {
+        jobThrottle->consume(bytes, operations, aroundWait);
+    }
+}
+
+
+static bool syncData(QFile& file) {
+    if (!file.flush()) {
+        return false;
+    }
+#if defined(Q_OS_LINUX)
+    return ::fdatasync(file.handle()) == 0;
+#elif defined(Q_OS_UNIX)
+    return ::fsync(file.handle()) == 0;
+#else
+    return true;
+#endif
+}
+
+// For files written by someone else, like an io_uring batch.
+static bool syncFile(const QString& path) {
+#ifdef Q_OS_UNIX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    const bool synced = ::fdatasync(fd) == 0;
+#else
+    const bool synced = ::fsync(fd) == 0;
+#endif
+    ::close(fd);
+    return synced;
+#else
+    Q_UNUSED(path);
+    return true;
+#endif
+}
+
+// The name of a new file lives in its directory, which has to reach the
+// disk as well before the file can be said to be there.
+static bool syncDirectory(const QString& path) {
+#ifdef Q_OS_UNIX
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#else
+    Q_UNUSED(path);
+    return true;
+#endif
+}
+
+// Every directory of a copied tree, and the one it was created in.
+static bool syncTree(const QString& path) {
+    if (!syncDirectory(QFileInfo(path).absolutePath())) {
+        return false;
+    }
+    const QFileInfo info(path);
+    if (!info.isDir() || info.isSymLink()) {
+        return true;
+    }
+    if (!syncDirectory(path)) {
+        return false;
+    }
+    QDirIterator it(path, QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot | QDir::NoSymLinks,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (!syncDirectory(it.next())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A file with fewer blocks allocated than its size has holes, and is worth
+// walking region by region; for any other file that would only add seeks.
+static bool isSparse(QFile& file) {
+#ifdef Q_OS_LINUX
+    struct stat info;
+    return ::fstat(file.handle(), &info) == 0 && qint64(info.st_blocks) * 512 < qint64(info.st_size);
+#else
+    Q_UNUSED(file);
+    return false;
+#endif
+}
+
+// Finds the data region at or after offset: returns its start and sets
+// dataEnd to where the next hole begins. Returns -1 when only a hole is
+// left, and -2 when the filesystem cannot tell.
+static qint64 nextDataRegion(QFile& file, qint64 offset, qint64& dataEnd) {
+#ifdef Q_OS_LINUX
+    const qint64 dataStart = ::lseek(file.handle(), offset, SEEK_DATA);
+    if (dataStart < 0) {
+        return errno == ENXIO ? -1 : -2;
+    }
+    dataEnd = ::lseek(file.handle(), dataStart, SEEK_HOLE);
+    if (dataEnd < 0) {
+        return -2;
+    }
+    return dataStart;
+#else
+    Q_UNUSED(file);
+    Q_UNUSED(offset);
+    Q_UNUSED(dataEnd);
+    return -2;
+#endif
+}
+
+// Reads a finished copy back and compares its hash with the one taken from
+// the source. The copy has been synced, so its pages are clean and can be
+// dropped from the cache; the read then really comes from the disk.
+static bool verifyCopy(const QString& destinationPath, quint64 expected) {
+    QFile file(destinationPath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        return false;
+    }
+#ifdef Q_OS_LINUX
+    ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_DONTNEED);
+#endif
+
+    ChecksumPipe checksum(FileOperations::chunkSize, file.size() > FileOperations::chunkSize);
+    while (true) {
+        char* data = checksum.acquire();
+        const qint64 bytesRead = file.read(data, FileOperations::chunkSize);
+        if (bytesRead < 0) {
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        checksum.submit(data, bytesRead);
+    }
+    return checksum.finish() == expected;
+}
+
+// Gives destinationPath the same inode as the already copied targetPath.
+// Fails on filesystems without hard links, and the caller copies instead.
+static bool linkFile(const QString& targetPath, const QString& destinationPath) {
+#ifdef Q_OS_UNIX
+    // A copy left behind by an interrupted run is replaced.
+    const QByteArray encodedDestination = QFile::encodeName(destinationPath);
+    ::unlink(encodedDestination.constData());
+    return ::link(QFile::encodeName(targetPath).constData(), encodedDestination.constData()) == 0;
+#else
+    Q_UNUSED(targetPath);
+    Q_UNUSED(destinationPath);
+    return false;
+#endif
+}
+
+// Recreates the symbolic link sourcePath at destinationPath, pointing to the
+// same target; the link itself is never followed.
+static bool copySymLink(const QString& sourcePath, const QString& destinationPath,
+                        CopyJournal* journal, const QString& relativePath) {
+    if (journal && journal->isCompleted(relativePath)) {
+        return true;
+    }
+
+#ifdef Q_OS_UNIX
+    QByteArray target(PATH_MAX, Qt::Uninitialized);
+    const ssize_t length = ::readlink(QFile::encodeName(sourcePath).constData(), target.data(), target.size());
+    if (length < 0 || length >= target.size()) {
+        qWarning() << "Could not read link:" << sourcePath;
+        return false;
+    }
+    target.truncate(int(length));
+
+    // A link left behind by an interrupted run is replaced.
+    const QByteArray encodedDestination = QFile::encodeName(destinationPath);
+    ::unlink(encodedDestination.constData());
+    if (::symlink(target.constData(), encodedDestination.constData()) != 0) {
+        qWarning() << "Could not create link:" << destinationPath << "-" << qt_error_string(errno);
+        return false;
+    }
+
+    if (journal) {
+        if (!syncDirectory(QFileInfo(destinationPath).absolutePath())) {
+            qWarning() << "Failed to sync the directory of:" << destinationPath;
+            return false;
+        }
+        journal->recordCompleted(relativePath);
+    }
+    reportFinished(destinationPath);
+    return true;
+#else
+    Q_UNUSED(destinationPath);
+    qWarning() << "Cannot copy symbolic links on this platform:" << sourcePath;
+    return false;
+#endif
+}
+
+
+bool FileOperations::copyFile(const QString& sourcePath, const QString& destinationPath,
+                              CopyJournal* journal, const QString& relativePath) {
+    if (journal && journal->isCompleted(relativePath)) {
+        return true;
+    }
+
+    // Opening both files.
+    throttle(0, 2);
+    IoScheduler::Slot slot(sourcePath, destinationPath);
+
+    // Unbuffered, because the read position is moved past holes with seeks
+    // on the descriptor itself.
+    QFile sourceFile(sourcePath);
+    if (!sourceFile.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qWarning() << "Could not open source file:" << sourcePath;
+        return false;
+    }
+
+    // A verified copy always starts over: the hash has to cover the part
+    // written before the interruption too.
+    const bool verify = verifiesCopies();
+    QFile destinationFile(destinationPath);
+    qint64 offset = journal && !verify ? journal->resumeOffset(relativePath) : 0;
+
+    // Only resume when the destination still holds everything the journal
+    // says was written; anything past the checkpoint is discarded.
+    if (offset > 0 && offset <= sourceFile.size() && destinationFile.size() >= offset
+        && destinationFile.open(QIODevice::ReadWrite)) {
+        destinationFile.resize(offset);
+        destinationFile.seek(offset);
+        sourceFile.seek(offset);
+    } else {
+        offset = 0;
+        if (!destinationFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Could not open destination file:" << destinationPath;
+            return false;
+        }
+    }
+
+    reportCopied(offset);
+
+    QByteArray buffer(chunkSize, Qt::Uninitialized);
+    qint64 copied = offset;
+    qint64 lastCheckpoint = offset;
+
+    // Sparse files (VM images, databases) are copied one data region at a
+    // time, and holes are skipped by seeking past them in the destination,
+    // so both copy time and disk use follow the real amount of data.
+    bool sparse = isSparse(sourceFile);
+    qint64 dataEnd = copied;
+
+    // Hashing runs on its own thread for anything larger than one buffer.
+    QScopedPointer<ChecksumPipe> sourceChecksum;
+    if (verify) {
+        sourceChecksum.reset(new ChecksumPipe(chunkSize, sourceFile.size() > chunkSize));
+    }
+
+    while (true) {
+        if (sparse && copied >= dataEnd) {
+            const qint64 dataStart = nextDataRegion(sourceFile, copied, dataEnd);
+            if (dataStart == -1) {
+                if (sourceChecksum) {
+                    sourceChecksum->submitZeros(sourceFile.size() - copied);
+                }
+                reportCopied(sourceFile.size() - copied);
+                copied = sourceFile.size();
+                break;
+            }
+            if (dataStart == -2) {
+                sparse = false;
+            } else {
+                if (sourceChecksum) {
+                    sourceChecksum->submitZeros(dataStart - copied);
+                }
+                reportCopied(dataStart - copied);
+                copied = dataStart;
+            }
+            if (!sourceFile.seek(copied) || !destinationFile.seek(copied)) {
+                qWarning() << "Failed to seek:" << sourcePath;
+                return false;
+            }
+        }
+
+        const qint64 readSize = sparse ? qMin(chunkSize, dataEnd - copied) : chunkSize;
+        // A read and a write per chunk.
+        throttleChunk(slot, readSize, 2);
+        char* data = sourceChecksum ? sourceChecksum->acquire() : buffer.data();
+        qint64 bytesRead = sourceFile.read(data, readSize);
+        if (bytesRead < 0) {
+            qWarning() << "Failed to read:" << sourcePath;
+            return false;
+        }
+        if (bytesRead == 0) {
+            break;
+        }
+        if (destinationFile.write(data, bytesRead) != bytesRead) {
+            qWarning() << "Failed to write:" << destinationPath;
+            return false;
+        }
+        if (sourceChecksum) {
+            sourceChecksum->submit(data, bytesRead);
+        }
+        copied += bytesRead;
+        reportCopied(bytesRead);
+
+        if (copied - lastCheckpoint >= checkpointInterval) {
+            if (journal) {
+                // The data must be on disk before the journal claims it is.
+                syncData(destinationFile);
+                journal->recordPartial(relativePath, copied);
+            }
+            lastCheckpoint = copied;
+
+            // Let other transfers waiting for the same disks take a turn.
+            slot.yield();
+        }
+    }
+
+    // A file that ends in a hole still needs its full length.
+    if (destinationFile.size() < copied && !destinationFile.resize(copied)) {
+        qWarning() << "Failed to write:" << destinationPath;
+        return false;
+    }
+
+    // A journaled file must be on disk before the journal says it is
+    // complete: a move deletes its source on the strength of that.
+    if ((verify || journal) && !syncData(destinationFile)) {
+        qWarning() << "Failed to sync:" << destinationPath;
+        return false;
+    }
+    destinationFile.close();
+    sourceFile.close();
+    QFile::setPermissions(destinationPath, QFile::permissions(sourcePath));
+
+    if (sourceChecksum && !verifyCopy(destinationPath, sourceChecksum->finish())) {
+        qWarning() << "Verification failed, copy differs from source:" << destinationPath;
+        return false;
+    }
+
+    if (journal) {
+        if (!syncDirectory(QFileInfo(destinationPath).absolutePath())) {
+            qWarning() << "Failed to sync the directory of:" << destinationPath;
+            return false;
+        }
+        journal->recordCompleted(relativePath);
+    }
+    reportFinished(destinationPath);
+    return true;
+}
+
+bool FileOperations::copyTree(const QString& sourcePath, const QString& destinationPath,
+                              CopyJournal* journal, const QString& relativePath) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<CopyPlan::Item> items;
+    if (!CopyPlan::collect(sourcePath, destinationPath, relativePath, items)) {
+        return false;
+    }
+    CopyPlan::stat(items);
+    CopyPlan::sortByPhysicalOrder(items);
+    const QVector<int> linkedTo = CopyPlan::findHardLinks(items);
+    const qint64 planningTime = timer.elapsed();
+
+    // Verified copies need the data to pass through the streaming path, and
+    // so do throttled ones: a batch cannot be paced once submitted.
+    QVector<bool> done(items.size(), false);
+    if (UringBackend::isEnabled() && !verifiesCopies() && !isThrottled()) {
+        // Small files go through io_uring in batches; large ones, and any
+        // the batches could not copy, take the streaming path below.
+        QVector<CopyPlan::Item> smallFiles;
+        QVector<int> smallIndexes;
+        for (int i = 0; i < items.size(); ++i) {
+            const CopyPlan::Item& item = items.at(i);
+            if (linkedTo.at(i) < 0 && !item.symLink && item.size >= 0 && item.size <= UringBackend::smallFileLimit
+                && !(journal && journal->isCompleted(item.relativePath))) {
+                smallFiles.append(item);
+                smallIndexes.append(i);
+            }
+        }
+
+        QVector<bool> copied;
+        IoScheduler::Slot slot(sourcePath, destinationPath);
+        if (UringBackend::copyFiles(smallFiles, copied)) {
+            // With a journal, files count as copied only once they and their
+            // names are on disk; any that cannot be synced are copied again
+            // below.
+            if (journal) {
+                QSet<QString> directories;
+                for (int i = 0; i < smallFiles.size(); ++i) {
+                    if (copied.at(i) && !syncFile(smallFiles.at(i).destinationPath)) {
+                        copied[i] = false;
+                    }
+                    if (copied.at(i)) {
+                        directories.insert(QFileInfo(smallFiles.at(i).destinationPath).absolutePath());
+                    }
+                }
+                for (const QString& directory: directories) {
+                    if (!syncDirectory(directory)) {
+                        qWarning() << "Failed to sync directory:" << directory;
+                        return false;
+                    }
+                }
+            }
+            for (int i = 0; i < smallFiles.size(); ++i) {
+                if (copied.at(i)) {
+                    done[smallIndexes.at(i)] = true;
+                    reportCopied(smallFiles.at(i).size);
+                    reportFinished(smallFiles.at(i).destinationPath);
+                    if (journal) {
+                        journal->recordCompleted(smallFiles.at(i).relativePath);
+                    }
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < items.size(); ++i) {
+        const CopyPlan::Item& item = items.at(i);
+        if (done.at(i) || linkedTo.at(i) >= 0) {
+            continue;
+        }
+        const bool copied = item.symLink ? copySymLink(item.sourcePath, item.destinationPath, journal, item.relativePath)
+                                         : copyFile(item.sourcePath, item.destinationPath, journal, item.relativePath);
+        if (!copied) {
+            return false;
+        }
+    }
+
+    // Further names of a file already copied become links to that copy,
+    // once all data is in place.
+    int linked = 0;
+    for (int i = 0; i < items.size(); ++i) {
+        const CopyPlan::Item& item = items.at(i);
+        if (linkedTo.at(i) < 0 || (journal && journal->isCompleted(item.relativePath))) {
+            continue;
+        }
+        if (linkFile(items.at(linkedTo.at(i)).destinationPath, item.destinationPath)) {
+            ++linked;
+            reportFinished(item.destinationPath);
+            if (journal) {
+                if (!syncDirectory(QFileInfo(item.destinationPath).absolutePath())) {
+                    qWarning() << "Failed to sync the directory of:" << item.destinationPath;
+                    return false;
+                }
+                journal->recordCompleted(item.relativePath);
+            }
+        } else if (!copyFile(item.sourcePath, item.destinationPath, journal, item.relativePath)) {
+            return false;
+        }
+    }
+
+    qInfo() << "Copied" << items.size() << "files from" << sourcePath << "in" << timer.elapsed()
+            << "ms, of which planning took" << planningTime << "ms," << linked << "as hard links";
+    return true;
+}
+
+bool FileOperations::copyDirectory(const QString& sourcePath, const QString& destinationPath) {
+    QDir sourceDir(sourcePath);
+    if (!sourceDir.exists()) {
+        qWarning() << "Source directory does not exist:" << sourcePath;
+        return false;
+    }
+
+    QString newFolderName = sourceDir.dirName();
+    QString newFolderPath = QDir(destinationPath).absoluteFilePath(newFolderName);
+    int copyNumber = 1;
+    while (QDir(newFolderPath).exists()) {
+        newFolderName = sourceDir.dirName() + "(" + QString::number(copyNumber++) + ")";
+        newFolderPath = QDir(destinationPath).absoluteFilePath(newFolderName);
+    }
+
+    // The journal records the resolved folder name so that a resumed job
+    // continues in the same place instead of creating another "(n)" copy.
+    CopyJournal journal;
+    if (!journal.create(CopyJournal::Copy, sourceDir.absolutePath(), newFolderPath)) {
+        // A copy leaves its source alone, so it can go ahead without one;
+        // it just cannot be resumed.
+        qWarning() << "Could not create a journal, copying without one:" << sourcePath;
+        return copyTree(sourceDir.absolutePath(), newFolderPath);
+    }
+    return runJournaled(journal);
+}
+
+bool FileOperations::moveFile(const QString& sourcePath, const QString& destinationPath) {
+    if (isSameDevice(QFileInfo(sourcePath).absolutePath(), QFileInfo(destinationPath).absolutePath())
+        && QFile::rename(sourcePath, destinationPath)) {
+        return true;
+    }
+
+    // Without a journal nothing would record that the copy is complete
+    // before the source goes.
+    CopyJournal journal;
+    if (!journal.create(CopyJournal::Move, QFileInfo(sourcePath).absoluteFilePath(), destinationPath)) {
+        qWarning() << "Could not create a journal, not moving:" << sourcePath;
+        return false;
+    }
+    return runJournaled(journal);
+}
+
+bool FileOperations::moveDirectory(const QString& sourcePath, const QString& destinationPath) {
+    if (isSameDevice(sourcePath, QFileInfo(destinationPath).absolutePath())
+        && QDir().rename(sourcePath, destinationPath)) {
+        return true;
+    }
+
+    CopyJournal journal;
+    if (!journal.create(CopyJournal::Move, QDir(sourcePath).absolutePath(), destinationPath)) {
+        qWarning() << "Could not create a journal, not moving:" << sourcePath;
+        return false;
+    }
+    return runJournaled(journal);
+}
+
+bool FileOperations::resume(CopyJournal& journal) {
+    return runJournaled(journal);
+}
+
+bool FileOperations::removeTree(const QString& path) {
+    if (UringBackend::removeTree(path)) {
+        return true;
+    }
+
+    // Whatever io_uring could not remove is retried one call at a time.
+    QFileInfo info(path);
+    if (info.isDir() && !info.isSymLink()) {
+        return QDir(path).removeRecursively();
+    }
+    if (!info.exists() && !info.isSymLink()) {
+        return true;
+    }
+    return QFile::remove(path);
+}
+
+QStringList FileOperations::filesRecursively(const QString& directoryPath) {
+    QStringList files;
+    QDirIterator it(directoryPath, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        files << it.next();
+    }
+    return files;
+}
+
+void FileOperations::setVerifyCopies(bool verify) {
+    verifyCopies = verify;
+}
+
+bool FileOperations::verifiesCopies() {
+    return verifyCopies;
+}
+
+void FileOperations::setProgress(TransferProgress* progress) {
+    transferProgress = progress;
+}
+
+void FileOperations::setThrottle(Throttle* throttle) {
+    jobThrottle = throttle;
+    if (!throttle) {
+        Throttle::applyIdlePriority(false);
+    }
+}
+
+void FileOperations::reportProgress(qint64 bytes) {
+    reportCopied(bytes);
+}
+
+void FileOperations::reportFileDone(const QString& path) {
+    reportFinished(path);
+}
+
+void FileOperations::throttleChunk(IoScheduler::Slot& slot, qint64 bytes, int operations) {
+    // The slot is only given up while a limit actually holds the transfer
+    // back, not for every chunk that fits within it.
+    throttle(bytes, operations, [&slot](const std::function<void()>& wait) { slot.yield(wait); });
+}
+
+bool FileOperations::isSameDevice(const QString& firstPath, const QString& secondPath) {
+    QStorageInfo first(firstPath);
+    QStorageInfo second(secondPath);
+    return first.isValid() && second.isValid() && first.rootPath() == second.rootPath();
+}
+
+bool FileOperations::copyJournaled(CopyJournal& journal, int item) {
+    if (journal.isCopyConfirmed(item) || journal.isRemoved(item)) {
+        return true;
+    }
+
+    const QString sourcePath = journal.sourcePath(item);
+    const QString destinationPath = journal.destinationPath(item);
+    const QString key = journal.itemKey(item);
+    const QFileInfo sourceInfo(sourcePath);
+
+    bool copied;
+    // A moved link stays a link; a copied one is copied through, like
+    // copyDirectory() does without a journal.
+    if (journal.operation() == CopyJournal::Move && sourceInfo.isSymLink()) {
+        copied = copySymLink(sourcePath, destinationPath, &journal, key);
+    } else if (sourceInfo.isDir()) {
+        copied = copyTree(sourcePath, destinationPath, &journal, key);
+    } else {
+        copied = copyFile(sourcePath, destinationPath, &journal, key);
+    }
+    if (!copied) {
+        return false;
+    }
+
+    // Subdirectories made along the way must be on disk too, so the whole
+    // copy survives a power loss once the source is gone.
+    if (journal.operation() == CopyJournal::Move && !syncTree(destinationPath)) {
+        qWarning() << "Could not sync the copy, keeping source:" << sourcePath;
+        return false;
+    }
+    return true;
+}
+
+QList<int> FileOperations::removeMoved(CopyJournal& journal, const QList<int>& items) {
+    QList<int> removed;
+
+    // Without a confirmed journal entry the sources must stay untouched,
+    // otherwise a crash during removal could lose data.
+    if (!journal.confirmCopy(items)) {
+        qWarning() << "Could not confirm copy, keeping sources:" << journal.journalPath();
+        return removed;
+    }
+
+    for (int item: items) {
+        if (journal.isRemoved(item)) {
+            removed.append(item);
+        } else if (removeTree(journal.sourcePath(item))) {
+            journal.recordRemoved(item);
+            removed.append(item);
+        } else {
+            qWarning() << "Failed to remove source after move:" << journal.sourcePath(item);
+        }
+    }
+
+    for (int i = 0; i < journal.itemCount(); ++i) {
+        if (!journal.isRemoved(i)) {
+            return removed;
+        }
+    }
+    journal.finish();
+    return removed;
+}
+
+bool FileOperations::runJournaled(CopyJournal& journal) {
+    bool succeeded = true;
+    QList<int> copied;
+    for (int i = 0; i < journal.itemCount(); ++i) {
+        if (copyJournaled(journal, i)) {
+            copied.append(i);
+        } else {
+            succeeded = false;
+        }
+    }
+
+    if (journal.operation() == CopyJournal::Copy) {
+        if (succeeded) {
+            journal.finish();
+        }
+        return succeeded;
+    }
+    return removeMoved(journal, copied).size() == copied.size() && succeeded;
+}
@@ -0,0 +1,71 @@
+#ifndef FILEOPERATIONS_H
+#define FILEOPERATIONS_H
+
+#include <QString>
+#include <QStringList>
+
+#include "copyjournal.h"
+#include "ioscheduler.h"
+
+class Throttle;
+class TransferProgress;
+
+// Low-level copy and move primitives shared by the GUI actions.
+//
+// Files are copied in chunks so that a journal can checkpoint how far a large
+// file got; an interrupted job picks up from the last checkpoint instead of
+// copying the file again.
+//
+// With verification on, the data is hashed while it passes through the copy
+// buffers, and the destination is read back from disk afterwards and must
+// hash the same. A file that fails is reported and counts as not copied, so
+// a move keeps its source.
+class FileOperations {
+public:
+    static constexpr qint64 chunkSize = 1 << 20;
+    static constexpr qint64 checkpointInterval = 64 << 20;
+
+    static bool copyFile(const QString& sourcePath, const QString& destinationPath,
+                         CopyJournal* journal = nullptr, const QString& relativePath = QString());
+    static bool copyTree(const QString& sourcePath, const QString& destinationPath,
+                         CopyJournal* journal = nullptr, const QString& relativePath = QString());
+
+    static bool copyDirectory(const QString& sourcePath, const QString& destinationPath);
+    static bool moveFile(const QString& sourcePath, const QString& destinationPath);
+    static bool moveDirectory(const QString& sourcePath, const QString& destinationPath);
+
+    static bool removeTree(const QString& path);
+    static QStringList filesRecursively(const QString& directoryPath);
+
+    static void setVerifyCopies(bool verify);
+    static bool verifiesCopies();
+
+    // Copies made by the calling thread count their bytes into progress,
+    // until it is set back to null.
+    static void setProgress(TransferProgress* progress);
+    // Copies made by the calling thread are paced by throttle as well as by
+    // Throttle::global(), until it is set back to null.
+    static void setThrottle(Throttle* throttle);
+
+    // For transfers that do their own reads and writes: counts bytes and
+    // finished files toward the calling thread's progress, and waits for its
+    // limits to allow the next chunk, leaving the disks to others meanwhile.
+    static void reportProgress(qint64 bytes);
+    static void reportFileDone(const QString& path);
+    static void throttleChunk(IoScheduler::Slot& slot, qint64 bytes, int operations);
+
+    // A journaled move of several items in two steps: each item is copied,
+    // from any thread, then the copies are confirmed with one journal sync
+    // and their sources removed. The journal is finished once every source
+    // is gone; removeMoved() returns the items it removed.
+    static bool copyJournaled(CopyJournal& journal, int item);
+    static QList<int> removeMoved(CopyJournal& journal, const QList<int>& items);
+
+    static bool resume(CopyJournal& journal);
+    static bool isSameDevice(const QString& firstPath, const QString& secondPath);
+
+private:
+    static bool runJournaled(CopyJournal& journal);
+};
+
+#endif // FILEOPERATIONS_H
@@ -0,0 +1,463 @@
+#include <QCheckBox>
+#include <QFile>
+#include <QFileInfo>
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPainter>
+#include <QRegularExpression>
+#include <QScrollBar>
+#include <QShortcut>
+#include <QStackedWidget>
+#include <QVBoxLayout>
+
+#include <cstring>
+#include <limits>
+
+#include "fileviewer.h"
+#include "lineindex.h"
+#include "hexview.h"
+#include "bytesearch.h"
+
+
+// Longer lines are cut off on screen; they are still counted correctly.
+static const qint64 maxLineBytes = 16 * 1024;
+static const int gutterPadding = 8;
+
+
+TextView::TextView(LineIndex* index, QWidget *parent)
+        : QAbstractScrollArea(parent),
+          index(index),
+          firstLine(0),
+          firstOffset(0),
+          scrollScale(1),
+          widestLine(0),
+          updatingScrollBars(false) {
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setFocusPolicy(Qt::StrongFocus);
+    connect(index, &LineIndex::progress, this, [this]() { updateScrollBars(); });
+}
+
+bool TextView::open(const QString& path) {
+    if (!file.open(path)) {
+        return false;
+    }
+    firstLine = 0;
+    firstOffset = 0;
+    widestLine = 0;
+    updateScrollBars();
+    viewport()->update();
+    return true;
+}
+
+qint64 TextView::fileSize() const {
+    return file.size();
+}
+
+qint64 TextView::topLine() const {
+    return firstLine;
+}
+
+qint64 TextView::topOffset() const {
+    return firstOffset;
+}
+
+int TextView::visibleLines() const {
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
+
+void TextView::goToLine(qint64 line) {
+    line = qBound<qint64>(0, line, qMax<qint64>(0, index->lineCount() - 1));
+    firstOffset = index->lineOffset(line, file);
+    firstLine = line;
+    updateScrollBars();
+    viewport()->update();
+}
+
+void TextView::goToOffset(qint64 offset) {
+    offset = qBound<qint64>(0, offset, qMax<qint64>(0, file.size() - 1));
+    firstOffset = LineIndex::lineStartBefore(file, offset);
+    firstLine = index->lineAt(firstOffset, file);
+    updateScrollBars();
+    viewport()->update();
+}
+
+void TextView::scrollToEnd() {
+    firstOffset = file.size();
+    for (int row = 0; row < visibleLines() && firstOffset > 0; ++row) {
+        firstOffset = LineIndex::lineStartBefore(file, firstOffset - 1);
+    }
+    firstLine = index->lineAt(firstOffset, file);
+    updateScrollBars();
+    viewport()->update();
+}
+
+void TextView::refresh() {
+    file.refreshSize();
+    updateScrollBars();
+    viewport()->update();
+}
+
+void TextView::scrollLines(qint64 delta) {
+    // Long jumps are cheaper through the index than line by line.
+    const qint64 target = firstLine + delta;
+    if (qAbs(delta) > 4 * LineIndex::checkpointSpacing && target >= 0 && target < index->lineCount()) {
+        goToLine(target);
+        return;
+    }
+
+    for (; delta > 0; --delta) {
+        const qint64 next = LineIndex::nextLineStart(file, firstOffset);
+        if (next >= file.size()) {
+            break;
+        }
+        firstOffset = next;
+        ++firstLine;
+    }
+    for (; delta < 0 && firstOffset > 0; ++delta) {
+        firstOffset = LineIndex::lineStartBefore(file, firstOffset - 1);
+        firstLine = qMax<qint64>(0, firstLine - 1);
+    }
+    updateScrollBars();
+    viewport()->update();
+}
+
+void TextView::updateScrollBars() {
+    updatingScrollBars = true;
+
+    // QScrollBar works in ints, so files with more lines than that scroll
+    // in steps of scrollScale lines.
+    const qint64 lines = qMax(index->lineCount(), firstLine + 1);
+    const qint64 maximum = qMax<qint64>(0, lines - visibleLines());
+    scrollScale = maximum / std::numeric_limits<int>::max() + 1;
+
+    verticalScrollBar()->setRange(0, int(maximum / scrollScale));
+    verticalScrollBar()->setPageStep(visibleLines());
+    verticalScrollBar()->setSingleStep(1);
+    verticalScrollBar()->setValue(int(firstLine / scrollScale));
+
+    horizontalScrollBar()->setRange(0, qMax(0, widestLine - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+
+    updatingScrollBars = false;
+}
+
+void TextView::scrollContentsBy(int dx, int dy) {
+    Q_UNUSED(dx);
+    if (updatingScrollBars) {
+        return;
+    }
+    if (dy != 0) {
+        const qint64 target = qint64(verticalScrollBar()->value()) * scrollScale;
+        scrollLines(target - firstLine);
+    }
+    viewport()->update();
+}
+
+void TextView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void TextView::keyPressEvent(QKeyEvent *event) {
+    switch (event->key()) {
+    case Qt::Key_Up:
+        scrollLines(-1);
+        break;
+    case Qt::Key_Down:
+        scrollLines(1);
+        break;
+    case Qt::Key_PageUp:
+        scrollLines(-visibleLines());
+        break;
+    case Qt::Key_PageDown:
+        scrollLines(visibleLines());
+        break;
+    case Qt::Key_Home:
+        goToOffset(0);
+        break;
+    case Qt::Key_End:
+        scrollToEnd();
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void TextView::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(viewport());
+    const QFontMetrics metrics = fontMetrics();
+    const int lineHeight = metrics.height();
+    const int rows = visibleLines() + 1;
+    const int gutterWidth = metrics.horizontalAdvance(QString::number(firstLine + rows)) + 2 * gutterPadding;
+    const QRect textArea(gutterWidth, 0, viewport()->width() - gutterWidth, viewport()->height());
+
+    painter.fillRect(QRect(0, 0, gutterWidth, viewport()->height()), palette().alternateBase());
+
+    const int previousWidest = widestLine;
+    qint64 offset = firstOffset;
+    for (int row = 0; row < rows && offset < file.size(); ++row) {
+        const qint64 available = qMin(maxLineBytes, file.size() - offset);
+        const uchar* data = file.map(offset, available);
+        if (!data) {
+            break;
+        }
+
+        // Decode before looking for the next line: that may move the window.
+        const void* hit = std::memchr(data, '\n', available);
+        const qint64 length = hit ? static_cast<const uchar*>(hit) - data : available;
+        QString text = QString::fromUtf8(reinterpret_cast<const char*>(data), length);
+        if (text.endsWith('\r')) {
+            text.chop(1);
+        }
+        text.replace('\t', "    ");
+        const qint64 next = hit ? offset + length + 1 : LineIndex::nextLineStart(file, offset + length);
+
+        const int y = row * lineHeight + metrics.ascent();
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(gutterPadding, y, QString::number(firstLine + row + 1));
+
+        painter.setPen(palette().color(QPalette::Text));
+        painter.setClipRect(textArea);
+        painter.drawText(gutterWidth + gutterPadding - horizontalScrollBar()->value(), y, text);
+        painter.setClipping(false);
+
+        widestLine = qMax(widestLine, gutterWidth + 2 * gutterPadding + metrics.horizontalAdvance(text));
+        offset = next;
+    }
+
+    if (widestLine != previousWidest) {
+        horizontalScrollBar()->setRange(0, qMax(0, widestLine - viewport()->width()));
+    }
+}
+
+
+FileViewer::FileViewer(const QString& path, QWidget *parent)
+        : QWidget(parent, Qt::Window),
+          filePath(path),
+          lineIndex(new LineIndex(this)),
+          search(new ByteSearch(this)),
+          lastMatch(-1) {
+    setAttribute(Qt::WA_DeleteOnClose);
+    setWindowTitle(QFileInfo(path).fileName());
+    resize(900, 700);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    QHBoxLayout* toolbar = new QHBoxLayout;
+
+    goToEdit = new QLineEdit(this);
+    toolbar->addWidget(goToEdit);
+
+    findEdit = new QLineEdit(this);
+    toolbar->addWidget(findEdit);
+
+    hexBox = new QCheckBox(tr("Hex"), this);
+    toolbar->addWidget(hexBox);
+
+    followBox = new QCheckBox(tr("Follow"), this);
+    toolbar->addWidget(followBox);
+    toolbar->addStretch();
+
+    searchLabel = new QLabel(this);
+    toolbar->addWidget(searchLabel);
+
+    statusLabel = new QLabel(this);
+    toolbar->addWidget(statusLabel);
+
+    layout->addLayout(toolbar);
+
+    textView = new TextView(lineIndex, this);
+    hexView = new HexView(this);
+    views = new QStackedWidget(this);
+    views->addWidget(textView);
+    views->addWidget(hexView);
+    layout->addWidget(views);
+
+    connect(goToEdit, &QLineEdit::returnPressed, this, &FileViewer::goTo);
+    connect(findEdit, &QLineEdit::returnPressed, this, &FileViewer::find);
+    connect(hexBox, &QCheckBox::toggled, this, &FileViewer::setHexMode);
+    connect(followBox, &QCheckBox::toggled, this, &FileViewer::setFollow);
+    connect(lineIndex, &LineIndex::progress, this, &FileViewer::updateStatus);
+    connect(lineIndex, &LineIndex::finished, this, &FileViewer::updateStatus);
+    connect(search, &ByteSearch::progress, this, [this](qint64 scanned, qint64 total) {
+        searchLabel->setText(tr("Searching: %1%").arg(total > 0 ? scanned * 100 / total : 100));
+    });
+    connect(search, &ByteSearch::found, this, &FileViewer::showMatch);
+    connect(search, &ByteSearch::notFound, this, [this]() {
+        searchLabel->setText(tr("Not found"));
+    });
+
+    followTimer.setInterval(1000);
+    connect(&followTimer, &QTimer::timeout, this, &FileViewer::checkForGrowth);
+
+    auto closeShortcut = new QShortcut(QKeySequence(Qt::Key_Escape), this);
+    connect(closeShortcut, &QShortcut::activated, this, &QWidget::close);
+
+    if (textView->open(path) && hexView->open(path)) {
+        lineIndex->start(path);
+    }
+    setHexMode(false);
+    hexBox->setChecked(looksBinary(path));
+    updateStatus();
+}
+
+bool FileViewer::prefersBuiltInViewer(const QString& path) {
+    // External editors load files whole; past this size that is painful.
+    return QFileInfo(path).size() >= largeFileThreshold;
+}
+
+bool FileViewer::looksBinary(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    return file.read(4096).contains('\0');
+}
+
+void FileViewer::setHexMode(bool hex) {
+    // Carry the current position over to the other view.
+    if (hex && views->currentWidget() != hexView) {
+        hexView->goToOffset(textView->topOffset());
+    } else if (!hex && views->currentWidget() != textView) {
+        textView->goToOffset(hexView->cursorOffset());
+    }
+
+    views->setCurrentWidget(hex ? static_cast<QWidget*>(hexView) : textView);
+    goToEdit->setPlaceholderText(hex ? tr("Go to offset or percentage (e.g. 0x1f00 or 50%)")
+                                     : tr("Go to line or percentage (e.g. 120000 or 50%)"));
+    findEdit->setPlaceholderText(hex ? tr("Find bytes (e.g. 7f 45 4c 46)") : tr("Find text"));
+    lastMatch = -1;
+    views->currentWidget()->setFocus();
+}
+
+void FileViewer::goTo() {
+    const QString text = goToEdit->text().trimmed();
+    const bool hex = hexBox->isChecked();
+    bool ok = false;
+
+    if (text.endsWith('%')) {
+        double percent = text.chopped(1).toDouble(&ok);
+        if (ok) {
+            const qint64 offset = qint64(textView->fileSize() * qBound(0.0, percent, 100.0) / 100.0);
+            if (hex) {
+                hexView->goToOffset(offset);
+            } else {
+                textView->goToOffset(offset);
+            }
+        }
+    } else if (hex) {
+        // Base 0 accepts both 0x-prefixed hex and plain decimal offsets.
+        qint64 offset = text.toLongLong(&ok, 0);
+        if (ok) {
+            hexView->goToOffset(offset);
+        }
+    } else {
+        qint64 line = text.toLongLong(&ok);
+        if (ok) {
+            textView->goToLine(line - 1);
+        }
+    }
+
+    if (ok) {
+        views->currentWidget()->setFocus();
+    }
+}
+
+QByteArray FileViewer::searchPattern(bool* ok) const {
+    const QString text = findEdit->text();
+    *ok = true;
+    if (!hexBox->isChecked()) {
+        return text.toUtf8();
+    }
+
+    QString digits = text;
+    digits.remove(' ');
+    static const QRegularExpression hexDigits("^([0-9a-fA-F]{2})+$");
+    if (!hexDigits.match(digits).hasMatch()) {
+        *ok = false;
+        return QByteArray();
+    }
+    return QByteArray::fromHex(digits.toLatin1());
+}
+
+void FileViewer::find() {
+    bool ok = false;
+    const QByteArray pattern = searchPattern(&ok);
+    if (!ok || pattern.isEmpty() || pattern.size() > ByteSearch::maxPatternSize) {
+        searchLabel->setText(tr("Invalid pattern"));
+        return;
+    }
+
+    // Pressing Enter again continues after the previous match.
+    qint64 from;
+    if (pattern == lastPattern && lastMatch >= 0) {
+        from = lastMatch + 1;
+    } else {
+        from = hexBox->isChecked() ? hexView->cursorOffset() : textView->topOffset();
+    }
+
+    lastPattern = pattern;
+    searchLabel->setText(tr("Searching..."));
+    search->start(filePath, pattern, from);
+}
+
+void FileViewer::showMatch(qint64 offset) {
+    lastMatch = offset;
+    hexView->setHighlight(offset, lastPattern.size());
+    if (hexBox->isChecked()) {
+        hexView->goToOffset(offset);
+    } else {
+        textView->goToOffset(offset);
+    }
+    searchLabel->setText(tr("Found at 0x%1").arg(offset, 0, 16));
+}
+
+void FileViewer::updateStatus() {
+    const qint64 size = textView->fileSize();
+    const qint64 indexed = lineIndex->indexedBytes();
+
+    if (indexed < size) {
+        statusLabel->setText(tr("Indexing: %1 lines, %2%").arg(lineIndex->lineCount()).arg(indexed * 100 / size));
+    } else {
+        statusLabel->setText(tr("%1 lines").arg(lineIndex->lineCount()));
+    }
+
+    if (followBox->isChecked() && !hexBox->isChecked()) {
+        textView->scrollToEnd();
+    }
+}
+
+void FileViewer::checkForGrowth() {
+    const qint64 before = textView->fileSize();
+    textView->refresh();
+    hexView->refresh();
+    const qint64 after = textView->fileSize();
+
+    if (after < before) {
+        // Truncated or rotated in place: the old index no longer applies.
+        lineIndex->start(filePath);
+        textView->goToOffset(0);
+    } else if (after > before) {
+        lineIndex->extend();
+    }
+
+    if (hexBox->isChecked()) {
+        hexView->goToOffset(after - 1);
+    }
+}
+
+void FileViewer::setFollow(bool follow) {
+    if (follow) {
+        followTimer.start();
+        if (hexBox->isChecked()) {
+            hexView->goToOffset(hexView->fileSize() - 1);
+        } else {
+            textView->scrollToEnd();
+        }
+    } else {
+        followTimer.stop();
+    }
+}
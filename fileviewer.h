@@ -0,0 +1,100 @@
+#ifndef FILEVIEWER_H
+#define FILEVIEWER_H
+
+#include <QAbstractScrollArea>
+#include <QTimer>
+#include <QWidget>
+
+#include "mappedfile.h"
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QStackedWidget;
+class LineIndex;
+class HexView;
+class ByteSearch;
+
+// Text view over a memory-mapped file that only decodes the lines on screen.
+//
+// Scrolling works from the first byte even before the line index exists;
+// jumps to a line number use the index once the background scan got there.
+class TextView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    explicit TextView(LineIndex* index, QWidget *parent = nullptr);
+
+    bool open(const QString& path);
+    void goToLine(qint64 line);
+    void goToOffset(qint64 offset);
+    void scrollToEnd();
+    void refresh();
+
+    qint64 fileSize() const;
+    qint64 topLine() const;
+    qint64 topOffset() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    void scrollLines(qint64 delta);
+    void updateScrollBars();
+    int visibleLines() const;
+
+    MappedFile file;
+    LineIndex* index;
+    qint64 firstLine;
+    qint64 firstOffset;
+    qint64 scrollScale;
+    int widestLine;
+    bool updatingScrollBars;
+};
+
+// Built-in viewer window for files too large for an external editor, with a
+// hex mode for binary files.
+class FileViewer : public QWidget {
+    Q_OBJECT
+
+public:
+    static constexpr qint64 largeFileThreshold = 64 << 20;
+
+    explicit FileViewer(const QString& path, QWidget *parent = nullptr);
+
+    static bool prefersBuiltInViewer(const QString& path);
+
+private slots:
+    void goTo();
+    void find();
+    void showMatch(qint64 offset);
+    void updateStatus();
+    void checkForGrowth();
+    void setFollow(bool follow);
+    void setHexMode(bool hex);
+
+private:
+    static bool looksBinary(const QString& path);
+    QByteArray searchPattern(bool* ok) const;
+
+    QString filePath;
+    LineIndex* lineIndex;
+    ByteSearch* search;
+    QByteArray lastPattern;
+    qint64 lastMatch;
+    QStackedWidget* views;
+    TextView* textView;
+    HexView* hexView;
+    QLineEdit* goToEdit;
+    QLineEdit* findEdit;
+    QCheckBox* hexBox;
+    QCheckBox* followBox;
+    QLabel* statusLabel;
+    QLabel* searchLabel;
+    QTimer followTimer;
+};
+
+#endif // FILEVIEWER_H
@@ -0,0 +1,286 @@
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFileSystemModel>
+#include <QLocale>
+#include <QMimeData>
+#include <QThread>
+#include <QUrl>
+
+#include <algorithm>
+#include <numeric>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+#include "flatlist.h"
+#include "pathindex.h"
+
+
+FlatListModel::FlatListModel(QObject *parent)
+        : QAbstractListModel(parent),
+          index(new PathIndex(this)),
+          nextEntry(0),
+          key(DiscoveryOrder),
+          sorter(nullptr),
+          sortCancelled(false),
+          sortGeneration(0) {
+    connect(index, &PathIndex::progress, this, &FlatListModel::fetchNewFiles);
+    connect(index, &PathIndex::finished, this, [this]() {
+        fetchNewFiles();
+        // A sort started during the walk only covered the files found so
+        // far; the rest are sorted in now.
+        if (key != DiscoveryOrder) {
+            startSort();
+        }
+    });
+}
+
+FlatListModel::~FlatListModel() {
+    stopSort();
+}
+
+void FlatListModel::setRootPath(const QString& path) {
+    stopSort();
+    ++sortGeneration;
+    beginResetModel();
+    index->clear();
+    items.clear();
+    items.squeeze();
+    stats.clear();
+    stats.squeeze();
+    order.clear();
+    order.squeeze();
+    nextEntry = 0;
+    root = path;
+    if (!root.isEmpty()) {
+        index->start(root);
+    }
+    endResetModel();
+}
+
+QString FlatListModel::rootPath() const {
+    return root;
+}
+
+void FlatListModel::sortBy(SortKey sortKey) {
+    key = sortKey;
+    if (key != DiscoveryOrder) {
+        if (!root.isEmpty()) {
+            startSort();
+        }
+        return;
+    }
+
+    stopSort();
+    ++sortGeneration;
+    beginResetModel();
+    order.clear();
+    endResetModel();
+}
+
+FlatListModel::SortKey FlatListModel::sortKey() const {
+    return key;
+}
+
+int FlatListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : int(items.size());
+}
+
+QVariant FlatListModel::data(const QModelIndex& modelIndex, int role) const {
+    if (!modelIndex.isValid() || modelIndex.row() >= items.size()) {
+        return QVariant();
+    }
+    const int item = itemAt(modelIndex.row());
+
+    switch (role) {
+    case Qt::DisplayRole: {
+        // Only the sort key is worth a second look in a flat list; it is
+        // shown next to the path so the order makes sense at a glance.
+        const QString path = index->relativePath(items.at(item));
+        if (key == BySize) {
+            return QString("%1    %2").arg(path, QLocale().formattedDataSize(statOf(item).size));
+        }
+        if (key == ByModified) {
+            const QDateTime modified = QDateTime::fromSecsSinceEpoch(statOf(item).modified);
+            return QString("%1    %2").arg(path, QLocale().toString(modified, QLocale::ShortFormat));
+        }
+        return path;
+    }
+    case Qt::ToolTipRole: {
+        const FileStat& stat = statOf(item);
+        return QString("%1\n%2, %3").arg(index->path(items.at(item)),
+                                          QLocale().formattedDataSize(stat.size),
+                                          QLocale().toString(QDateTime::fromSecsSinceEpoch(stat.modified),
+                                                             QLocale::ShortFormat));
+    }
+    case Qt::DecorationRole:
+        return iconProvider.icon(QFileIconProvider::File);
+    case QFileSystemModel::FilePathRole:
+        return index->path(items.at(item));
+    case QFileSystemModel::FileNameRole:
+        return QFileInfo(index->relativePath(items.at(item))).fileName();
+    default:
+        return QVariant();
+    }
+}
+
+Qt::ItemFlags FlatListModel::flags(const QModelIndex& modelIndex) const {
+    if (!modelIndex.isValid()) {
+        return Qt::NoItemFlags;
+    }
+    return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemIsDragEnabled;
+}
+
+QStringList FlatListModel::mimeTypes() const {
+    return {"text/uri-list"};
+}
+
+QMimeData* FlatListModel::mimeData(const QModelIndexList& indexes) const {
+    QList<QUrl> urls;
+    for (const QModelIndex& modelIndex: indexes) {
+        urls.append(QUrl::fromLocalFile(filePath(modelIndex)));
+    }
+    auto mimeData = new QMimeData;
+    mimeData->setUrls(urls);
+    return mimeData;
+}
+
+Qt::DropActions FlatListModel::supportedDragActions() const {
+    return Qt::CopyAction | Qt::MoveAction;
+}
+
+QString FlatListModel::filePath(const QModelIndex& modelIndex) const {
+    if (!modelIndex.isValid() || modelIndex.row() >= items.size()) {
+        return QString();
+    }
+    return index->path(items.at(itemAt(modelIndex.row())));
+}
+
+FlatListModel::FileStat FlatListModel::statFile(const QString& path) {
+    FileStat stat;
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::lstat(QFile::encodeName(path).constData(), &info) == 0) {
+        stat.size = info.st_size;
+        stat.modified = info.st_mtime;
+    }
+#else
+    const QFileInfo info(path);
+    stat.size = info.size();
+    stat.modified = info.lastModified().toSecsSinceEpoch();
+#endif
+    // A file that vanished since the walk counts as empty and old rather
+    // than being asked about again.
+    stat.known = true;
+    return stat;
+}
+
+int FlatListModel::itemAt(int row) const {
+    return row < order.size() ? order.at(row) : row;
+}
+
+const FlatListModel::FileStat& FlatListModel::statOf(int item) const {
+    FileStat& stat = stats[item];
+    if (!stat.known) {
+        stat = statFile(index->path(items.at(item)));
+    }
+    return stat;
+}
+
+void FlatListModel::fetchNewFiles() {
+    const QVector<int> files = index->filesSince(nextEntry);
+    if (files.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), int(items.size()), int(items.size() + files.size()) - 1);
+    items += files;
+    stats.resize(items.size());
+    endInsertRows();
+}
+
+void FlatListModel::startSort() {
+    stopSort();
+
+    const int generation = ++sortGeneration;
+    const SortKey sortKey = key;
+    const QVector<int> snapshotItems = items;
+    QVector<FileStat> snapshotStats = stats;
+
+    sorter = QThread::create([this, generation, sortKey, snapshotItems, snapshotStats]() mutable {
+        const int count = int(snapshotItems.size());
+        for (int i = 0; i < count; ++i) {
+            if ((i & 4095) == 0 && sortCancelled) {
+                return;
+            }
+            if (!snapshotStats.at(i).known) {
+                snapshotStats[i] = statFile(index->path(snapshotItems.at(i)));
+            }
+        }
+
+        // Biggest and newest first: that is what a flat list is opened for.
+        QVector<int> newOrder(count);
+        std::iota(newOrder.begin(), newOrder.end(), 0);
+        const FileStat* stat = snapshotStats.constData();
+        if (sortKey == BySize) {
+            std::stable_sort(newOrder.begin(), newOrder.end(),
+                             [stat](int first, int second) { return stat[first].size > stat[second].size; });
+        } else {
+            std::stable_sort(newOrder.begin(), newOrder.end(),
+                             [stat](int first, int second) { return stat[first].modified > stat[second].modified; });
+        }
+        if (sortCancelled) {
+            return;
+        }
+
+        QMetaObject::invokeMethod(this, [this, generation, newOrder, snapshotStats]() {
+            applySort(generation, newOrder, snapshotStats);
+        }, Qt::QueuedConnection);
+    });
+    sorter->start(QThread::LowPriority);
+}
+
+void FlatListModel::stopSort() {
+    if (!sorter) {
+        return;
+    }
+    sortCancelled = true;
+    sorter->wait();
+    delete sorter;
+    sorter = nullptr;
+    sortCancelled = false;
+}
+
+void FlatListModel::applySort(int generation, const QVector<int>& newOrder, const QVector<FileStat>& newStats) {
+    // A newer sort, another key or another root has superseded this one.
+    if (generation != sortGeneration) {
+        return;
+    }
+    std::copy(newStats.begin(), newStats.end(), stats.begin());
+
+    emit layoutAboutToBeChanged();
+    const QModelIndexList persistent = persistentIndexList();
+    QVector<int> persistentItems;
+    persistentItems.reserve(persistent.size());
+    for (const QModelIndex& modelIndex: persistent) {
+        persistentItems.append(itemAt(modelIndex.row()));
+    }
+
+    order = newOrder;
+
+    // The current and selected rows follow their files to the new rows.
+    if (!persistent.isEmpty()) {
+        QVector<int> rowOf(items.size());
+        std::iota(rowOf.begin(), rowOf.end(), 0);
+        for (int row = 0; row < order.size(); ++row) {
+            rowOf[order.at(row)] = row;
+        }
+        QModelIndexList moved;
+        moved.reserve(persistent.size());
+        for (int item: persistentItems) {
+            moved.append(createIndex(rowOf.at(item), 0));
+        }
+        changePersistentIndexList(persistent, moved);
+    }
+    emit layoutChanged();
+}
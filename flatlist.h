@@ -0,0 +1,86 @@
+#ifndef FLATLIST_H
+#define FLATLIST_H
+
+#include <QAbstractListModel>
+#include <QFileIconProvider>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+class PathIndex;
+
+// Every file below a directory as one list, for finding the biggest or
+// newest files anywhere in a tree.
+//
+// The walk runs on a background thread and rows are appended while it goes,
+// so the first files show up at once. A row is only a number into the walk's
+// PathIndex; its path is put together, and the file stat'ed, when a view
+// actually asks for it, so a million rows cost a few bytes each until they
+// are scrolled into sight. Sorting by size or date has to stat everything,
+// which happens on another background thread, and the new order replaces
+// the old one in a single layout change when it is done.
+class FlatListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    enum SortKey {
+        DiscoveryOrder,
+        BySize,
+        ByModified
+    };
+
+    explicit FlatListModel(QObject *parent = nullptr);
+    ~FlatListModel();
+
+    void setRootPath(const QString& path);
+    QString rootPath() const;
+
+    void sortBy(SortKey key);
+    SortKey sortKey() const;
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    Qt::ItemFlags flags(const QModelIndex& index) const override;
+    QStringList mimeTypes() const override;
+    QMimeData* mimeData(const QModelIndexList& indexes) const override;
+    Qt::DropActions supportedDragActions() const override;
+
+    QString filePath(const QModelIndex& index) const;
+
+private:
+    struct FileStat {
+        qint64 size = 0;
+        qint64 modified = 0;
+        bool known = false;
+    };
+
+    static FileStat statFile(const QString& path);
+
+    int itemAt(int row) const;
+    const FileStat& statOf(int item) const;
+    void fetchNewFiles();
+    void startSort();
+    void stopSort();
+    void applySort(int generation, const QVector<int>& newOrder, const QVector<FileStat>& newStats);
+
+    PathIndex* index;
+    QString root;
+    int nextEntry;
+    SortKey key;
+
+    // Index entries of the files, in the order the walk found them.
+    QVector<int> items;
+    // Filled in as rows are shown, or all at once by a sort.
+    mutable QVector<FileStat> stats;
+    // Rows to items while sorted; rows past its end are files found after
+    // the sort, shown in discovery order.
+    QVector<int> order;
+
+    QThread* sorter;
+    std::atomic<bool> sortCancelled;
+    int sortGeneration;
+    QFileIconProvider iconProvider;
+};
+
+#endif // FLATLIST_H
@@ -0,0 +1,243 @@
+#include <QFontDatabase>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+
+#include <limits>
+
+#include "hexview.h"
+
+
+static const int padding = 8;
+
+// Column positions, in characters of the fixed-width font.
+static int hexColumn(int offsetDigits) {
+    return offsetDigits + 2;
+}
+
+static int byteColumn(int offsetDigits, int byte) {
+    // An extra space splits each row into two groups of eight.
+    return hexColumn(offsetDigits) + byte * 3 + (byte >= HexView::bytesPerRow / 2 ? 1 : 0);
+}
+
+static int asciiColumn(int offsetDigits) {
+    return hexColumn(offsetDigits) + HexView::bytesPerRow * 3 + 2;
+}
+
+
+HexView::HexView(QWidget *parent)
+        : QAbstractScrollArea(parent),
+          firstRow(0),
+          cursor(0),
+          highlightOffset(0),
+          highlightLength(0),
+          scrollScale(1),
+          updatingScrollBars(false) {
+    setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+    setFocusPolicy(Qt::StrongFocus);
+}
+
+bool HexView::open(const QString& path) {
+    if (!file.open(path)) {
+        return false;
+    }
+    firstRow = 0;
+    cursor = 0;
+    highlightLength = 0;
+    updateScrollBars();
+    viewport()->update();
+    return true;
+}
+
+qint64 HexView::fileSize() const {
+    return file.size();
+}
+
+qint64 HexView::cursorOffset() const {
+    return cursor;
+}
+
+qint64 HexView::rowCount() const {
+    return (file.size() + bytesPerRow - 1) / bytesPerRow;
+}
+
+int HexView::visibleRows() const {
+    return qMax(1, viewport()->height() / fontMetrics().height());
+}
+
+int HexView::offsetDigits() const {
+    return file.size() > 0xffffffffLL ? 16 : 8;
+}
+
+void HexView::goToOffset(qint64 offset) {
+    cursor = qBound<qint64>(0, offset, qMax<qint64>(0, file.size() - 1));
+
+    // Keep the cursor on screen, leaving some context above a jump target.
+    const qint64 row = cursor / bytesPerRow;
+    if (row < firstRow || row >= firstRow + visibleRows()) {
+        firstRow = row < firstRow ? row : row - visibleRows() / 3;
+    }
+    firstRow = qBound<qint64>(0, firstRow, qMax<qint64>(0, rowCount() - visibleRows()));
+
+    updateScrollBars();
+    viewport()->update();
+}
+
+void HexView::setHighlight(qint64 offset, qint64 length) {
+    highlightOffset = offset;
+    highlightLength = length;
+    viewport()->update();
+}
+
+void HexView::refresh() {
+    file.refreshSize();
+    updateScrollBars();
+    viewport()->update();
+}
+
+void HexView::updateScrollBars() {
+    updatingScrollBars = true;
+
+    // Same int range limit as the text view: scroll in steps of scrollScale
+    // rows once a file has more rows than QScrollBar can count.
+    const qint64 maximum = qMax<qint64>(0, rowCount() - visibleRows());
+    scrollScale = maximum / std::numeric_limits<int>::max() + 1;
+
+    verticalScrollBar()->setRange(0, int(maximum / scrollScale));
+    verticalScrollBar()->setPageStep(visibleRows());
+    verticalScrollBar()->setSingleStep(1);
+    verticalScrollBar()->setValue(int(firstRow / scrollScale));
+
+    const int width = 2 * padding + (asciiColumn(offsetDigits()) + bytesPerRow) * fontMetrics().horizontalAdvance('0');
+    horizontalScrollBar()->setRange(0, qMax(0, width - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+
+    updatingScrollBars = false;
+}
+
+void HexView::scrollContentsBy(int dx, int dy) {
+    Q_UNUSED(dx);
+    if (updatingScrollBars) {
+        return;
+    }
+    if (dy != 0) {
+        firstRow = qint64(verticalScrollBar()->value()) * scrollScale;
+    }
+    viewport()->update();
+}
+
+void HexView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateScrollBars();
+}
+
+void HexView::keyPressEvent(QKeyEvent *event) {
+    const qint64 page = qint64(visibleRows()) * bytesPerRow;
+
+    switch (event->key()) {
+    case Qt::Key_Left:
+        goToOffset(cursor - 1);
+        break;
+    case Qt::Key_Right:
+        goToOffset(cursor + 1);
+        break;
+    case Qt::Key_Up:
+        goToOffset(cursor - bytesPerRow);
+        break;
+    case Qt::Key_Down:
+        goToOffset(cursor + bytesPerRow);
+        break;
+    case Qt::Key_PageUp:
+        goToOffset(cursor - page);
+        break;
+    case Qt::Key_PageDown:
+        goToOffset(cursor + page);
+        break;
+    case Qt::Key_Home:
+        goToOffset(0);
+        break;
+    case Qt::Key_End:
+        goToOffset(file.size() - 1);
+        break;
+    default:
+        QAbstractScrollArea::keyPressEvent(event);
+    }
+}
+
+void HexView::mousePressEvent(QMouseEvent *event) {
+    const int charWidth = fontMetrics().horizontalAdvance('0');
+    const int column = (event->position().toPoint().x() + horizontalScrollBar()->value() - padding) / charWidth;
+    const qint64 row = firstRow + event->position().toPoint().y() / fontMetrics().height();
+    const int digits = offsetDigits();
+
+    int byte = -1;
+    if (column >= asciiColumn(digits) && column < asciiColumn(digits) + bytesPerRow) {
+        byte = column - asciiColumn(digits);
+    } else if (column >= hexColumn(digits) && column < asciiColumn(digits) - 2) {
+        int relative = column - hexColumn(digits);
+        if (relative > byteColumn(digits, bytesPerRow / 2) - hexColumn(digits) - 1) {
+            --relative;
+        }
+        byte = relative / 3;
+    }
+
+    if (byte >= 0) {
+        goToOffset(row * bytesPerRow + byte);
+    }
+    QAbstractScrollArea::mousePressEvent(event);
+}
+
+void HexView::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(viewport());
+    const QFontMetrics metrics = fontMetrics();
+    const int lineHeight = metrics.height();
+    const int charWidth = metrics.horizontalAdvance('0');
+    const int digits = offsetDigits();
+    const int left = padding - horizontalScrollBar()->value();
+
+    // Everything on screen fits in one small mapping.
+    const qint64 start = firstRow * bytesPerRow;
+    const qint64 length = qMin(qint64(visibleRows() + 1) * bytesPerRow, file.size() - start);
+    const uchar* data = length > 0 ? file.map(start, length) : nullptr;
+    if (!data) {
+        return;
+    }
+
+    for (qint64 rowStart = 0; rowStart < length; rowStart += bytesPerRow) {
+        const int row = int(rowStart / bytesPerRow);
+        const int top = row * lineHeight;
+        const int baseline = top + metrics.ascent();
+        const int count = int(qMin<qint64>(bytesPerRow, length - rowStart));
+
+        QString hex(asciiColumn(digits) - hexColumn(digits) - 2, QLatin1Char(' '));
+        QString ascii(count, QLatin1Char(' '));
+        for (int byte = 0; byte < count; ++byte) {
+            const qint64 offset = start + rowStart + byte;
+            const uchar value = data[rowStart + byte];
+            const int column = byteColumn(digits, byte) - hexColumn(digits);
+            hex[column] = QLatin1Char("0123456789abcdef"[value >> 4]);
+            hex[column + 1] = QLatin1Char("0123456789abcdef"[value & 0xf]);
+            ascii[byte] = value >= 0x20 && value < 0x7f ? QLatin1Char(char(value)) : QLatin1Char('.');
+
+            const QRect hexCell(left + byteColumn(digits, byte) * charWidth, top, 2 * charWidth, lineHeight);
+            const QRect asciiCell(left + (asciiColumn(digits) + byte) * charWidth, top, charWidth, lineHeight);
+            if (offset >= highlightOffset && offset < highlightOffset + highlightLength) {
+                painter.fillRect(hexCell, palette().highlight());
+                painter.fillRect(asciiCell, palette().highlight());
+            }
+            if (offset == cursor) {
+                painter.setPen(palette().color(QPalette::Text));
+                painter.drawRect(hexCell.adjusted(0, 0, -1, -1));
+                painter.drawRect(asciiCell.adjusted(0, 0, -1, -1));
+            }
+        }
+
+        painter.setPen(palette().color(QPalette::PlaceholderText));
+        painter.drawText(left, baseline, QString("%1").arg(start + rowStart, digits, 16, QChar('0')));
+        painter.setPen(palette().color(QPalette::Text));
+        painter.drawText(left + hexColumn(digits) * charWidth, baseline, hex);
+        painter.drawText(left + asciiColumn(digits) * charWidth, baseline, ascii);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef HEXVIEW_H
+#define HEXVIEW_H
+
+#include <QAbstractScrollArea>
+
+#include "mappedfile.h"
+
+// Hex dump of a memory-mapped file, sixteen bytes per row.
+//
+// Rows are addressed directly by offset, so only the bytes on screen are
+// ever touched and any position in the file can be reached at once.
+class HexView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    static constexpr int bytesPerRow = 16;
+
+    explicit HexView(QWidget *parent = nullptr);
+
+    bool open(const QString& path);
+    void goToOffset(qint64 offset);
+    void setHighlight(qint64 offset, qint64 length);
+    void refresh();
+
+    qint64 fileSize() const;
+    qint64 cursorOffset() const;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private:
+    void updateScrollBars();
+    int visibleRows() const;
+    qint64 rowCount() const;
+    int offsetDigits() const;
+
+    MappedFile file;
+    qint64 firstRow;
+    qint64 cursor;
+    qint64 highlightOffset;
+    qint64 highlightLength;
+    qint64 scrollScale;
+    bool updatingScrollBars;
+};
+
+#endif // HEXVIEW_H
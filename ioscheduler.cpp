@@ -0,0 +1,202 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QStorageInfo>
+
+#ifdef Q_OS_LINUX
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+#include "ioscheduler.h"
+
+
+// Files that are about to be created do not exist yet; their directory
+// decides the device.
+static QString existingAncestor(const QString& path) {
+    QFileInfo info(path);
+    while (!info.exists()) {
+        const QString parent = info.absolutePath();
+        if (parent == info.absoluteFilePath()) {
+            break;
+        }
+        info.setFile(parent);
+    }
+    return info.absoluteFilePath();
+}
+
+#ifdef Q_OS_LINUX
+static QString readSysfs(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromLatin1(file.readAll()).trimmed();
+}
+
+static QString wholeDisk(const QString& directory) {
+    // Partitions sit inside the sysfs directory of their disk.
+    return QFileInfo::exists(directory + "/partition") ? QFileInfo(directory).path() : directory;
+}
+
+// Returns the sysfs directory of the physical disk behind a block device.
+static QString diskDirectory(dev_t id) {
+    QString directory = QFileInfo(QString("/sys/dev/block/%1:%2").arg(major(id)).arg(minor(id))).canonicalFilePath();
+    if (directory.isEmpty()) {
+        return QString();
+    }
+    directory = wholeDisk(directory);
+
+    // Device-mapper and md devices stacked on a single disk (LVM, LUKS)
+    // share that disk's limit.
+    for (int depth = 0; depth < 4; ++depth) {
+        const QStringList slaves = QDir(directory + "/slaves").entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        if (slaves.size() != 1) {
+            break;
+        }
+        const QString slave = QFileInfo(directory + "/slaves/" + slaves.first()).canonicalFilePath();
+        if (slave.isEmpty()) {
+            break;
+        }
+        directory = wholeDisk(slave);
+    }
+    return directory;
+}
+#endif
+
+
+IoScheduler& IoScheduler::instance() {
+    static IoScheduler scheduler;
+    return scheduler;
+}
+
+IoScheduler::Device IoScheduler::device(const QString& path) {
+    const QString existing = existingAncestor(path);
+
+#ifdef Q_OS_LINUX
+    struct stat info;
+    if (::stat(QFile::encodeName(existing).constData(), &info) != 0) {
+        return {QString("unknown"), false, solidStateConcurrency};
+    }
+    const quint64 id = quint64(info.st_dev);
+#else
+    const quint64 id = qHash(QStorageInfo(existing).rootPath());
+#endif
+
+    {
+        QMutexLocker locker(&mutex);
+        auto it = devicesById.constFind(id);
+        if (it != devicesById.cend()) {
+            return it.value();
+        }
+    }
+
+    const Device found = probe(existing);
+
+    QMutexLocker locker(&mutex);
+    devicesById.insert(id, found);
+    queues[found.name].capacity = found.concurrency;
+    return found;
+}
+
+IoScheduler::Device IoScheduler::probe(const QString& path) {
+#ifdef Q_OS_LINUX
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return {QString("unknown"), false, solidStateConcurrency};
+    }
+
+    dev_t blockDevice = info.st_dev;
+    if (major(blockDevice) == 0) {
+        // Btrfs and overlay filesystems report an anonymous device number;
+        // the device node the filesystem was mounted from leads to the disk.
+        const QByteArray source = QStorageInfo(path).device();
+        struct stat node;
+        if (!source.startsWith("/dev/") || ::stat(source.constData(), &node) != 0 || !S_ISBLK(node.st_mode)) {
+            // tmpfs, network filesystems and the like: no disk to protect.
+            return {QString("dev:%1").arg(quint64(info.st_dev)), false, solidStateConcurrency};
+        }
+        blockDevice = node.st_rdev;
+    }
+
+    const QString disk = diskDirectory(blockDevice);
+    if (disk.isEmpty()) {
+        return {QString("dev:%1").arg(quint64(blockDevice)), false, solidStateConcurrency};
+    }
+
+    Device found;
+    found.name = QFileInfo(disk).fileName();
+    found.rotational = readSysfs(disk + "/queue/rotational") == "1";
+    if (found.rotational) {
+        found.concurrency = rotationalConcurrency;
+    } else if (found.name.startsWith("nvme")) {
+        found.concurrency = nvmeConcurrency;
+    } else {
+        found.concurrency = solidStateConcurrency;
+    }
+    return found;
+#else
+    return {QStorageInfo(path).rootPath(), false, solidStateConcurrency};
+#endif
+}
+
+void IoScheduler::acquire(const QStringList& deviceNames) {
+    QMutexLocker locker(&mutex);
+    for (const QString& name: deviceNames) {
+        const quint64 ticket = queues[name].nextTicket++;
+        while (true) {
+            // Look the queue up again after every wait: the hash may have
+            // grown and moved it in the meantime.
+            Queue& queue = queues[name];
+            if (queue.nowServing == ticket && queue.active < queue.capacity) {
+                ++queue.active;
+                ++queue.nowServing;
+                break;
+            }
+            slotFreed.wait(&mutex);
+        }
+        // The next ticket in line may fit as well.
+        slotFreed.wakeAll();
+    }
+}
+
+void IoScheduler::release(const QStringList& deviceNames) {
+    QMutexLocker locker(&mutex);
+    for (const QString& name: deviceNames) {
+        --queues[name].active;
+    }
+    slotFreed.wakeAll();
+}
+
+
+IoScheduler::Slot::Slot(const QString& sourcePath, const QString& destinationPath) {
+    IoScheduler& scheduler = instance();
+    devices.append(scheduler.device(sourcePath).name);
+    if (!destinationPath.isEmpty()) {
+        const QString destinationDevice = scheduler.device(destinationPath).name;
+        if (!devices.contains(destinationDevice)) {
+            devices.append(destinationDevice);
+        }
+    }
+
+    // Taking slots in a fixed order keeps two transfers in opposite
+    // directions between the same disks from deadlocking.
+    devices.sort();
+    scheduler.acquire(devices);
+}
+
+IoScheduler::Slot::~Slot() {
+    instance().release(devices);
+}
+
+void IoScheduler::Slot::yield(const std::function<void()>& meanwhile) {
+    // Waiters are served first come, first served, so anyone already queued
+    // on these disks goes before this transfer continues.
+    IoScheduler& scheduler = instance();
+    scheduler.release(devices);
+    if (meanwhile) {
+        meanwhile();
+    }
+    scheduler.acquire(devices);
+}
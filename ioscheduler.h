@@ -0,0 +1,71 @@
+#ifndef IOSCHEDULER_H
+#define IOSCHEDULER_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QWaitCondition>
+
+#include <functional>
+
+// Limits how many bulk transfers run against each physical disk at once.
+//
+// Every path is mapped to the whole disk behind it, so two partitions of one
+// spinning disk share a limit. Rotational disks get a single slot because
+// parallel streams only make the heads seek between them; SSDs and NVMe
+// drives need several requests in flight to reach full speed. Transfers on
+// different disks never wait for each other, and waiters on one disk are
+// admitted in arrival order.
+class IoScheduler {
+public:
+    static constexpr int rotationalConcurrency = 1;
+    static constexpr int solidStateConcurrency = 4;
+    static constexpr int nvmeConcurrency = 8;
+
+    struct Device {
+        QString name;
+        bool rotational;
+        int concurrency;
+    };
+
+    // Holds a slot on the disks of a source and an optional destination for
+    // as long as it exists.
+    class Slot {
+    public:
+        explicit Slot(const QString& sourcePath, const QString& destinationPath = QString());
+        ~Slot();
+
+        // Lets waiters on the same disks go first; meanwhile runs while the
+        // slot is given up.
+        void yield(const std::function<void()>& meanwhile = nullptr);
+
+    private:
+        QStringList devices;
+    };
+
+    static IoScheduler& instance();
+
+    Device device(const QString& path);
+
+private:
+    struct Queue {
+        int capacity = 1;
+        int active = 0;
+        quint64 nextTicket = 0;
+        quint64 nowServing = 0;
+    };
+
+    IoScheduler() = default;
+
+    void acquire(const QStringList& deviceNames);
+    void release(const QStringList& deviceNames);
+    Device probe(const QString& path);
+
+    QMutex mutex;
+    QWaitCondition slotFreed;
+    QHash<quint64, Device> devicesById;
+    QHash<QString, Queue> queues;
+};
+
+#endif // IOSCHEDULER_H
@@ -0,0 +1,272 @@
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+#endif
+
+#include "iouring.h"
+
+
+#ifdef Q_OS_LINUX
+static int ringSetup(unsigned entries, io_uring_params* params) {
+    return int(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int ringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return int(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+static int ringRegister(int fd, unsigned opcode, const void* arg, unsigned count) {
+    return int(::syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+template<typename T>
+static T* ringField(void* ring, unsigned offset) {
+    return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+#endif
+
+
+IoUring::IoUring()
+        : ringFd(-1),
+          submissionRing(nullptr),
+          submissionRingSize(0),
+          completionRing(nullptr),
+          completionRingSize(0),
+          entries(nullptr),
+          entriesSize(0),
+          submissionHead(nullptr),
+          submissionTail(nullptr),
+          submissionArray(nullptr),
+          submissionMask(0),
+          submissionEntries(0),
+          localTail(0),
+          completionHead(nullptr),
+          completionTail(nullptr),
+          completionMask(0),
+          completions(nullptr) {
+}
+
+IoUring::~IoUring() {
+    close();
+}
+
+bool IoUring::isSupported() {
+#ifdef Q_OS_LINUX
+    // Older kernels lack some of the operations used here, and seccomp
+    // filters in containers often reject io_uring altogether; both are
+    // detected once by trying. File slots are checked by the copy that
+    // needs them, which falls back to read and write without.
+    static const bool supported = []() {
+        IoUring ring;
+        if (!ring.init(8)) {
+            return false;
+        }
+
+        std::vector<char> buffer(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op), 0);
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (ringRegister(ring.ringFd, IORING_REGISTER_PROBE, probe, 256) < 0) {
+            return false;
+        }
+        for (int opcode: {IORING_OP_OPENAT, IORING_OP_CLOSE, IORING_OP_READ, IORING_OP_WRITE,
+                          IORING_OP_STATX, IORING_OP_UNLINKAT}) {
+            if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+                return false;
+            }
+        }
+        return true;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+bool IoUring::init(unsigned count) {
+#ifdef Q_OS_LINUX
+    close();
+
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ringFd = ringSetup(count, &params);
+    if (ringFd < 0) {
+        ringFd = -1;
+        return false;
+    }
+
+    submissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    completionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        submissionRingSize = completionRingSize = qMax(submissionRingSize, completionRingSize);
+    }
+
+    submissionRing = ::mmap(nullptr, submissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ringFd, IORING_OFF_SQ_RING);
+    if (submissionRing == MAP_FAILED) {
+        submissionRing = nullptr;
+        close();
+        return false;
+    }
+
+    if (singleMap) {
+        completionRing = submissionRing;
+    } else {
+        completionRing = ::mmap(nullptr, completionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                ringFd, IORING_OFF_CQ_RING);
+        if (completionRing == MAP_FAILED) {
+            completionRing = nullptr;
+            close();
+            return false;
+        }
+    }
+
+    entriesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void* mappedEntries = ::mmap(nullptr, entriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 ringFd, IORING_OFF_SQES);
+    if (mappedEntries == MAP_FAILED) {
+        close();
+        return false;
+    }
+    entries = static_cast<io_uring_sqe*>(mappedEntries);
+
+    submissionHead = ringField<unsigned>(submissionRing, params.sq_off.head);
+    submissionTail = ringField<unsigned>(submissionRing, params.sq_off.tail);
+    submissionArray = ringField<unsigned>(submissionRing, params.sq_off.array);
+    submissionMask = *ringField<unsigned>(submissionRing, params.sq_off.ring_mask);
+    submissionEntries = params.sq_entries;
+    localTail = *submissionTail;
+
+    completionHead = ringField<unsigned>(completionRing, params.cq_off.head);
+    completionTail = ringField<unsigned>(completionRing, params.cq_off.tail);
+    completionMask = *ringField<unsigned>(completionRing, params.cq_off.ring_mask);
+    completions = ringField<io_uring_cqe>(completionRing, params.cq_off.cqes);
+    return true;
+#else
+    Q_UNUSED(count);
+    return false;
+#endif
+}
+
+bool IoUring::registerFileSlots(unsigned count) {
+    // Headers from before Linux 5.19 have no sparse tables; the ring then
+    // has no slots and copies go through read and write.
+#if defined(Q_OS_LINUX) && defined(IORING_RSRC_REGISTER_SPARSE)
+    // A sparse table lets openat install files straight into a slot, so
+    // later entries in the same chain can refer to a file that does not
+    // exist yet at submission time.
+    io_uring_rsrc_register request;
+    std::memset(&request, 0, sizeof(request));
+    request.nr = count;
+    request.flags = IORING_RSRC_REGISTER_SPARSE;
+    return ringRegister(ringFd, IORING_REGISTER_FILES2, &request, sizeof(request)) >= 0;
+#else
+    Q_UNUSED(count);
+    return false;
+#endif
+}
+
+bool IoUring::isOpen() const {
+    return ringFd >= 0;
+}
+
+io_uring_sqe* IoUring::nextEntry() {
+#ifdef Q_OS_LINUX
+    const unsigned head = __atomic_load_n(submissionHead, __ATOMIC_ACQUIRE);
+    if (localTail - head >= submissionEntries) {
+        return nullptr;
+    }
+
+    const unsigned index = localTail & submissionMask;
+    io_uring_sqe* entry = &entries[index];
+    std::memset(entry, 0, sizeof(*entry));
+    submissionArray[index] = index;
+    ++localTail;
+    return entry;
+#else
+    return nullptr;
+#endif
+}
+
+bool IoUring::submit() {
+#ifdef Q_OS_LINUX
+    const unsigned pending = localTail - *submissionTail;
+    __atomic_store_n(submissionTail, localTail, __ATOMIC_RELEASE);
+
+    unsigned submitted = 0;
+    while (submitted < pending) {
+        int result = ringEnter(ringFd, pending - submitted, 0, 0);
+        if (result < 0) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            qWarning() << "io_uring_enter failed:" << qt_error_string(errno);
+            return false;
+        }
+        submitted += unsigned(result);
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IoUring::waitForCompletion() {
+#ifdef Q_OS_LINUX
+    while (ringEnter(ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0) {
+        if (errno != EINTR) {
+            qWarning() << "io_uring_enter failed:" << qt_error_string(errno);
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool IoUring::nextCompletion(quint64& userData, int& result) {
+#ifdef Q_OS_LINUX
+    const unsigned head = *completionHead;
+    if (head == __atomic_load_n(completionTail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    const io_uring_cqe& completion = static_cast<io_uring_cqe*>(completions)[head & completionMask];
+    userData = completion.user_data;
+    result = completion.res;
+    __atomic_store_n(completionHead, head + 1, __ATOMIC_RELEASE);
+    return true;
+#else
+    Q_UNUSED(userData);
+    Q_UNUSED(result);
+    return false;
+#endif
+}
+
+void IoUring::close() {
+#ifdef Q_OS_LINUX
+    if (entries) {
+        ::munmap(entries, entriesSize);
+        entries = nullptr;
+    }
+    if (completionRing && completionRing != submissionRing) {
+        ::munmap(completionRing, completionRingSize);
+    }
+    completionRing = nullptr;
+    if (submissionRing) {
+        ::munmap(submissionRing, submissionRingSize);
+        submissionRing = nullptr;
+    }
+    if (ringFd >= 0) {
+        ::close(ringFd);
+        ringFd = -1;
+    }
+#endif
+}
@@ -0,0 +1,56 @@
+#ifndef IOURING_H
+#define IOURING_H
+
+#include <QtGlobal>
+
+struct io_uring_sqe;
+
+// Minimal io_uring submission and completion ring, driven through the raw
+// system calls so that no liburing is needed at build or run time.
+//
+// One ring belongs to one thread. Callers fill entries from nextEntry(),
+// publish them with submit() and collect results with nextCompletion();
+// waitForCompletion() blocks until at least one result is ready.
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    static bool isSupported();
+
+    bool init(unsigned entries);
+    bool registerFileSlots(unsigned count);
+    bool isOpen() const;
+
+    io_uring_sqe* nextEntry();
+    bool submit();
+    bool waitForCompletion();
+    bool nextCompletion(quint64& userData, int& result);
+
+private:
+    Q_DISABLE_COPY(IoUring)
+
+    void close();
+
+    int ringFd;
+    void* submissionRing;
+    size_t submissionRingSize;
+    void* completionRing;
+    size_t completionRingSize;
+    io_uring_sqe* entries;
+    size_t entriesSize;
+
+    unsigned* submissionHead;
+    unsigned* submissionTail;
+    unsigned* submissionArray;
+    unsigned submissionMask;
+    unsigned submissionEntries;
+    unsigned localTail;
+
+    unsigned* completionHead;
+    unsigned* completionTail;
+    unsigned completionMask;
+    void* completions;
+};
+
+#endif // IOURING_H
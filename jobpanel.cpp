@@ -0,0 +1,139 @@
+#include <QCheckBox>
+#include <QGroupBox>
+#include <QHBoxLayout>
+#include <QLabel>
+#include <QLocale>
+#include <QProgressBar>
+#include <QScreen>
+#include <QSettings>
+#include <QSpinBox>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include "jobpanel.h"
+#include "preflight.h"
+#include "throttle.h"
+
+
+JobPanel::JobPanel(QWidget *parent)
+        : QWidget(parent, Qt::Tool),
+          nextId(0) {
+    setWindowTitle(tr("Jobs"));
+    // An open panel does not keep the application running.
+    setAttribute(Qt::WA_QuitOnClose, false);
+    resize(520, 240);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    QGroupBox* globalBox = new QGroupBox(tr("All jobs"), this);
+    QVBoxLayout* globalLayout = new QVBoxLayout(globalBox);
+    globalLayout->addWidget(createLimitEditors(&Throttle::global(), true));
+    layout->addWidget(globalBox);
+
+    jobLayout = new QVBoxLayout;
+    layout->addLayout(jobLayout);
+    idleLabel = new QLabel(tr("No jobs running."), this);
+    jobLayout->addWidget(idleLabel);
+    layout->addStretch();
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(frameInterval(this));
+    connect(refreshTimer, &QTimer::timeout, this, &JobPanel::refresh);
+}
+
+int JobPanel::addJob(const QString& title, Throttle* throttle, const TransferProgress* progress) {
+    QGroupBox* box = new QGroupBox(title, this);
+    QVBoxLayout* boxLayout = new QVBoxLayout(box);
+    Row row;
+    row.widget = box;
+    row.progress = progress;
+    row.bar = new QProgressBar(box);
+    row.bar->setRange(0, 1000);
+    row.status = new QLabel(box);
+    boxLayout->addWidget(row.bar);
+    boxLayout->addWidget(row.status);
+    boxLayout->addWidget(createLimitEditors(throttle, false));
+
+    const int id = nextId++;
+    rows.insert(id, row);
+    jobLayout->addWidget(box);
+    idleLabel->hide();
+    refresh();
+    refreshTimer->start();
+    return id;
+}
+
+void JobPanel::removeJob(int id) {
+    const Row row = rows.take(id);
+    delete row.widget;
+    if (rows.isEmpty()) {
+        refreshTimer->stop();
+        idleLabel->show();
+    }
+}
+
+void JobPanel::refresh() {
+    for (const Row& row: rows) {
+        const qint64 total = row.progress->total();
+        const qint64 done = qMin(row.progress->done(), total);
+        row.bar->setValue(total > 0 ? int(done * 1000 / total) : 0);
+        QString status = tr("%1 of %2").arg(QLocale().formattedDataSize(done), QLocale().formattedDataSize(total));
+        if (row.progress->totalFiles() > 0) {
+            status += ", " + tr("%1 of %2 files").arg(QLocale().toString(qMin(row.progress->doneFiles(),
+                                                                           row.progress->totalFiles())),
+                                                     QLocale().toString(row.progress->totalFiles()));
+        }
+        row.status->setText(status);
+    }
+}
+
+int JobPanel::frameInterval(const QWidget* widget) {
+    const QScreen* screen = widget->screen();
+    const qreal rate = screen && screen->refreshRate() > 0 ? screen->refreshRate() : 60;
+    return qMax(1, qRound(1000 / rate));
+}
+
+QWidget* JobPanel::createLimitEditors(Throttle* throttle, bool global) {
+    QWidget* editors = new QWidget(this);
+    QHBoxLayout* layout = new QHBoxLayout(editors);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    QSpinBox* bytesBox = new QSpinBox(editors);
+    bytesBox->setRange(0, 1 << 20);
+    bytesBox->setSuffix(tr(" MiB/s"));
+    bytesBox->setSpecialValueText(tr("unlimited"));
+    bytesBox->setValue(int(throttle->bytesPerSecond() >> 20));
+    layout->addWidget(new QLabel(tr("Bandwidth:"), editors));
+    layout->addWidget(bytesBox);
+
+    QSpinBox* operationsBox = new QSpinBox(editors);
+    operationsBox->setRange(0, 1000000);
+    operationsBox->setSingleStep(100);
+    operationsBox->setSuffix(tr(" ops/s"));
+    operationsBox->setSpecialValueText(tr("unlimited"));
+    operationsBox->setValue(int(throttle->operationsPerSecond()));
+    layout->addWidget(new QLabel(tr("Operations:"), editors));
+    layout->addWidget(operationsBox);
+
+    connect(bytesBox, &QSpinBox::valueChanged, editors, [throttle, global](int megabytes) {
+        throttle->setBytesPerSecond(qint64(megabytes) << 20);
+        if (global) {
+            QSettings().setValue("throttle/bytesPerSecond", throttle->bytesPerSecond());
+        }
+    });
+    connect(operationsBox, &QSpinBox::valueChanged, editors, [throttle, global](int operations) {
+        throttle->setOperationsPerSecond(operations);
+        if (global) {
+            QSettings().setValue("throttle/operationsPerSecond", throttle->operationsPerSecond());
+        }
+    });
+
+    // The I/O priority belongs to the threads of a job.
+    if (!global) {
+        QCheckBox* idleBox = new QCheckBox(tr("Idle I/O priority"), editors);
+        idleBox->setChecked(throttle->idlePriority());
+        connect(idleBox, &QCheckBox::toggled, editors, [throttle](bool idle) { throttle->setIdlePriority(idle); });
+        layout->addWidget(idleBox);
+    }
+    layout->addStretch();
+    return editors;
+}
@@ -0,0 +1,55 @@
+#ifndef JOBPANEL_H
+#define JOBPANEL_H
+
+#include <QHash>
+#include <QWidget>
+
+class QLabel;
+class QProgressBar;
+class QSpinBox;
+class QTimer;
+class QVBoxLayout;
+class Throttle;
+class TransferProgress;
+
+// Lists running copy and move jobs with their progress, and the limits
+// that pace them: one row for all jobs together, then one per job. A
+// change applies to the next chunk a job copies.
+//
+// The panel is a window of its own, without a parent, so the modal
+// progress dialog of a copy does not block it.
+class JobPanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit JobPanel(QWidget *parent = nullptr);
+
+    // The throttle and progress must outlive the row; removeJob() ends it.
+    int addJob(const QString& title, Throttle* throttle, const TransferProgress* progress);
+    void removeJob(int id);
+
+    // How often progress is worth sampling for widget: once a frame of the
+    // screen it is on, and no more.
+    static int frameInterval(const QWidget* widget);
+
+private slots:
+    void refresh();
+
+private:
+    struct Row {
+        QWidget* widget;
+        QProgressBar* bar;
+        QLabel* status;
+        const TransferProgress* progress;
+    };
+
+    QWidget* createLimitEditors(Throttle* throttle, bool global);
+
+    QVBoxLayout* jobLayout;
+    QLabel* idleLabel;
+    QTimer* refreshTimer;
+    QHash<int, Row> rows;
+    int nextId;
+};
+
+#endif // JOBPANEL_H
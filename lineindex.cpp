@@ -0,0 +1,269 @@
+#include <QMutexLocker>
+#include <QThread>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINEINDEX_HAVE_SSE2
+#endif
+
+#include "lineindex.h"
+#include "mappedfile.h"
+
+
+// Chunk used when walking a handful of lines from a checkpoint.
+static const qint64 lineScanChunk = 1 << 20;
+
+struct ScanState {
+    qint64 newlines;
+    qint64 lastLineStart;
+    qint64 nextCheckpoint;
+};
+
+// Records every newline in data, which starts at file offset base, and the
+// start offset of every checkpointSpacing-th line into checkpoints.
+static void scanNewlines(const uchar* data, qint64 length, qint64 base, ScanState& state, QVector<qint64>& checkpoints) {
+    auto found = [&](qint64 position) {
+        ++state.newlines;
+        state.lastLineStart = base + position + 1;
+        if (state.newlines == state.nextCheckpoint) {
+            checkpoints.append(base + position + 1);
+            state.nextCheckpoint += LineIndex::checkpointSpacing;
+        }
+    };
+
+    qint64 i = 0;
+#ifdef LINEINDEX_HAVE_SSE2
+    // Compare 64 bytes per iteration and fold the results into one bit mask.
+    // Blocks that do not reach the next checkpoint only need a popcount.
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 64 <= length; i += 64) {
+        const __m128i* block = reinterpret_cast<const __m128i*>(data + i);
+        quint64 mask = quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block), newline))))
+                       | quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 1), newline)))) << 16
+                       | quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 2), newline)))) << 32
+                       | quint64(quint16(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128(block + 3), newline)))) << 48;
+        if (!mask) {
+            continue;
+        }
+
+        const qint64 count = qPopulationCount(mask);
+        if (state.newlines + count < state.nextCheckpoint) {
+            state.newlines += count;
+            state.lastLineStart = base + i + (63 - qCountLeadingZeroBits(mask)) + 1;
+            continue;
+        }
+
+        while (mask) {
+            found(i + qCountTrailingZeroBits(mask));
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    // memchr is vectorised by the C library, which covers the tail and
+    // platforms without SSE2.
+    while (i < length) {
+        const void* hit = std::memchr(data + i, '\n', length - i);
+        if (!hit) {
+            break;
+        }
+        const qint64 position = static_cast<const uchar*>(hit) - data;
+        found(position);
+        i = position + 1;
+    }
+}
+
+
+LineIndex::LineIndex(QObject *parent)
+        : QObject(parent),
+          worker(nullptr),
+          stopRequested(false),
+          newlines(0),
+          lastLineStart(0),
+          scannedBytes(0) {
+}
+
+LineIndex::~LineIndex() {
+    stop();
+}
+
+void LineIndex::start(const QString& path) {
+    stop();
+
+    {
+        QMutexLocker locker(&mutex);
+        filePath = path;
+        checkpoints = {0};
+        newlines = 0;
+        lastLineStart = 0;
+        scannedBytes = 0;
+    }
+
+    extend();
+}
+
+void LineIndex::extend() {
+    if (worker && !worker->isFinished()) {
+        return;
+    }
+    delete worker;
+    worker = QThread::create([this]() { run(); });
+    worker->start(QThread::LowPriority);
+}
+
+void LineIndex::stop() {
+    if (!worker) {
+        return;
+    }
+    stopRequested = true;
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    stopRequested = false;
+}
+
+qint64 LineIndex::lineCount() const {
+    QMutexLocker locker(&mutex);
+    return newlines + (scannedBytes > lastLineStart ? 1 : 0);
+}
+
+qint64 LineIndex::indexedBytes() const {
+    QMutexLocker locker(&mutex);
+    return scannedBytes;
+}
+
+bool LineIndex::isIndexing() const {
+    return worker && worker->isRunning();
+}
+
+void LineIndex::run() {
+    MappedFile file;
+    if (!file.open(filePath)) {
+        emit finished();
+        return;
+    }
+
+    while (!stopRequested) {
+        const qint64 size = file.refreshSize();
+
+        ScanState state;
+        qint64 position;
+        {
+            QMutexLocker locker(&mutex);
+            position = scannedBytes;
+            state.newlines = newlines;
+            state.lastLineStart = lastLineStart;
+            state.nextCheckpoint = checkpoints.size() * checkpointSpacing;
+        }
+        if (position >= size) {
+            break;
+        }
+
+        const qint64 length = qMin(MappedFile::windowSize, size - position);
+        const uchar* data = file.map(position, length);
+        if (!data) {
+            break;
+        }
+
+        QVector<qint64> found;
+        scanNewlines(data, length, position, state, found);
+
+        qint64 lines;
+        {
+            QMutexLocker locker(&mutex);
+            checkpoints += found;
+            newlines = state.newlines;
+            lastLineStart = state.lastLineStart;
+            scannedBytes = position + length;
+            lines = newlines + (scannedBytes > lastLineStart ? 1 : 0);
+        }
+        emit progress(lines, position + length);
+    }
+
+    emit finished();
+}
+
+qint64 LineIndex::lineOffset(qint64 line, MappedFile& file) const {
+    qint64 offset;
+    qint64 checkpointLine;
+    {
+        QMutexLocker locker(&mutex);
+        const qint64 checkpoint = qBound<qint64>(0, line / checkpointSpacing, checkpoints.size() - 1);
+        offset = checkpoints.at(checkpoint);
+        checkpointLine = checkpoint * checkpointSpacing;
+    }
+
+    for (qint64 current = checkpointLine; current < line && offset < file.size(); ++current) {
+        offset = nextLineStart(file, offset);
+    }
+    return offset;
+}
+
+qint64 LineIndex::lineAt(qint64 offset, MappedFile& file) const {
+    qint64 line;
+    qint64 position;
+    qint64 indexed;
+    qint64 knownLines;
+    {
+        QMutexLocker locker(&mutex);
+        auto it = std::upper_bound(checkpoints.cbegin(), checkpoints.cend(), offset);
+        const qint64 checkpoint = qMax<qint64>(0, (it - checkpoints.cbegin()) - 1);
+        position = checkpoints.at(checkpoint);
+        line = checkpoint * checkpointSpacing;
+        indexed = scannedBytes;
+        knownLines = newlines;
+    }
+
+    if (offset > indexed && indexed > 0) {
+        // Past the indexed part: extrapolate from the average line length.
+        return qint64(double(knownLines) * offset / indexed);
+    }
+
+    while (true) {
+        const qint64 next = nextLineStart(file, position);
+        if (next > offset || next >= file.size()) {
+            return line;
+        }
+        position = next;
+        ++line;
+    }
+}
+
+qint64 LineIndex::nextLineStart(MappedFile& file, qint64 offset) {
+    const qint64 size = file.size();
+    while (offset < size) {
+        const qint64 length = qMin(lineScanChunk, size - offset);
+        const uchar* data = file.map(offset, length);
+        if (!data) {
+            return size;
+        }
+        const void* hit = std::memchr(data, '\n', length);
+        if (hit) {
+            return offset + (static_cast<const uchar*>(hit) - data) + 1;
+        }
+        offset += length;
+    }
+    return size;
+}
+
+qint64 LineIndex::lineStartBefore(MappedFile& file, qint64 offset) {
+    offset = qMin(offset, file.size());
+    while (offset > 0) {
+        const qint64 length = qMin(lineScanChunk, offset);
+        const uchar* data = file.map(offset - length, length);
+        if (!data) {
+            return 0;
+        }
+        for (qint64 i = length - 1; i >= 0; --i) {
+            if (data[i] == '\n') {
+                return offset - length + i + 1;
+            }
+        }
+        offset -= length;
+    }
+    return 0;
+}
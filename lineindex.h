@@ -0,0 +1,60 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QMutex>
+#include <QObject>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+class MappedFile;
+
+// Line-offset index for very large text files, built on a background thread.
+//
+// Storing an offset for every line of a multi-gigabyte log would itself take
+// gigabytes, so only the start of every checkpointSpacing-th line is kept.
+// Finding any line is then a lookup plus a scan over fewer than
+// checkpointSpacing lines, independent of the file size.
+class LineIndex : public QObject {
+    Q_OBJECT
+
+public:
+    static constexpr qint64 checkpointSpacing = 64;
+
+    explicit LineIndex(QObject *parent = nullptr);
+    ~LineIndex();
+
+    void start(const QString& path);
+    void extend();
+
+    qint64 lineCount() const;
+    qint64 indexedBytes() const;
+    bool isIndexing() const;
+
+    qint64 lineOffset(qint64 line, MappedFile& file) const;
+    qint64 lineAt(qint64 offset, MappedFile& file) const;
+
+    static qint64 nextLineStart(MappedFile& file, qint64 offset);
+    static qint64 lineStartBefore(MappedFile& file, qint64 offset);
+
+signals:
+    void progress(qint64 lines, qint64 bytes);
+    void finished();
+
+private:
+    void run();
+    void stop();
+
+    QString filePath;
+    QThread *worker;
+    std::atomic<bool> stopRequested;
+
+    mutable QMutex mutex;
+    QVector<qint64> checkpoints;
+    qint64 newlines;
+    qint64 lastLineStart;
+    qint64 scannedBytes;
+};
+
+#endif // LINEINDEX_H
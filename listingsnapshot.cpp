@@ -0,0 +1,168 @@
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDebug>
+
+#include "listingsnapshot.h"
+
+
+static const quint32 snapshotMagic = 0x464d534e; // "FMSN"
+static const quint16 snapshotVersion = 1;
+
+static QByteArray encodePane(const PaneSnapshot& pane) {
+    QByteArray payload;
+    QDataStream out(&payload, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+
+    out << pane.listRoot.toUtf8() << quint32(pane.expanded.size());
+    for (const QString& path: pane.expanded) {
+        out << path.toUtf8();
+    }
+
+    out << quint32(pane.entries.size());
+    for (const SnapshotEntry& entry: pane.entries) {
+        out << entry.name.toUtf8() << quint8(entry.isDir) << entry.size << entry.modified;
+    }
+    return qCompress(payload);
+}
+
+static bool decodePane(const QByteArray& compressed, PaneSnapshot& pane) {
+    QByteArray payload = qUncompress(compressed);
+    QDataStream in(payload);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    QByteArray text;
+    quint32 count;
+    in >> text >> count;
+    pane.listRoot = QString::fromUtf8(text);
+    pane.expanded.clear();
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        in >> text;
+        pane.expanded << QString::fromUtf8(text);
+    }
+
+    in >> count;
+    pane.entries.clear();
+    pane.entries.reserve(qMin<quint32>(count, ListingSnapshot::maxEntries));
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        SnapshotEntry entry;
+        quint8 isDir;
+        in >> text >> isDir >> entry.size >> entry.modified;
+        entry.name = QString::fromUtf8(text);
+        entry.isDir = isDir;
+        pane.entries.append(entry);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+
+QString ListingSnapshot::defaultPath() {
+    return QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/listing.snapshot";
+}
+
+bool ListingSnapshot::save(const QString& path, const QVector<PaneSnapshot>& panes) {
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write listing snapshot:" << path;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << snapshotMagic << snapshotVersion << quint8(panes.size());
+    for (const PaneSnapshot& pane: panes) {
+        out << encodePane(pane);
+    }
+    return file.commit();
+}
+
+bool ListingSnapshot::load(const QString& path, QVector<PaneSnapshot>& panes) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+
+    quint32 magic;
+    quint16 version;
+    quint8 count;
+    in >> magic >> version >> count;
+    if (in.status() != QDataStream::Ok || magic != snapshotMagic || version != snapshotVersion) {
+        return false;
+    }
+
+    panes.clear();
+    for (quint8 i = 0; i < count; ++i) {
+        QByteArray compressed;
+        in >> compressed;
+        PaneSnapshot pane;
+        if (in.status() != QDataStream::Ok || !decodePane(compressed, pane)) {
+            qWarning() << "Discarding damaged listing snapshot:" << path;
+            panes.clear();
+            return false;
+        }
+        panes.append(pane);
+    }
+    return true;
+}
+
+PaneSnapshot ListingSnapshot::capture(QFileSystemModel* model, const QModelIndex& root, const QStringList& expanded) {
+    PaneSnapshot pane;
+    pane.listRoot = model->filePath(root);
+    pane.expanded = expanded;
+
+    // Views only paint the first screenful on startup, so very large
+    // directories are truncated rather than bloating the snapshot.
+    const int rows = qMin(model->rowCount(root), maxEntries);
+    pane.entries.reserve(rows);
+    for (int row = 0; row < rows; ++row) {
+        QModelIndex index = model->index(row, 0, root);
+        SnapshotEntry entry;
+        entry.name = model->fileName(index);
+        entry.isDir = model->isDir(index);
+        entry.size = model->size(index);
+        entry.modified = model->lastModified(index).toMSecsSinceEpoch();
+        pane.entries.append(entry);
+    }
+    return pane;
+}
+
+
+SnapshotListModel::SnapshotListModel(const PaneSnapshot& snapshot, QObject *parent)
+        : QAbstractListModel(parent),
+          pane(snapshot) {
+}
+
+int SnapshotListModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : pane.entries.size();
+}
+
+QVariant SnapshotListModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= pane.entries.size()) {
+        return QVariant();
+    }
+
+    const SnapshotEntry& entry = pane.entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return entry.name;
+    case Qt::DecorationRole:
+        return iconProvider.icon(entry.isDir ? QFileIconProvider::Folder : QFileIconProvider::File);
+    case QFileSystemModel::FilePathRole:
+        return QDir(pane.listRoot).filePath(entry.name);
+    default:
+        return QVariant();
+    }
+}
+
+const PaneSnapshot& SnapshotListModel::snapshot() const {
+    return pane;
+}
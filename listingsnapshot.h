@@ -0,0 +1,56 @@
+#ifndef LISTINGSNAPSHOT_H
+#define LISTINGSNAPSHOT_H
+
+#include <QAbstractListModel>
+#include <QFileIconProvider>
+#include <QFileSystemModel>
+#include <QStringList>
+#include <QVector>
+
+struct SnapshotEntry {
+    QString name;
+    bool isDir = false;
+    qint64 size = 0;
+    qint64 modified = 0;
+};
+
+struct PaneSnapshot {
+    QString listRoot;
+    QStringList expanded;
+    QVector<SnapshotEntry> entries;
+};
+
+// Compact on-disk copy of what the panes showed when the application exited.
+//
+// Listing a large or network-backed home directory from scratch takes a
+// while; painting the previous listing right away and replacing it once the
+// real model has revalidated the directory makes startup feel instant.
+class ListingSnapshot {
+public:
+    static constexpr int maxEntries = 50000;
+
+    static QString defaultPath();
+    static bool save(const QString& path, const QVector<PaneSnapshot>& panes);
+    static bool load(const QString& path, QVector<PaneSnapshot>& panes);
+    static PaneSnapshot capture(QFileSystemModel* model, const QModelIndex& root, const QStringList& expanded);
+};
+
+// Read-only list model that paints a PaneSnapshot until the file system model
+// has caught up.
+class SnapshotListModel : public QAbstractListModel {
+    Q_OBJECT
+
+public:
+    explicit SnapshotListModel(const PaneSnapshot& snapshot, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+
+    const PaneSnapshot& snapshot() const;
+
+private:
+    PaneSnapshot pane;
+    QFileIconProvider iconProvider;
+};
+
+#endif // LISTINGSNAPSHOT_H
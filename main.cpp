@@ -6,6 +6,8 @@
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+    QApplication::setOrganizationName("file_manager");
+    QApplication::setApplicationName("file_manager");
     MainWidget w;
     w.show();
     return a.exec();
@@ -13,20 +13,80 @@
 #include <QVBoxLayout>
 #include <QLabel>
 #include <QComboBox>
+#include <QCheckBox>
+#include <QTimer>
+#include <QSettings>
+#include <QElapsedTimer>
+#include <QShortcut>
+#include <QScrollBar>
+#include <QLocale>
+#include <QProgressDialog>
+#include <QEventLoop>
+#include <QKeyEvent>
+#include <QThread>
+#include <QTime>
+#include <QDialogButtonBox>
+#include <QStandardPaths>
+#include <QApplication>
+
+#include <algorithm>
 
 
 #include "mainwidget.h"
 #include "ui_mainwidget.h"
+#include "copyjournal.h"
+#include "fileoperations.h"
+#include "dirwatcher.h"
+#include "listingsnapshot.h"
+#include "fileviewer.h"
+#include "movejob.h"
+#include "copyplan.h"
+#include "panefilter.h"
+#include "pathindex.h"
+#include "pathpalette.h"
+#include "flatlist.h"
+#include "dirprefetcher.h"
+#include "renamedialog.h"
+#include "dedupejob.h"
+#include "jobpanel.h"
+#include "throttle.h"
+#include "splitjoin.h"
+#include "archiveindex.h"
+#include "statspanel.h"
+
+
+// A list view shows either its pane's QFileSystemModel directly or, while a
+// filter is typed, a PaneFilterModel on top of it; these two helpers give
+// code that works with file system indexes the same view of both.
+static QFileSystemModel* fileModelOf(QAbstractItemView* view) {
+    QAbstractItemModel* model = view->model();
+    if (auto filterModel = qobject_cast<PaneFilterModel*>(model)) {
+        model = filterModel->sourceModel();
+    }
+    return qobject_cast<QFileSystemModel*>(model);
+}
+
+static QModelIndex toFileModelIndex(const QModelIndex& index) {
+    if (auto filterModel = qobject_cast<const PaneFilterModel*>(index.model())) {
+        return filterModel->mapToSource(index);
+    }
+    return index;
+}
 
 
 MainWidget::MainWidget(QWidget* parent)
         : QWidget(parent),
-          ui(new Ui::MainWidget) {
+          ui(new Ui::MainWidget),
+          hoveredView(nullptr),
+          firstFrameReported(false),
+          pathIndex(nullptr) {
+    startupTimer.start();
     ui->setupUi(this);
 
     setup_models();
     setup_views();
     setup_connections();
+    restoreSnapshot();
 
     contextMenu = new QMenu(this);
     newFileAction = contextMenu->addAction("New File");
@@ -35,6 +95,15 @@ MainWidget::MainWidget(QWidget* parent)
     renameAction = contextMenu->addAction("Rename");
     copyAction = contextMenu->addAction("Copy");
     sortAction = contextMenu->addAction("Sort by");
+    dedupeAction = contextMenu->addAction("Deduplicate");
+    splitAction = contextMenu->addAction("Split");
+    joinAction = contextMenu->addAction("Join");
+    contextMenu->addSeparator();
+    jobsAction = contextMenu->addAction("Jobs");
+    statsAction = contextMenu->addAction("Statistics");
+    verifyAction = contextMenu->addAction("Verify Copies");
+    verifyAction->setCheckable(true);
+    verifyAction->setChecked(FileOperations::verifiesCopies());
 
 
 
@@ -44,6 +113,15 @@ MainWidget::MainWidget(QWidget* parent)
     connect(renameAction, &QAction::triggered, this, &MainWidget::renameSelectedItem);
     connect(copyAction, &QAction::triggered, this, &MainWidget::copySelectedItems);
     connect(sortAction, &QAction::triggered, this, &MainWidget::showSortDialog);
+    connect(dedupeAction, &QAction::triggered, this, &MainWidget::deduplicateDirectory);
+    connect(jobsAction, &QAction::triggered, this, &MainWidget::showJobPanel);
+    connect(statsAction, &QAction::triggered, this, &MainWidget::showStatistics);
+    connect(splitAction, &QAction::triggered, this, &MainWidget::splitSelectedFile);
+    connect(joinAction, &QAction::triggered, this, &MainWidget::joinSelectedFile);
+    connect(verifyAction, &QAction::toggled, this, [](bool verify) {
+        FileOperations::setVerifyCopies(verify);
+        QSettings().setValue("copy/verify", verify);
+    });
 
 
     ui->dir_list_1->setDragDropMode(QAbstractItemView::InternalMove);
@@ -52,6 +130,9 @@ MainWidget::MainWidget(QWidget* parent)
     ui->dir_tree_2->setDragDropMode(QAbstractItemView::InternalMove);
 
     for (auto listView: {ui->dir_list_1, ui->dir_list_2}) {
+        // Every row has the same height, and saying so keeps relayouts of
+        // directories with a million entries (or filtering them) linear.
+        listView->setUniformItemSizes(true);
         listView->setContextMenuPolicy(Qt::CustomContextMenu);
         connect(listView, &QListView::customContextMenuRequested, this, &MainWidget::showContextMenu);
         listView->setDragEnabled(true);
@@ -72,19 +153,75 @@ MainWidget::MainWidget(QWidget* parent)
     ui->dir_list_2->installEventFilter(this);
     ui->dir_tree_1->installEventFilter(this);
     ui->dir_tree_2->installEventFilter(this);
+    ui->dir_list_1->viewport()->installEventFilter(this);
+    ui->dir_list_2->viewport()->installEventFilter(this);
+
+    auto viewShortcut = new QShortcut(QKeySequence(Qt::Key_F3), this);
+    connect(viewShortcut, &QShortcut::activated, this, &MainWidget::viewCurrentFile);
+    auto paletteShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_P), this);
+    connect(paletteShortcut, &QShortcut::activated, this, &MainWidget::openPathPalette);
+    auto backShortcut = new QShortcut(QKeySequence::Back, this);
+    connect(backShortcut, &QShortcut::activated, this, &MainWidget::goBack);
+    auto forwardShortcut = new QShortcut(QKeySequence::Forward, this);
+    connect(forwardShortcut, &QShortcut::activated, this, &MainWidget::goForward);
+    auto jobsShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_J), this);
+    connect(jobsShortcut, &QShortcut::activated, this, &MainWidget::showJobPanel);
+    auto statsShortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_I), this);
+    connect(statsShortcut, &QShortcut::activated, this, &MainWidget::showStatistics);
+
+    QTimer::singleShot(0, this, &MainWidget::resumeInterruptedJobs);
 }
 
 
 void MainWidget::setup_models() {
     model_1 = setup_file_system_model(QDir::Dirs | QDir::Files | QDir::NoDot);
     model_2 = setup_file_system_model(QDir::Dirs | QDir::Files | QDir::NoDot);
+    filterModel_1 = new PaneFilterModel(this);
+    filterModel_1->setSourceModel(model_1);
+    filterModel_2 = new PaneFilterModel(this);
+    filterModel_2->setSourceModel(model_2);
+    flatModel_1 = new FlatListModel(this);
+    flatModel_2 = new FlatListModel(this);
+
+    QSettings settings;
+    dirWatcher = new DirWatcher(this);
+    dirWatcher->setBatchInterval(settings.value("watcher/batchInterval", 250).toInt());
+    dirWatcher->setRescanInterval(settings.value("watcher/rescanInterval", 2000).toInt());
+    FileOperations::setVerifyCopies(settings.value("copy/verify", false).toBool());
+    Throttle::global().setBytesPerSecond(settings.value("throttle/bytesPerSecond", 0).toLongLong());
+    Throttle::global().setOperationsPerSecond(settings.value("throttle/operationsPerSecond", 0).toLongLong());
+    // Without a parent, so that a modal copy dialog leaves it usable.
+    jobPanel = new JobPanel;
+    statsPanel = new StatsPanel;
+    connect(dirWatcher, &DirWatcher::directoryChanged, this, &MainWidget::applyDirectoryChanges);
+    connect(dirWatcher, &DirWatcher::rescanRequired, this, &MainWidget::rescanDirectory);
+
+    prefetcher = nullptr;
+    if (settings.value("prefetch/enabled", true).toBool()) {
+        prefetcher = new DirPrefetcher(this);
+        connect(prefetcher, &DirPrefetcher::prefetched, this, &MainWidget::applyPrefetch);
+    }
+    // A pointer merely passing over a directory should not start a read.
+    hoverTimer = new QTimer(this);
+    hoverTimer->setSingleShot(true);
+    hoverTimer->setInterval(settings.value("prefetch/hoverDelay", 150).toInt());
+    connect(hoverTimer, &QTimer::timeout, this, [this]() {
+        if (hoveredView && hoveredIndex.isValid()) {
+            prefetchDirectory(hoveredView, hoveredIndex, false);
+        }
+    });
 }
 
 QFileSystemModel* MainWidget::setup_file_system_model(QDir::Filters filter) {
     auto model = new QFileSystemModel(this);
+    // Change notifications come from the coalescing DirWatcher instead of the
+    // model's own watcher, which refreshes on every single event.
+    model->setOption(QFileSystemModel::DontWatchForChanges);
     model->setFilter(filter);
     model->sort(0, Qt::AscendingOrder);
-    model->setRootPath(QDir::homePath());
+    // Not a directory the panes show: relistDirectory() moves the root path
+    // away and back, and that lists the root again each time.
+    model->setRootPath(QDir::rootPath());
     return model;
 }
 
@@ -160,12 +297,46 @@ void MainWidget::setup_connections() {
 
         connect(treeView->selectionModel(), &QItemSelectionModel::currentChanged,
                 this, &MainWidget::display_selected_path);
+        connect(treeView->selectionModel(), &QItemSelectionModel::currentChanged,
+                this, [this, treeView](const QModelIndex& current) { prefetchDirectory(treeView, current, true); });
+        connect(treeView, &QTreeView::expanded, this, [this, treeView](const QModelIndex& index) {
+            QFileSystemModel* model = qobject_cast<QFileSystemModel*>(treeView->model());
+            expandedDirectories[treeView].insert(model->filePath(index));
+            syncWatchedDirectories();
+            prefetchDirectory(treeView, index, true);
+        });
+        connect(treeView, &QTreeView::collapsed, this, [this, treeView](const QModelIndex& index) {
+            QFileSystemModel* model = qobject_cast<QFileSystemModel*>(treeView->model());
+            expandedDirectories[treeView].remove(model->filePath(index));
+            syncWatchedDirectories();
+        });
     }
 
     for (auto listView: {ui->dir_list_1, ui->dir_list_2}) {
         connect(listView->selectionModel(), &QItemSelectionModel::currentChanged,
                 this, &MainWidget::display_selected_path);
     }
+    for (QFileSystemModel* model: {model_1, model_2}) {
+        connect(model, &QFileSystemModel::directoryLoaded, this, &MainWidget::revalidateSnapshot);
+    }
+    const QList<QAbstractItemView*> hoverViews = {ui->dir_tree_1, ui->dir_tree_2, ui->dir_list_1, ui->dir_list_2};
+    for (QAbstractItemView* view: hoverViews) {
+        view->setMouseTracking(true);
+        connect(view, &QAbstractItemView::entered, this, [this, view](const QModelIndex& index) {
+            hoveredView = view;
+            hoveredIndex = index;
+            hoverTimer->start();
+        });
+    }
+    for (auto listView: {ui->dir_list_1, ui->dir_list_2}) {
+        QLineEdit* filterEdit = listView == ui->dir_list_1 ? ui->filter_1 : ui->filter_2;
+        QComboBox* filterMode = listView == ui->dir_list_1 ? ui->filter_mode_1 : ui->filter_mode_2;
+        connect(filterEdit, &QLineEdit::textChanged, this, [this, listView]() { applyFilter(listView); });
+        connect(filterMode, &QComboBox::currentIndexChanged, this, [this, listView]() { applyFilter(listView); });
+
+        QCheckBox* flatBox = listView == ui->dir_list_1 ? ui->flat_1 : ui->flat_2;
+        connect(flatBox, &QCheckBox::toggled, this, [this, listView](bool flat) { setFlatView(listView, flat); });
+    }
     connect(ui->compressButton, &QPushButton::clicked, this, &MainWidget::compressSelectedItems);
     connect(ui->new_file, &QPushButton::clicked, this, &MainWidget::createNewFile);
     connect(ui->new_dir, &QPushButton::clicked, this, &MainWidget::createNewDirectory);
@@ -177,44 +348,592 @@ void MainWidget::setup_connections() {
     ui->dir_list_1->setSelectionMode(QAbstractItemView::ExtendedSelection);
     ui->dir_list_2->setSelectionMode(QAbstractItemView::ExtendedSelection);
 
+    syncWatchedDirectories();
 }
 
 
+// Archive members opened from a search are unpacked here, and removed
+// when the window closes.
+static QString archiveMemberDirectory() {
+    return QStandardPaths::writableLocation(QStandardPaths::TempLocation)
+           + QString("/file_manager-archive-%1/").arg(QCoreApplication::applicationPid());
+}
+
 MainWidget::~MainWidget() {
+    saveSnapshot();
+    QDir(archiveMemberDirectory()).removeRecursively();
+    delete jobPanel;
+    delete statsPanel;
     delete ui;
 }
 
 
+void MainWidget::restoreSnapshot() {
+    QVector<PaneSnapshot> panes;
+    if (!ListingSnapshot::load(ListingSnapshot::defaultPath(), panes) || panes.size() != 2) {
+        return;
+    }
+
+    for (int pane = 0; pane < 2; ++pane) {
+        const PaneSnapshot& snapshot = panes.at(pane);
+        QListView* listView = pane == 0 ? ui->dir_list_1 : ui->dir_list_2;
+        QTreeView* treeView = pane == 0 ? ui->dir_tree_1 : ui->dir_tree_2;
+        QLineEdit* pathEdit = pane == 0 ? ui->path_1 : ui->path_2;
+        QFileSystemModel* model = pane == 0 ? model_1 : model_2;
+
+        if (!QFileInfo(snapshot.listRoot).isDir()) {
+            continue;
+        }
+        pathEdit->setText(snapshot.listRoot);
+
+        // Paint the old listing now; revalidateSnapshot() swaps the real
+        // model back in once it has listed the directory in the background.
+        if (!snapshot.entries.isEmpty()) {
+            listView->setModel(new SnapshotListModel(snapshot, listView));
+            pendingRevalidation.insert(model, QDir::cleanPath(snapshot.listRoot));
+            model->fetchMore(model->index(snapshot.listRoot));
+        } else {
+            setListRoot(listView, model->index(snapshot.listRoot));
+        }
+
+        QStringList expanded = snapshot.expanded;
+        std::sort(expanded.begin(), expanded.end());
+        for (const QString& path: expanded) {
+            if (QFileInfo(path).isDir()) {
+                treeView->expand(model->index(path));
+            }
+        }
+    }
+    syncWatchedDirectories();
+
+    // Revalidation normally finishes long before this; it only matters when
+    // the model never reports the directory as loaded.
+    QTimer::singleShot(10000, this, [this]() {
+        for (QFileSystemModel* model: pendingRevalidation.keys()) {
+            attachListModel(model, pendingRevalidation.take(model));
+        }
+    });
+}
+
+void MainWidget::saveSnapshot() {
+    QVector<PaneSnapshot> panes;
+    for (int pane = 0; pane < 2; ++pane) {
+        QListView* listView = pane == 0 ? ui->dir_list_1 : ui->dir_list_2;
+        QTreeView* treeView = pane == 0 ? ui->dir_tree_1 : ui->dir_tree_2;
+        QFileSystemModel* model = pane == 0 ? model_1 : model_2;
+        const QSet<QString> expanded = expandedDirectories.value(treeView);
+
+        if (auto snapshotModel = qobject_cast<SnapshotListModel*>(listView->model())) {
+            panes.append(snapshotModel->snapshot());
+        } else {
+            panes.append(ListingSnapshot::capture(model, model->index(listRootPath(listView)),
+                                                  QStringList(expanded.begin(), expanded.end())));
+        }
+    }
+    ListingSnapshot::save(ListingSnapshot::defaultPath(), panes);
+}
+
+void MainWidget::revalidateSnapshot(const QString& path) {
+    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(sender());
+    if (!model || pendingRevalidation.value(model) != QDir::cleanPath(path)) {
+        return;
+    }
+    attachListModel(model, pendingRevalidation.take(model));
+}
+
+void MainWidget::attachListModel(QFileSystemModel* model, const QString& rootPath) {
+    QListView* listView = model == model_1 ? ui->dir_list_1 : ui->dir_list_2;
+    QAbstractItemModel* previousModel = listView->model();
+    if (previousModel == model) {
+        return;
+    }
+
+    showListModel(listView, model, model->index(rootPath));
+    syncWatchedDirectories();
+
+    if (previousModel && previousModel->parent() == listView) {
+        previousModel->deleteLater();
+    }
+
+    // A filter typed while the snapshot was shown applies from now on.
+    applyFilter(listView);
+
+    if (pendingViewState.contains(listView)) {
+        restoreViewState(listView, pendingViewState.take(listView));
+    }
+}
+
+void MainWidget::showListModel(QAbstractItemView* listView, QAbstractItemModel* model, const QModelIndex& root) {
+    // setModel() replaces the selection model, so its signals need rewiring.
+    QItemSelectionModel* previousSelection = listView->selectionModel();
+    listView->setModel(model);
+    delete previousSelection;
+    connect(listView->selectionModel(), &QItemSelectionModel::currentChanged,
+            this, &MainWidget::display_selected_path);
+    listView->setRootIndex(root);
+}
+
+void MainWidget::applyFilter(QAbstractItemView* listView) {
+    const bool firstPane = listView == ui->dir_list_1;
+    QFileSystemModel* model = firstPane ? model_1 : model_2;
+    PaneFilterModel* filterModel = firstPane ? filterModel_1 : filterModel_2;
+    const QString pattern = (firstPane ? ui->filter_1 : ui->filter_2)->text();
+    const auto mode = PaneFilterModel::Mode((firstPane ? ui->filter_mode_1 : ui->filter_mode_2)->currentIndex());
+
+    // The snapshot listing is only a picture; filtering waits for the model.
+    if (pendingRevalidation.contains(model)) {
+        return;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (pattern.isEmpty()) {
+        if (listView->model() == filterModel) {
+            showListModel(listView, model, filterModel->sourceRoot());
+            filterModel->setSourceRoot(QModelIndex());
+        }
+        return;
+    }
+
+    filterModel->setFilter(pattern, mode);
+    if (listView->model() != filterModel) {
+        filterModel->setSourceRoot(listView->rootIndex());
+        showListModel(listView, filterModel, filterModel->rootIndex());
+    }
+
+    if (timer.elapsed() > 16) {
+        qInfo() << "Filtering" << listRootPath(listView) << "for" << pattern << "took" << timer.elapsed() << "ms";
+    }
+}
+
+void MainWidget::setFlatView(QAbstractItemView* listView, bool flat) {
+    const bool firstPane = listView == ui->dir_list_1;
+    QFileSystemModel* model = firstPane ? model_1 : model_2;
+    FlatListModel* flatModel = firstPane ? flatModel_1 : flatModel_2;
+    QLineEdit* filterEdit = firstPane ? ui->filter_1 : ui->filter_2;
+    QComboBox* filterMode = firstPane ? ui->filter_mode_1 : ui->filter_mode_2;
+
+    if ((listView->model() == flatModel) == flat) {
+        return;
+    }
+    if (pendingRevalidation.contains(model)) {
+        attachListModel(model, pendingRevalidation.take(model));
+    }
+
+    if (flat) {
+        // The filter narrows a single directory's listing, so it is put
+        // away while the whole tree is listed.
+        filterEdit->clear();
+        flatModel->setRootPath(listRootPath(listView));
+        showListModel(listView, flatModel, QModelIndex());
+    } else {
+        showListModel(listView, model, model->index(flatModel->rootPath()));
+        flatModel->setRootPath(QString());
+    }
+    filterEdit->setEnabled(!flat);
+    filterMode->setEnabled(!flat);
+}
+
+void MainWidget::reportFirstFrame(QAbstractItemView* view) {
+    if (firstFrameReported || !view->model() || view->model()->rowCount(view->rootIndex()) == 0) {
+        return;
+    }
+    firstFrameReported = true;
+
+    const bool fromSnapshot = qobject_cast<SnapshotListModel*>(view->model()) != nullptr;
+    qInfo().noquote() << QString("First useful frame after %1 ms (%2)")
+                                 .arg(startupTimer.elapsed())
+                                 .arg(fromSnapshot ? "listing snapshot" : "live listing");
+
+    ui->dir_list_1->viewport()->removeEventFilter(this);
+    ui->dir_list_2->viewport()->removeEventFilter(this);
+}
+
+
 void MainWidget::on_fileList_doubleClicked(const QModelIndex& index) {
     QListView* listView = qobject_cast<QListView*>(sender());
     if (!listView) return;
 
-    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(listView->model());
+    if (auto flatModel = qobject_cast<FlatListModel*>(listView->model())) {
+        openFile(flatModel->filePath(index));
+        return;
+    }
+
+    QFileSystemModel* model = fileModelOf(listView);
     if (!model) return;
 
-    QFileInfo fileInfo = model->fileInfo(index);
+    const QModelIndex sourceIndex = toFileModelIndex(index);
+    QFileInfo fileInfo = model->fileInfo(sourceIndex);
     if (fileInfo.fileName() == "..") {
         QDir dir = fileInfo.dir();
         dir.cdUp();
-        listView->setRootIndex(model->index(dir.absolutePath()));
+        setListRoot(listView, model->index(dir.absolutePath()));
     } else if (fileInfo.isDir()) {
-        listView->setRootIndex(index);
+        setListRoot(listView, sourceIndex);
     } else if (fileInfo.isFile()) {
-        QDesktopServices::openUrl(QUrl::fromLocalFile(fileInfo.absoluteFilePath()));
+        openFile(fileInfo.absoluteFilePath());
     }
 }
 
+void MainWidget::openFile(const QString& path) {
+    if (FileViewer::prefersBuiltInViewer(path)) {
+        (new FileViewer(path, this))->show();
+    } else {
+        QDesktopServices::openUrl(QUrl::fromLocalFile(path));
+    }
+}
+
+void MainWidget::viewCurrentFile() {
+    QAbstractItemView* view = ui->dir_list_2->hasFocus() ? ui->dir_list_2 : ui->dir_list_1;
+    QString path = view->currentIndex().data(QFileSystemModel::FilePathRole).toString();
+    if (!path.isEmpty() && QFileInfo(path).isFile()) {
+        (new FileViewer(path, this))->show();
+    }
+}
+
+void MainWidget::openPathPalette() {
+    QAbstractItemView* listView = ui->dir_list_2->hasFocus() ? ui->dir_list_2 : ui->dir_list_1;
+    QFileSystemModel* model = listView == ui->dir_list_2 ? model_2 : model_1;
+    const QString rootPath = listRootPath(listView);
+
+    // The index is kept for the next palette on the same root, and built
+    // again in the background once it is a minute old.
+    if (!pathIndex) {
+        pathIndex = new PathIndex(this);
+    }
+    if (pathIndex->rootPath() != rootPath || (!pathIndex->isBuilding() && pathIndexAge.elapsed() > 60000)) {
+        pathIndex->start(rootPath);
+        pathIndexAge.start();
+    }
+
+    PathPalette palette(pathIndex, this);
+    if (palette.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    // Like a search result: a directory is opened, a file is shown in its
+    // directory.
+    const QString path = palette.chosenPath();
+    QFileInfo info(path);
+    if (!info.exists()) {
+        QMessageBox::information(this, tr("Go to File"), tr("'%1' no longer exists.").arg(path));
+        return;
+    }
+    setListRoot(listView, model->index(info.isDir() ? path : info.absolutePath()));
+    if (!info.isDir()) {
+        listView->setCurrentIndex(model->index(path));
+    }
+    listView->setFocus();
+}
+
 void MainWidget::on_fileTree_1_doubleClicked(const QModelIndex& index) {
     QFileInfo fileInfo = model_1->fileInfo(index);
     if (fileInfo.isDir()) {
-        ui->dir_list_1->setRootIndex(model_1->index(fileInfo.absoluteFilePath()));
+        setListRoot(ui->dir_list_1, model_1->index(fileInfo.absoluteFilePath()));
     }
 }
 
 void MainWidget::on_fileTree_2_doubleClicked(const QModelIndex& index) {
     QFileInfo fileInfo = model_2->fileInfo(index);
     if (fileInfo.isDir()) {
-        ui->dir_list_2->setRootIndex(model_2->index(fileInfo.absoluteFilePath()));
+        setListRoot(ui->dir_list_2, model_2->index(fileInfo.absoluteFilePath()));
+    }
+}
+
+QString MainWidget::listRootPath(QAbstractItemView* listView) {
+    QFileSystemModel* model = listView == ui->dir_list_2 ? model_2 : model_1;
+    if (pendingRevalidation.contains(model)) {
+        return pendingRevalidation.value(model);
+    }
+    if (auto flatModel = qobject_cast<FlatListModel*>(listView->model())) {
+        return flatModel->rootPath();
+    }
+    return model->filePath(toFileModelIndex(listView->rootIndex()));
+}
+
+void MainWidget::setListRoot(QAbstractItemView* view, const QModelIndex& index) {
+    QFileSystemModel* model = view == ui->dir_list_2 ? model_2 : model_1;
+    // A remembered listing still on show gives way to the live one first.
+    if (pendingRevalidation.contains(model)) {
+        attachListModel(model, pendingRevalidation.take(model));
+    }
+    if (model->filePath(index) != listRootPath(view)) {
+        rememberListing(view);
+        historyOf(view).visit(currentHistoryEntry(view));
+    }
+
+    showPlainListing(view);
+    view->setRootIndex(index);
+    syncWatchedDirectories();
+    prefetchDirectory(view, index, true);
+}
+
+void MainWidget::showPlainListing(QAbstractItemView* view) {
+    // Another directory starts unfiltered; clearing the filter puts the
+    // file system model back into the view.
+    if (qobject_cast<PaneFilterModel*>(view->model())) {
+        (view == ui->dir_list_1 ? ui->filter_1 : ui->filter_2)->clear();
+    }
+    // Likewise, going somewhere else leaves the flat list.
+    if (qobject_cast<FlatListModel*>(view->model())) {
+        (view == ui->dir_list_1 ? ui->flat_1 : ui->flat_2)->setChecked(false);
+    }
+}
+
+PaneHistory& MainWidget::historyOf(QAbstractItemView* listView) {
+    return listView == ui->dir_list_2 ? history_2 : history_1;
+}
+
+HistoryEntry MainWidget::currentHistoryEntry(QAbstractItemView* listView) {
+    HistoryEntry entry;
+    entry.path = listRootPath(listView);
+    entry.scrollPosition = listView->verticalScrollBar()->value();
+    entry.currentName = QFileInfo(listView->currentIndex().data(QFileSystemModel::FilePathRole).toString()).fileName();
+    return entry;
+}
+
+void MainWidget::rememberListing(QAbstractItemView* listView) {
+    // Only a live listing is worth keeping: one still being revalidated is
+    // a snapshot already, and a flat list is not a directory's listing.
+    QFileSystemModel* model = fileModelOf(listView);
+    const QString path = listRootPath(listView);
+    if (!model || pendingRevalidation.contains(model) || path.isEmpty()) {
+        return;
+    }
+    historyOf(listView).storeSnapshot(ListingSnapshot::capture(model, model->index(path), QStringList()));
+}
+
+void MainWidget::restoreViewState(QAbstractItemView* listView, const HistoryEntry& entry) {
+    // The scroll bar only has its range once the rows are laid out.
+    listView->doItemsLayout();
+
+    if (!entry.currentName.isEmpty()) {
+        QAbstractItemModel* model = listView->model();
+        QModelIndex current;
+        if (auto fileModel = qobject_cast<QFileSystemModel*>(model)) {
+            current = fileModel->index(QDir(entry.path).filePath(entry.currentName));
+        } else {
+            const QModelIndexList found = model->match(model->index(0, 0, listView->rootIndex()), Qt::DisplayRole,
+                                                       entry.currentName, 1, Qt::MatchExactly);
+            if (!found.isEmpty()) {
+                current = found.first();
+            }
+        }
+        if (current.isValid()) {
+            listView->selectionModel()->setCurrentIndex(current, QItemSelectionModel::NoUpdate);
+        }
+    }
+    listView->verticalScrollBar()->setValue(entry.scrollPosition);
+}
+
+void MainWidget::goBack() {
+    navigateHistory(false);
+}
+
+void MainWidget::goForward() {
+    navigateHistory(true);
+}
+
+void MainWidget::navigateHistory(bool forward) {
+    QAbstractItemView* listView = ui->dir_list_2->hasFocus() ? ui->dir_list_2 : ui->dir_list_1;
+    QFileSystemModel* model = listView == ui->dir_list_2 ? model_2 : model_1;
+    PaneHistory& history = historyOf(listView);
+    if (forward ? !history.canGoForward() : !history.canGoBack()) {
+        return;
+    }
+
+    if (pendingRevalidation.contains(model)) {
+        attachListModel(model, pendingRevalidation.take(model));
+    }
+    rememberListing(listView);
+    const HistoryEntry current = currentHistoryEntry(listView);
+    const HistoryEntry target = forward ? history.goForward(current) : history.goBack(current);
+    if (!QFileInfo(target.path).isDir()) {
+        QMessageBox::information(this, tr("History"), tr("'%1' no longer exists.").arg(target.path));
+        return;
+    }
+
+    showPlainListing(listView);
+    const QModelIndex index = model->index(target.path);
+    const PaneSnapshot* snapshot = history.snapshot(target.path);
+    if (snapshot && model->canFetchMore(index)) {
+        // The model has to read the directory again. Until it has, the
+        // listing as it was left is shown, and revalidateSnapshot() swaps
+        // the live one in.
+        showListModel(listView, new SnapshotListModel(*snapshot, listView), QModelIndex());
+        restoreViewState(listView, target);
+        pendingRevalidation.insert(model, target.path);
+        pendingViewState.insert(listView, target);
+        model->fetchMore(index);
+        QTimer::singleShot(10000, this, [this, model, path = target.path]() {
+            if (pendingRevalidation.value(model) == path) {
+                attachListModel(model, pendingRevalidation.take(model));
+            }
+        });
+    } else {
+        // The model still holds the directory from the last visit, which
+        // paints at once; it is read again in the background in case it
+        // changed while nobody was watching it.
+        listView->setRootIndex(index);
+        restoreViewState(listView, target);
+        relistDirectory(model, target.path);
+    }
+    syncWatchedDirectories();
+}
+
+void MainWidget::prefetchDirectory(QAbstractItemView* view, const QModelIndex& index, bool withNeighbours) {
+    QFileSystemModel* model = fileModelOf(view);
+    if (!prefetcher || !model || !index.isValid()) {
+        return;
+    }
+    const QModelIndex sourceIndex = toFileModelIndex(index);
+    if (!model->isDir(sourceIndex)) {
+        return;
+    }
+
+    const QString path = QDir::cleanPath(model->filePath(sourceIndex));
+    // Requests the prefetcher dropped never come back; forget them
+    // eventually.
+    if (prefetchTargets.size() > DirPrefetcher::maxTargets * 4) {
+        prefetchTargets.clear();
+    }
+    prefetchTargets.insert(path, model);
+    prefetcher->prefetch(path, withNeighbours);
+}
+
+void MainWidget::applyPrefetch(const QString& directory) {
+    // With the directory's inodes in memory, having the model list it now
+    // costs next to nothing and makes opening it instant.
+    QFileSystemModel* model = prefetchTargets.take(directory);
+    if (!model) {
+        return;
+    }
+    const QModelIndex index = model->index(directory);
+    if (index.isValid() && model->canFetchMore(index)) {
+        model->fetchMore(index);
+    }
+}
+
+void MainWidget::syncWatchedDirectories() {
+    QSet<QString> wanted;
+    for (QFileSystemModel* model: {model_1, model_2}) {
+        QAbstractItemView* listView = model == model_1 ? ui->dir_list_1 : ui->dir_list_2;
+        QTreeView* treeView = model == model_1 ? ui->dir_tree_1 : ui->dir_tree_2;
+
+        wanted.insert(listRootPath(listView));
+        wanted.insert(model->filePath(treeView->rootIndex()));
+        wanted.unite(expandedDirectories.value(treeView));
+    }
+    wanted.remove(QString());
+
+    const QStringList current = dirWatcher->directories();
+    for (const QString& path: current) {
+        if (!wanted.contains(path)) {
+            dirWatcher->removePath(path);
+        }
+    }
+    for (const QString& path: wanted) {
+        dirWatcher->addPath(path);
+    }
+}
+
+bool MainWidget::isDirectoryShown(QFileSystemModel* model, const QString& path) {
+    QAbstractItemView* listView = model == model_1 ? ui->dir_list_1 : ui->dir_list_2;
+    QTreeView* treeView = model == model_1 ? ui->dir_tree_1 : ui->dir_tree_2;
+
+    if (listRootPath(listView) == path || model->filePath(treeView->rootIndex()) == path) {
+        return true;
+    }
+    return expandedDirectories.value(treeView).contains(path);
+}
+
+void MainWidget::relistDirectory(QFileSystemModel* model, const QString& path) {
+    // QFileSystemModel only lists a directory again once its children are
+    // marked unpopulated, and the public way to get that mark is moving the
+    // model's root path off the directory. Putting the root path back marks
+    // and lists the root again too, which is why the models are rooted at
+    // the file system root, a short listing that no pane depends on. The
+    // gatherer diffs the new listing against the existing nodes, so views
+    // get row-level updates.
+    const QString rootPath = model->rootPath();
+    model->setRootPath(path == rootPath ? QString() : path);
+    model->setRootPath(rootPath);
+    model->fetchMore(model->index(path));
+}
+
+void MainWidget::forgetDirectories(const QString& directory, const QStringList& names) {
+    bool changed = false;
+    for (auto it = expandedDirectories.begin(); it != expandedDirectories.end(); ++it) {
+        for (const QString& name: names) {
+            const QString path = QDir::cleanPath(directory + "/" + name);
+            for (auto expanded = it->begin(); expanded != it->end();) {
+                if (*expanded == path || expanded->startsWith(path + "/")) {
+                    expanded = it->erase(expanded);
+                    changed = true;
+                } else {
+                    ++expanded;
+                }
+            }
+        }
+    }
+    if (changed) {
+        syncWatchedDirectories();
+    }
+}
+
+void MainWidget::applyDirectoryChanges(const QString& directory, const QStringList& created,
+                                       const QStringList& modified, const QStringList& removed) {
+    // A removed directory takes its expanded subdirectories with it, and
+    // none of them is watched any longer.
+    forgetDirectories(directory, removed);
+
+    for (QFileSystemModel* model: {model_1, model_2}) {
+        // A directory the model has not read yet is listed as it is once
+        // it is opened.
+        if (!isDirectoryShown(model, directory) || model->canFetchMore(model->index(directory))) {
+            continue;
+        }
+        // index() shows whatever it is asked for, so the model's filter is
+        // applied here.
+        const bool showHidden = model->filter().testFlag(QDir::Hidden);
+
+        // The model cannot refresh a single row from outside, and listing
+        // the directory for every write would list one with a growing log
+        // in it again on every batch. Modified entries keep their rows, and
+        // their size and date catch up with the next listing; only one that
+        // was replaced by an entry of another kind needs that listing now.
+        bool relist = !removed.isEmpty();
+        for (int i = 0; !relist && i < modified.size(); ++i) {
+            const QFileInfo fileInfo(directory + "/" + modified.at(i));
+            if (fileInfo.isHidden() && !showHidden) {
+                continue;
+            }
+            const QModelIndex index = model->index(fileInfo.filePath());
+            relist = index.isValid() && model->isDir(index) != (fileInfo.isDir() && !fileInfo.isSymLink());
+        }
+
+        if (relist) {
+            // Nor can it drop a single row; one listing, diffed against the
+            // rows it has, covers the whole batch.
+            relistDirectory(model, directory);
+            continue;
+        }
+        // Looking a new entry up adds its row and reads only that entry.
+        for (const QString& name: created) {
+            const QFileInfo fileInfo(directory + "/" + name);
+            if (!fileInfo.isHidden() || showHidden) {
+                model->index(fileInfo.filePath());
+            }
+        }
+    }
+}
+
+void MainWidget::rescanDirectory(const QString& directory) {
+    for (QFileSystemModel* model: {model_1, model_2}) {
+        if (isDirectoryShown(model, directory)) {
+            relistDirectory(model, directory);
+        }
     }
 }
 
@@ -231,19 +950,23 @@ void MainWidget::display_selected_path(const QModelIndex& index) {
 
     if (!itemView) return;
 
-    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(itemView->model());
-    if (!model) return;
-
-    QFileInfo fileInfo = model->fileInfo(index);
+    QString path;
+    if (QFileSystemModel* model = fileModelOf(itemView)) {
+        path = model->fileInfo(toFileModelIndex(index)).absoluteFilePath();
+    } else if (auto flatModel = qobject_cast<FlatListModel*>(itemView->model())) {
+        path = flatModel->filePath(index);
+    } else {
+        return;
+    }
 
     if (itemView == ui->dir_tree_1) {
-        ui->path_1->setText(fileInfo.absoluteFilePath());
+        ui->path_1->setText(path);
     } else if (itemView == ui->dir_tree_2) {
-        ui->path_2->setText(fileInfo.absoluteFilePath());
+        ui->path_2->setText(path);
     } else if (itemView == ui->dir_list_1) {
-        ui->path_1->setText(fileInfo.absoluteFilePath());
+        ui->path_1->setText(path);
     } else if (itemView == ui->dir_list_2) {
-        ui->path_2->setText(fileInfo.absoluteFilePath());
+        ui->path_2->setText(path);
     }
 }
 
@@ -335,20 +1058,24 @@ void MainWidget::showSortDialog() {
             model_2->sort(dateColumn, Qt::AscendingOrder);
             break;
         }
+
+        // Flat lists sort in the background, biggest or newest first; by
+        // name they keep the order the walk found the files in.
+        const FlatListModel::SortKey flatKey = sortOption == SortDialog::SortBySize ? FlatListModel::BySize
+                                             : sortOption == SortDialog::SortByDate ? FlatListModel::ByModified
+                                             : FlatListModel::DiscoveryOrder;
+        for (FlatListModel* flatModel: {flatModel_1, flatModel_2}) {
+            flatModel->sortBy(flatKey);
+        }
     }
 }
 
 QStringList MainWidget::getFilesRecursively(QString &directoryPath) {
-    QStringList filesList;
-    QDirIterator it(directoryPath, QDir::Files, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        filesList << it.next();
-    }
-    return filesList;
+    return FileOperations::filesRecursively(directoryPath);
 }
 
 void MainWidget::compareDirectories() {
-    QString currentDirPath = model_1->filePath(ui->dir_list_1->rootIndex());
+    QString currentDirPath = listRootPath(ui->dir_list_1);
     bool ok;
     QString dirPath1 = QInputDialog::getText(this, tr("Enter Source Directory Path"), tr("Source Path:"), QLineEdit::Normal, currentDirPath, &ok);
 
@@ -408,23 +1135,49 @@ void MainWidget::compareDirectories() {
 
 
 void MainWidget::search_files() {
-    bool ok;
-    QString searchTerm = QInputDialog::getText(this, tr("Search"),
-                                               tr("Search for:"), QLineEdit::Normal,
-                                               "", &ok);
-    if (ok && !searchTerm.isEmpty()) {
-        QString currentDirPath = model_1->filePath(ui->dir_list_1->rootIndex());
-
+    QSettings settings;
+    QDialog prompt(this);
+    prompt.setWindowTitle(tr("Search"));
+    QVBoxLayout* promptLayout = new QVBoxLayout(&prompt);
+    promptLayout->addWidget(new QLabel(tr("Search for:"), &prompt));
+    QLineEdit* termEdit = new QLineEdit(&prompt);
+    promptLayout->addWidget(termEdit);
+    QCheckBox* archivesBox = new QCheckBox(tr("Search inside archives"), &prompt);
+    archivesBox->setChecked(settings.value("search/insideArchives", false).toBool());
+    promptLayout->addWidget(archivesBox);
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &prompt);
+    connect(buttons, &QDialogButtonBox::accepted, &prompt, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &prompt, &QDialog::reject);
+    promptLayout->addWidget(buttons);
+
+    QString searchTerm;
+    if (prompt.exec() == QDialog::Accepted) {
+        searchTerm = termEdit->text();
+        settings.setValue("search/insideArchives", archivesBox->isChecked());
+    }
+    if (!searchTerm.isEmpty()) {
+        const bool insideArchives = archivesBox->isChecked();
+        QString currentDirPath = listRootPath(ui->dir_list_1);
+
+        QApplication::setOverrideCursor(Qt::WaitCursor);
         QDirIterator it(currentDirPath, QDir::AllEntries, QDirIterator::Subdirectories);
 
         QStringList results;
+        QStringList archives;
         while (it.hasNext()) {
             it.next();
             QString currentFilePath = it.filePath();
             if (it.fileName().contains(searchTerm, Qt::CaseInsensitive)) {
                 results << currentFilePath;
             }
+            if (insideArchives && ArchiveIndex::isArchive(currentFilePath) && it.fileInfo().isFile()) {
+                archives << currentFilePath;
+            }
         }
+        // Only the member indexes are read here; a member is unpacked when
+        // it is opened.
+        results << ArchiveIndex::findMembers(archives, searchTerm);
+        QApplication::restoreOverrideCursor();
 
         if (!results.isEmpty()) {
             QDialog dialog(this);
@@ -438,11 +1191,19 @@ void MainWidget::search_files() {
 
             connect(listWidget, &QListWidget::itemDoubleClicked, [this](QListWidgetItem* item) {
                 QString path = item->text();
+                QString archivePath;
+                QString member;
+                if (ArchiveIndex::splitMemberPath(path, archivePath, member)) {
+                    if (openArchiveMember(archivePath, member)) {
+                        return;
+                    }
+                    path = archivePath;
+                }
                 QFileInfo info(path);
                 if (info.isFile()) {
                     path = info.absolutePath();
                 }
-                ui->dir_list_1->setRootIndex(model_1->index(path));
+                setListRoot(ui->dir_list_1, model_1->index(path));
             });
 
             dialog.exec();
@@ -452,10 +1213,27 @@ void MainWidget::search_files() {
     }
 }
 
+// Unpacks one member of an archive into a temporary directory and opens
+// it from there.
+bool MainWidget::openArchiveMember(const QString& archivePath, const QString& member) {
+    const QString directory = archiveMemberDirectory();
+    const QString destination = directory + QFileInfo(member).fileName();
+    if (!QDir().mkpath(directory)) {
+        return false;
+    }
 
-bool MainWidget::copy_file(const QString& sourcePath, const QString& destinationPath) {
-    QFile sourceFile(sourcePath);
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const bool extracted = ArchiveIndex::extractMember(archivePath, member, destination);
+    QApplication::restoreOverrideCursor();
+    if (!extracted || !QFileInfo(destination).isFile()) {
+        return false;
+    }
+    openFile(destination);
+    return true;
+}
 
+
+bool MainWidget::copy_file(const QString& sourcePath, const QString& destinationPath) {
     if (QFileInfo(sourcePath).absoluteFilePath() == QFileInfo(destinationPath).absoluteFilePath()) {
         QString baseName = QFileInfo(sourcePath).completeBaseName();
         QString extension = QFileInfo(sourcePath).suffix();
@@ -489,69 +1267,178 @@ bool MainWidget::copy_file(const QString& sourcePath, const QString& destination
         }
     }
 
-    if (!sourceFile.open(QIODevice::ReadOnly)) {
-        qWarning() << "Could not open source file:" << sourcePath;
-        return false;
-    }
-
-    QFile destinationFile(destinationPath);
-    if (!destinationFile.open(QIODevice::WriteOnly)) {
-        qWarning() << "Could not open destination file:" << destinationPath;
-        return false;
-    }
-
-    QByteArray fileData = sourceFile.readAll();
-    destinationFile.write(fileData);
-
-    sourceFile.close();
-    destinationFile.close();
-
-    return true;
+    return runTransfer(tr("Copy"), {sourcePath}, QFileInfo(destinationPath).absolutePath(), false,
+                       [sourcePath, destinationPath]() {
+                           return FileOperations::copyFile(sourcePath, destinationPath);
+                       });
 }
 
 
 bool MainWidget::copy_directory(const QString& sourcePath, const QString& destinationPath) {
-    QDir sourceDir(sourcePath);
-    if (!sourceDir.exists()) {
-        qWarning() << "Source directory does not exist:" << sourcePath;
-        return false;
-    }
+    return runTransfer(tr("Copy"), {sourcePath}, destinationPath, false, [sourcePath, destinationPath]() {
+        return FileOperations::copyDirectory(sourcePath, destinationPath);
+    });
+}
 
-    QString finalDestinationPath = destinationPath;
 
-    QDir destDir(finalDestinationPath);
-    if (!destDir.exists()) {
-        destDir.mkpath(finalDestinationPath);
+// Swallows Escape and close requests, for a dialog that must stay up.
+class KeepOpenFilter : public QObject {
+public:
+    using QObject::QObject;
+
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override {
+        if (event->type() == QEvent::Close) {
+            event->ignore();
+            return true;
+        }
+        if (event->type() == QEvent::KeyPress && static_cast<QKeyEvent*>(event)->key() == Qt::Key_Escape) {
+            return true;
+        }
+        return QObject::eventFilter(watched, event);
     }
+};
+
+// Runs work on a thread of its own and waits for it with the event loop
+// running. User input is held back at first; if the work takes longer, the
+// modal dialog is shown and input flows again, so that windows outside it,
+// like the job panel, can be used.
+//
+// The work uses the caller's stack, so the dialog cannot be dismissed
+// until it is done: hiding it would end the modality and let the user
+// start another operation, or close the window, under it.
+static void runInBackground(const std::function<void()>& work, QWidget* dialog) {
+    KeepOpenFilter keepOpen;
+    dialog->installEventFilter(&keepOpen);
+    dialog->setWindowFlags(dialog->windowFlags() | Qt::CustomizeWindowHint | Qt::WindowTitleHint);
+    dialog->setWindowFlag(Qt::WindowCloseButtonHint, false);
+
+    QThread* thread = QThread::create(work);
+    QEventLoop loop;
+    bool done = false;
+    QObject::connect(thread, &QThread::finished, &loop, [&loop, &done]() {
+        done = true;
+        loop.quit();
+    });
+    thread->start();
+
+    QTimer::singleShot(500, &loop, &QEventLoop::quit);
+    loop.exec(QEventLoop::ExcludeUserInputEvents);
+    if (!done) {
+        dialog->show();
+        loop.exec();
+    }
+    thread->wait();
+    delete thread;
+}
 
-    QFileInfoList fileInfoList = sourceDir.entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot);
+// Called from a timer running at the display rate at most; the workers
+// never wait for it.
+static void showTransferProgress(QProgressDialog* dialog, const TransferProgress& progress) {
+    const qint64 total = progress.total();
+    const qint64 done = qMin(progress.done(), total);
+    dialog->setValue(total > 0 ? int(done * 1000 / total) : 0);
+
+    QString text = QObject::tr("%1 of %2").arg(QLocale().formattedDataSize(done), QLocale().formattedDataSize(total));
+    const qint64 seconds = progress.remainingSeconds();
+    if (seconds >= 0) {
+        const QTime left = QTime(0, 0).addSecs(int(qMin<qint64>(seconds, 86399)));
+        text += " - " + QObject::tr("about %1 left").arg(left.toString(seconds >= 3600 ? "h:mm:ss" : "m:ss"));
+    }
+    const qint64 totalFiles = progress.totalFiles();
+    if (totalFiles > 0) {
+        text += "\n" + QObject::tr("%1 of %2 files").arg(QLocale().toString(qMin(progress.doneFiles(), totalFiles)),
+                                                         QLocale().toString(totalFiles));
+    }
+    // The name stays until a newer one comes in.
+    const QString latest = progress.takeLatestFile();
+    if (!latest.isEmpty()) {
+        dialog->setProperty("latestFile", QFileInfo(latest).fileName());
+    }
+    const QString name = dialog->property("latestFile").toString();
+    if (!name.isEmpty()) {
+        text += "\n" + dialog->fontMetrics().elidedText(name, Qt::ElideMiddle, 360);
+    }
+    dialog->setLabelText(text);
+}
 
-    QString newFolderName = sourceDir.dirName();
-    QString newFolderPath = QDir(finalDestinationPath).absoluteFilePath(newFolderName);
-    int copyNumber = 1;
-    while (QDir(newFolderPath).exists()) {
-        newFolderName = sourceDir.dirName() + "(" + QString::number(copyNumber++) + ")";
-        newFolderPath = QDir(finalDestinationPath).absoluteFilePath(newFolderName);
+// Totals what the sources hold and compares it with the free space in the
+// destination directory before anything is written. Items that a move only
+// renames take no space and are left out. Returns false if the user calls
+// it off.
+bool MainWidget::preflight(const QString& title, const QStringList& sources, const QString& destinationDirectory,
+                           bool moving, Preflight::Totals& totals) {
+    QStringList copied;
+    for (const QString& source: sources) {
+        if (!moving || !FileOperations::isSameDevice(source, destinationDirectory)) {
+            copied.append(source);
+        }
+    }
+    if (copied.isEmpty()) {
+        return true;
     }
-    destDir.mkpath(newFolderPath);
 
-    for (const QFileInfo& fileInfo: fileInfoList) {
-        const QString sourceFilePath = fileInfo.absoluteFilePath();
-        const QString destFilePath = newFolderPath + QDir::separator() + fileInfo.fileName();
+    {
+        QProgressDialog dialog(tr("Measuring..."), QString(), 0, 0, this);
+        dialog.setWindowTitle(title);
+        dialog.setWindowModality(Qt::WindowModal);
+        dialog.setMinimumDuration(500);
+        QTimer ticker;
+        connect(&ticker, &QTimer::timeout, &dialog, [&dialog]() { dialog.setValue(0); });
+        ticker.start(200);
+        runInBackground([&totals, copied]() { totals = Preflight::measure(copied); }, &dialog);
+    }
 
-        if (fileInfo.isDir()) {
-            if (!copy_directory(sourceFilePath, newFolderPath)) {
-                return false;
-            }
-        } else if (fileInfo.isFile()) {
-            QFile::copy(sourceFilePath, destFilePath);
-        } else {
-            qWarning() << "Unsupported file type:" << sourceFilePath;
-            return false;
-        }
+    const qint64 available = Preflight::freeSpace(destinationDirectory);
+    if (available < 0 || totals.bytes <= available) {
+        return true;
     }
+    auto reply = QMessageBox::warning(this, title,
+                                      tr("This needs %1, but only %2 are free at the destination. Start anyway?")
+                                          .arg(QLocale().formattedDataSize(totals.bytes),
+                                               QLocale().formattedDataSize(available)),
+                                      QMessageBox::Yes | QMessageBox::No, QMessageBox::No);
+    return reply == QMessageBox::Yes;
+}
 
-    return true;
+// Runs work on a worker thread behind a progress bar and time estimate fed
+// by the preflight totals.
+bool MainWidget::runTransfer(const QString& title, const QStringList& sources, const QString& destinationDirectory,
+                             bool moving, const std::function<bool()>& work) {
+    Preflight::Totals totals;
+    if (!preflight(title, sources, destinationDirectory, moving, totals)) {
+        return false;
+    }
+    if (totals.files == 0 && totals.directories == 0) {
+        return work();
+    }
+
+    TransferProgress progress(totals.bytes, totals.files);
+    QProgressDialog dialog(QString(), QString(), 0, 1000, this);
+    dialog.setWindowTitle(title);
+    dialog.setWindowModality(Qt::WindowModal);
+    dialog.setMinimumDuration(500);
+    // The totals are an estimate; a bar that fills early must stay up.
+    dialog.setAutoClose(false);
+    dialog.setAutoReset(false);
+    QTimer ticker;
+    connect(&ticker, &QTimer::timeout, &dialog, [&dialog, &progress]() { showTransferProgress(&dialog, progress); });
+    ticker.start(JobPanel::frameInterval(&dialog));
+
+    Throttle throttle;
+    const int jobId = jobPanel->addJob(title, &throttle, &progress);
+
+    bool result = false;
+    progress.start();
+    runInBackground([&result, &progress, &throttle, &work]() {
+        FileOperations::setProgress(&progress);
+        FileOperations::setThrottle(&throttle);
+        result = work();
+        FileOperations::setThrottle(nullptr);
+        FileOperations::setProgress(nullptr);
+    }, &dialog);
+    jobPanel->removeJob(jobId);
+    return result;
 }
 
 
@@ -561,11 +1448,11 @@ void MainWidget::copy() {
     QModelIndex currentIndex2 = ui->dir_list_2->currentIndex();
 
     if (currentIndex1.isValid()) {
-        defaultSourcePath = model_1->filePath(currentIndex1);
+        defaultSourcePath = model_1->filePath(toFileModelIndex(currentIndex1));
     } else if (currentIndex2.isValid()) {
-        defaultSourcePath = model_2->filePath(currentIndex2);
+        defaultSourcePath = model_2->filePath(toFileModelIndex(currentIndex2));
     } else {
-        defaultSourcePath = model_1->filePath(ui->dir_list_1->rootIndex());
+        defaultSourcePath = listRootPath(ui->dir_list_1);
     }
 
     bool ok;
@@ -616,27 +1503,34 @@ void MainWidget::copySelectedItems() {
         return;
     }
 
-    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(view->model());
+    QFileSystemModel* model = fileModelOf(view);
     if (!model) {
         return;
     }
 
+    QString currentDirPath = model->filePath(toFileModelIndex(view->rootIndex()));
+    QStringList filePaths;
     for (const QModelIndex& index: selectedIndexes) {
-        QFileInfo fileInfo = model->fileInfo(index);
+        QFileInfo fileInfo = model->fileInfo(toFileModelIndex(index));
         if (fileInfo.exists()) {
-            QString currentDirPath = model->filePath(view->rootIndex());
             if (fileInfo.isDir()) {
                 if (!copy_directory(fileInfo.absoluteFilePath(), currentDirPath)) {
                     qWarning() << "Failed to copy directory:" << fileInfo.absoluteFilePath();
                 }
             } else if (fileInfo.isFile()) {
-                QString destinationPath = QDir(currentDirPath).absoluteFilePath(fileInfo.fileName());
-                if (!copy_file(fileInfo.absoluteFilePath(), destinationPath)) {
-                    qWarning() << "Failed to copy file:" << fileInfo.absoluteFilePath();
-                }
+                filePaths.append(fileInfo.absoluteFilePath());
             }
         }
     }
+
+    // Read the selected files in on-disk order rather than selection order.
+    CopyPlan::sortByPhysicalOrder(filePaths);
+    for (const QString& filePath: filePaths) {
+        QString destinationPath = QDir(currentDirPath).absoluteFilePath(QFileInfo(filePath).fileName());
+        if (!copy_file(filePath, destinationPath)) {
+            qWarning() << "Failed to copy file:" << filePath;
+        }
+    }
 }
 
 
@@ -656,7 +1550,7 @@ void MainWidget::createNewFile() {
                                              tr("Filename:"), QLineEdit::Normal,
                                              "newfile.txt", &ok);
     if (ok && !filename.isEmpty()) {
-        QString currentDirPath = model_1->filePath(ui->dir_list_1->rootIndex());
+        QString currentDirPath = listRootPath(ui->dir_list_1);
 
         QFileInfo fi(filename);
         QString baseName = fi.baseName();
@@ -687,7 +1581,7 @@ void MainWidget::createNewDirectory() {
                                                tr("Folder Name:"), QLineEdit::Normal,
                                                "New Folder", &ok);
     if (ok && !folderName.isEmpty()) {
-        QString currentDirPath = model_1->filePath(ui->dir_list_1->rootIndex());
+        QString currentDirPath = listRootPath(ui->dir_list_1);
 
         QString folderPath = QDir(currentDirPath).filePath(folderName);
 
@@ -720,11 +1614,11 @@ void MainWidget::deleteSelectedItems() {
                                        QMessageBox::Yes | QMessageBox::No);
 
     if (result == QMessageBox::Yes) {
-        QFileSystemModel* model = qobject_cast<QFileSystemModel*>(view->model());
+        QFileSystemModel* model = fileModelOf(view);
         if (!model) return;
 
         for (const QModelIndex& index: selectedIndexes) {
-            QFileInfo fileInfo = model->fileInfo(index);
+            QFileInfo fileInfo = model->fileInfo(toFileModelIndex(index));
 
             if (fileInfo.isSymLink() && fileInfo.path() == QDir::rootPath()) {
                 QString linkTarget = fileInfo.symLinkTarget();
@@ -741,12 +1635,8 @@ void MainWidget::deleteSelectedItems() {
             }
 
             if (fileInfo.exists()) {
-                if (fileInfo.isDir()) {
-                    QDir dir(fileInfo.absoluteFilePath());
-                    dir.removeRecursively();
-                } else if (fileInfo.isFile()) {
-                    QFile file(fileInfo.absoluteFilePath());
-                    file.remove();
+                if (!FileOperations::removeTree(fileInfo.absoluteFilePath())) {
+                    qWarning() << "Failed to delete:" << fileInfo.absoluteFilePath();
                 }
             }
         }
@@ -757,16 +1647,20 @@ void MainWidget::renameSelectedItem() {
     if (!contextMenuView) return;
 
     QAbstractItemView* view = contextMenuView;
+    if (view->selectionModel()->selectedIndexes().size() > 1) {
+        bulkRenameItems(view);
+        return;
+    }
     QModelIndex currentIndex = view->currentIndex();
 
     if (!currentIndex.isValid()) {
         return;
     }
 
-    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(view->model());
+    QFileSystemModel* model = fileModelOf(view);
     if (!model) return;
 
-    QFileInfo fileInfo = model->fileInfo(currentIndex);
+    QFileInfo fileInfo = model->fileInfo(toFileModelIndex(currentIndex));
     QString oldFilePath = fileInfo.absoluteFilePath();
 
     bool ok;
@@ -788,6 +1682,49 @@ void MainWidget::renameSelectedItem() {
 }
 
 
+void MainWidget::bulkRenameItems(QAbstractItemView* view) {
+    QFileSystemModel* model = fileModelOf(view);
+    if (!model) return;
+
+    // In the order they are listed, so numbering follows the listing.
+    QModelIndexList selected = view->selectionModel()->selectedIndexes();
+    std::sort(selected.begin(), selected.end(), [](const QModelIndex& first, const QModelIndex& second) {
+        return first.row() < second.row();
+    });
+
+    const QString directory = model->filePath(toFileModelIndex(view->rootIndex()));
+    QStringList names;
+    for (const QModelIndex& index: selected) {
+        const QFileInfo fileInfo = model->fileInfo(toFileModelIndex(index));
+        if (index.column() == 0 && fileInfo.fileName() != ".." && fileInfo.absolutePath() == directory) {
+            names << fileInfo.fileName();
+        }
+    }
+    if (names.isEmpty()) {
+        return;
+    }
+
+    RenameDialog dialog(directory, names, this);
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+
+    auto job = new RenameJob(dialog.plan(), this);
+    connect(job, &RenameJob::finished, this, [this, job, directory](int renamed, const QStringList& failures) {
+        rescanDirectory(directory);
+        const QString summary = tr("%n item(s) renamed.", "", renamed);
+        if (failures.isEmpty()) {
+            QMessageBox::information(this, tr("Rename Finished"), summary);
+        } else {
+            QMessageBox box(QMessageBox::Warning, tr("Rename Finished"),
+                            summary + " " + tr("%n item(s) failed.", "", failures.size()), QMessageBox::Ok, this);
+            box.setDetailedText(failures.join("\n"));
+            box.exec();
+        }
+        job->deleteLater();
+    });
+    job->start();
+}
 
 bool MainWidget::askUserForOverwrite(const QString& filePath) {
     QMessageBox::StandardButton reply;
@@ -835,11 +1772,11 @@ void MainWidget::move() {
     QModelIndex currentIndex2 = ui->dir_list_2->currentIndex();
 
     if (currentIndex1.isValid()) {
-        defaultSourcePath = model_1->filePath(currentIndex1);
+        defaultSourcePath = model_1->filePath(toFileModelIndex(currentIndex1));
     } else if (currentIndex2.isValid()) {
-        defaultSourcePath = model_2->filePath(currentIndex2);
+        defaultSourcePath = model_2->filePath(toFileModelIndex(currentIndex2));
     } else {
-        defaultSourcePath = model_1->filePath(ui->dir_list_1->rootIndex());
+        defaultSourcePath = listRootPath(ui->dir_list_1);
     }
 
     bool ok;
@@ -879,15 +1816,16 @@ void MainWidget::move() {
         QDir destDir(destinationDirPath);
 
 
+        const QString sourceDirPath = sourceDir.absolutePath();
         if (destDir.exists()) {
             mergeDirectories(sourceDir, destDir);
             return;
-        } else {
-            if (!copy_directory(sourceDir.absolutePath(), destinationPath)) {
-                QMessageBox::warning(this, tr("Error"), tr("Failed to move the directory."));
-            } else {
-                sourceDir.removeRecursively();
-            }
+        } else if (!runTransfer(tr("Move"), {sourceDirPath}, destinationPath, true,
+                                [sourceDirPath, destinationDirPath]() {
+                                    return FileOperations::moveDirectory(sourceDirPath, destinationDirPath);
+                                })) {
+            QMessageBox::warning(this, tr("Error"), tr("Failed to move the directory."));
+            return;
         }
     } else if (sourceInfo.isFile() && sourceInfo.isWritable()) {
         QDir destDir(destinationPath);
@@ -909,8 +1847,10 @@ void MainWidget::move() {
             }
         }
 
-        QFile sourceFile(sourcePath);
-        if (!sourceFile.rename(destinationPath)) {
+        if (!runTransfer(tr("Move"), {sourcePath}, QFileInfo(destinationPath).absolutePath(), true,
+                         [sourcePath, destinationPath]() {
+                             return FileOperations::moveFile(sourcePath, destinationPath);
+                         })) {
             QMessageBox::warning(this, tr("Error"), tr("Failed to move the file."));
             return;
         }
@@ -978,13 +1918,13 @@ void MainWidget::compressSelectedItems() {
         return;
     }
 
-    QFileSystemModel* model = qobject_cast<QFileSystemModel*>(view->model());
+    QFileSystemModel* model = fileModelOf(view);
     if (!model) {
         return;
     }
 
     for (const QModelIndex& index: selectedIndexes) {
-        QFileInfo fileInfo = model->fileInfo(index);
+        QFileInfo fileInfo = model->fileInfo(toFileModelIndex(index));
         QString filePath = fileInfo.filePath();
         if (!fileInfo.isReadable()) {
             QMessageBox::warning(this, "Permission Denied", "You don't have permission to open: " + filePath);
@@ -1009,7 +1949,7 @@ void MainWidget::compressSelectedItems() {
         return;
     }
 
-    QString workingDirectory = model->filePath(view->rootIndex());
+    QString workingDirectory = model->filePath(toFileModelIndex(view->rootIndex()));
     QString archiveName = baseName;
     int archiveNumber = 0;
     QString destinationPath;
@@ -1049,13 +1989,13 @@ QString MainWidget::determineDestinationPath(QObject *dropTarget, const QPoint &
     QAbstractItemView *view = qobject_cast<QAbstractItemView*>(dropTarget);
     if (view) {
         QModelIndex index = view->indexAt(dropPosition);
-        QFileSystemModel *model = qobject_cast<QFileSystemModel*>(view->model());
+        QFileSystemModel *model = fileModelOf(view);
         if (model) {
             QString path;
             if (index.isValid()) {
-                path = model->filePath(index);
+                path = model->filePath(toFileModelIndex(index));
             } else {
-                path = model->filePath(view->rootIndex());
+                path = model->filePath(toFileModelIndex(view->rootIndex()));
             }
             if (QFileInfo(path).isDir()) {
                 return path;
@@ -1068,103 +2008,268 @@ QString MainWidget::determineDestinationPath(QObject *dropTarget, const QPoint &
 }
 
 
-void MainWidget::moveItem(QString &sourcePath, QString &destinationPath) {
-    QString defaultSourcePath;
-    QModelIndex currentIndex1 = ui->dir_list_1->currentIndex();
-    QModelIndex currentIndex2 = ui->dir_list_2->currentIndex();
+void MainWidget::moveItems(const QStringList& sourcePaths, const QString& destinationPath) {
+    if (sourcePaths.isEmpty() || destinationPath.isEmpty()) {
+        return;
+    }
 
-    if (currentIndex1.isValid()) {
-        defaultSourcePath = model_1->filePath(currentIndex1);
-    } else if (currentIndex2.isValid()) {
-        defaultSourcePath = model_2->filePath(currentIndex2);
-    } else {
-        defaultSourcePath = model_1->filePath(ui->dir_list_1->rootIndex());
+    auto job = new MoveJob(sourcePaths, destinationPath, this);
+
+    // Ask once for the whole drop instead of once per item.
+    QStringList conflicts = job->conflicts();
+    if (!conflicts.isEmpty()) {
+        auto reply = QMessageBox::question(this, tr("Items Exist"),
+                                           tr("%n item(s) already exist at the destination. Do you want to overwrite them?\n\n"
+                                              "Choose No to skip them.", "", conflicts.size()),
+                                           QMessageBox::Yes | QMessageBox::No | QMessageBox::Cancel);
+        if (reply == QMessageBox::Cancel) {
+            delete job;
+            return;
+        }
+        job->setConflictPolicy(reply == QMessageBox::Yes ? MoveJob::Overwrite : MoveJob::Skip);
     }
 
-    if (sourcePath.isEmpty()) {
-        QMessageBox::warning(this, tr("Error"), tr("Invalid source path."));
+    Preflight::Totals totals;
+    if (!preflight(tr("Move"), sourcePaths, destinationPath, true, totals)) {
+        delete job;
         return;
     }
 
-    if (sourcePath == destinationPath) {
-        QMessageBox::warning(this, tr("Error"), tr("Cannot move to the source."));
+    // Renames finish at once; only a job that copies gets a progress bar.
+    QProgressDialog* progressDialog = nullptr;
+    int jobId = -1;
+    if (totals.files > 0 || totals.directories > 0) {
+        jobId = jobPanel->addJob(tr("Move to %1").arg(destinationPath), &job->throttle(), &job->progress());
+        job->setExpected(totals);
+        progressDialog = new QProgressDialog(QString(), QString(), 0, 1000, this);
+        progressDialog->setWindowTitle(tr("Move"));
+        progressDialog->setMinimumDuration(500);
+        progressDialog->setAutoClose(false);
+        progressDialog->setAutoReset(false);
+        QTimer* ticker = new QTimer(progressDialog);
+        connect(ticker, &QTimer::timeout, progressDialog, [progressDialog, job]() {
+            showTransferProgress(progressDialog, job->progress());
+        });
+        ticker->start(JobPanel::frameInterval(progressDialog));
+    }
+
+    connect(job, &MoveJob::finished, this, [this, job, progressDialog, jobId](int moved, int skipped,
+                                                                              const QStringList& failures) {
+        delete progressDialog;
+        if (jobId >= 0) {
+            jobPanel->removeJob(jobId);
+        }
+        QString summary = tr("%n item(s) moved.", "", moved);
+        if (skipped > 0) {
+            summary += " " + tr("%n item(s) skipped.", "", skipped);
+        }
+        if (failures.isEmpty()) {
+            QMessageBox::information(this, tr("Move Finished"), summary);
+        } else {
+            QMessageBox box(QMessageBox::Warning, tr("Move Finished"),
+                            summary + " " + tr("%n item(s) failed.", "", failures.size()), QMessageBox::Ok, this);
+            box.setDetailedText(failures.join("\n"));
+            box.exec();
+        }
+        job->deleteLater();
+    });
+    job->start();
+}
+
+void MainWidget::deduplicateDirectory() {
+    const QString directory = listRootPath(contextMenuView ? contextMenuView : ui->dir_list_1);
+    if (directory.isEmpty()) {
         return;
     }
 
-    if (destinationPath.isEmpty()) {
-        QMessageBox::warning(this, tr("Error"), tr("Invalid destination path."));
+    QSettings settings;
+    QMessageBox box(QMessageBox::Question, tr("Deduplicate"),
+                    tr("Find files with identical contents below %1 and make them share their storage?")
+                        .arg(QDir::toNativeSeparators(directory)),
+                    QMessageBox::Yes | QMessageBox::No, this);
+    // Hard links also share permissions and timestamps, and a change made
+    // through one name shows through all of them, so they are opt-in.
+    QCheckBox* linkBox = new QCheckBox(tr("Replace with hard links where the file system cannot share extents"));
+    linkBox->setChecked(settings.value("dedupe/hardLinks", false).toBool());
+    box.setCheckBox(linkBox);
+    if (box.exec() != QMessageBox::Yes) {
         return;
     }
+    const bool hardLinks = linkBox->isChecked();
+    settings.setValue("dedupe/hardLinks", hardLinks);
 
-    QFileInfo sourceInfo(sourcePath);
-    QString baseName = sourceInfo.fileName();
-    QString dirPath = sourceInfo.absolutePath();
+    auto job = new DedupeJob(directory, hardLinks, this);
+    connect(job, &DedupeJob::finished, this,
+            [this, job](qint64 reclaimed, int deduplicated, int groups, const QStringList& failures) {
+        const QString summary = tr("%n duplicate(s) in %1 group(s) deduplicated, %2 reclaimed.", "", deduplicated)
+                                    .arg(groups).arg(QLocale().formattedDataSize(reclaimed));
+        if (failures.isEmpty()) {
+            QMessageBox::information(this, tr("Deduplication Finished"), summary);
+        } else {
+            QMessageBox box(QMessageBox::Warning, tr("Deduplication Finished"), summary, QMessageBox::Ok, this);
+            box.setDetailedText(failures.join("\n"));
+            box.exec();
+        }
+        job->deleteLater();
+    });
+    job->start();
+}
 
+void MainWidget::splitSelectedFile() {
+    if (!contextMenuView) return;
 
-    if (dirPath == destinationPath) {
-        QMessageBox::warning(this, tr("Error"), tr("Item cannot be moved within the same directory."));
+    const QString path = contextMenuView->currentIndex().data(QFileSystemModel::FilePathRole).toString();
+    const QFileInfo info(path);
+    if (!info.isFile()) {
         return;
     }
 
-    if (baseName == "." || baseName == "..") {
-        QMessageBox::warning(this, tr("Error"), tr("Cannot move the current or parent directory."));
+    QSettings settings;
+    bool ok;
+    // 4095 MiB fits FAT32, which cannot hold a file of 4 GiB.
+    const int partMegabytes = QInputDialog::getInt(this, tr("Split"),
+                                                   tr("Size of each part in MiB (4095 fits FAT32):"),
+                                                   settings.value("split/partSize", 4095).toInt(), 1, 1 << 20, 1,
+                                                   &ok);
+    if (!ok) {
         return;
     }
+    settings.setValue("split/partSize", partMegabytes);
 
+    const qint64 partSize = qint64(partMegabytes) << 20;
+    if (info.size() <= partSize) {
+        QMessageBox::information(this, tr("Split"), tr("The file already fits into one part."));
+        return;
+    }
+    Preflight::Totals totals;
+    if (!preflight(tr("Split"), {path}, info.absolutePath(), false, totals)) {
+        return;
+    }
+    runSplitJob(new SplitJob(path, partSize, this), tr("Split %1").arg(info.fileName()));
+}
 
-    if (sourceInfo.isDir() && sourceInfo.isWritable()) {
-        QDir sourceDir(sourcePath);
-        QString destinationDirPath = destinationPath + "/" + baseName;
-
-        if (!sourceDir.exists()) {
-            QMessageBox::warning(this, tr("Error"), tr("Source directory does not exist."));
-            return;
-        }
+void MainWidget::joinSelectedFile() {
+    if (!contextMenuView) return;
 
-        QDir destDir(destinationDirPath);
+    const QString path = contextMenuView->currentIndex().data(QFileSystemModel::FilePathRole).toString();
+    SplitManifest manifest;
+    if (!path.endsWith(SplitManifest::suffix) || !manifest.load(path)) {
+        QMessageBox::warning(this, tr("Join"),
+                             tr("Select the %1 file that was written together with the parts.")
+                                 .arg(SplitManifest::suffix));
+        return;
+    }
 
+    const QDir directory = QFileInfo(path).absoluteDir();
+    QStringList parts;
+    for (const SplitManifest::Part& part: manifest.parts) {
+        parts.append(directory.filePath(part.name));
+    }
+    Preflight::Totals totals;
+    if (!preflight(tr("Join"), parts, directory.absolutePath(), false, totals)) {
+        return;
+    }
+    runSplitJob(new SplitJob(path, this), tr("Join %1").arg(manifest.fileName));
+}
 
-        if (destDir.exists()) {
-            mergeDirectories(sourceDir, destDir);
-            return;
+void MainWidget::runSplitJob(SplitJob* job, const QString& title) {
+    const int jobId = jobPanel->addJob(title, &job->throttle(), &job->progress());
+    QProgressDialog* progressDialog = new QProgressDialog(QString(), QString(), 0, 1000, this);
+    progressDialog->setWindowTitle(title);
+    progressDialog->setMinimumDuration(500);
+    progressDialog->setAutoClose(false);
+    progressDialog->setAutoReset(false);
+    QTimer* ticker = new QTimer(progressDialog);
+    connect(ticker, &QTimer::timeout, progressDialog, [progressDialog, job]() {
+        showTransferProgress(progressDialog, job->progress());
+    });
+    ticker->start(JobPanel::frameInterval(progressDialog));
+
+    connect(job, &SplitJob::finished, this, [this, job, jobId, progressDialog, title](const QString& resultPath,
+                                                                                    const QStringList& failures) {
+        delete progressDialog;
+        jobPanel->removeJob(jobId);
+        if (failures.isEmpty()) {
+            QMessageBox::information(this, title, tr("Written %1.").arg(QDir::toNativeSeparators(resultPath)));
         } else {
-            if (!copy_directory(sourceDir.absolutePath(), destinationPath)) {
-                QMessageBox::warning(this, tr("Error"), tr("Failed to move the directory."));
-            } else {
-                sourceDir.removeRecursively();
-            }
+            QMessageBox box(QMessageBox::Warning, title, tr("Nothing was kept: %n problem(s) occurred.", "",
+                                                            failures.size()),
+                            QMessageBox::Ok, this);
+            box.setDetailedText(failures.join("\n"));
+            box.exec();
         }
-    } else if (sourceInfo.isFile() && sourceInfo.isWritable()) {
-        QDir destDir(destinationPath);
-        if (destDir.exists()) {
-            destinationPath = destDir.filePath(baseName);
+        job->deleteLater();
+    });
+    job->start();
+}
+
+void MainWidget::showJobPanel() {
+    jobPanel->show();
+    jobPanel->raise();
+    jobPanel->activateWindow();
+}
+
+// For the pane the context menu was opened on, or the focused one when
+// asked for by shortcut.
+void MainWidget::showStatistics() {
+    QAbstractItemView* view = ui->dir_list_2->hasFocus() ? ui->dir_list_2 : ui->dir_list_1;
+    if (sender() == statsAction && contextMenuView) {
+        view = contextMenuView;
+    }
+    const QString directory = listRootPath(view);
+    if (!directory.isEmpty()) {
+        statsPanel->showDirectory(directory);
+    }
+}
+
+
+void MainWidget::resumeInterruptedJobs() {
+    for (const QString& journalPath: CopyJournal::pendingJournals()) {
+        CopyJournal journal;
+        if (!journal.load(journalPath)) {
+            continue;
         }
-        if (QFileInfo::exists(destinationPath)) {
-            QMessageBox::StandardButton reply;
-            reply = QMessageBox::question(this, tr("File Exists"),
-                                          tr("The file %1 already exists at the destination. Do you want to overwrite it?").arg(
-                                              baseName),
-                                          QMessageBox::Yes | QMessageBox::No);
 
-            if (reply == QMessageBox::Yes) {
-                QFile::remove(destinationPath);
-            } else {
-                return;
+        QString operation = journal.operation() == CopyJournal::Move ? tr("move") : tr("copy");
+        // A job over several items, like a drop, is asked about once.
+        const QString description = journal.itemCount() == 1
+                ? tr("An interrupted %1 from %2 to %3 was found.").arg(operation, journal.sourcePath(), journal.destinationPath())
+                : tr("An interrupted %1 of %n item(s) to %2 was found.", "", journal.itemCount())
+                          .arg(operation, QFileInfo(journal.destinationPath()).absolutePath());
+        auto reply = QMessageBox::question(this, tr("Interrupted Operation"),
+                                           description + " " + tr("Do you want to resume it?\n\n"
+                                                                  "Choose Discard to forget it without touching any files."),
+                                           QMessageBox::Yes | QMessageBox::No | QMessageBox::Discard);
+
+        if (reply == QMessageBox::Discard) {
+            journal.finish();
+        } else if (reply == QMessageBox::Yes) {
+            // Items already confirmed only have their sources left to remove;
+            // the rest are measured and copied like a fresh transfer.
+            QStringList remaining;
+            for (int i = 0; i < journal.itemCount(); ++i) {
+                if (!journal.isCopyConfirmed(i) && !journal.isRemoved(i)) {
+                    remaining.append(journal.sourcePath(i));
+                }
+            }
+            const bool moving = journal.operation() == CopyJournal::Move;
+            if (!runTransfer(moving ? tr("Move") : tr("Copy"), remaining, QFileInfo(journal.destinationPath()).absolutePath(),
+                             moving, [&journal]() { return FileOperations::resume(journal); })) {
+                QMessageBox::warning(this, tr("Error"), tr("Failed to resume the %1 of %2.").arg(operation, journal.sourcePath()));
             }
         }
-        QFile sourceFile(sourcePath);
-        if (!sourceFile.rename(destinationPath)) {
-            QMessageBox::warning(this, tr("Error"), tr("Failed to move the file."));
-            return;
-        }
-    } else {
-        return;
     }
-    QMessageBox::information(this, tr("Success"), tr("Item moved successfully."));
 }
 
 
 bool MainWidget::eventFilter(QObject *obj, QEvent *event) {
+    if (obj == ui->dir_list_1->viewport() || obj == ui->dir_list_2->viewport()) {
+        if (event->type() == QEvent::Paint) {
+            reportFirstFrame(obj == ui->dir_list_1->viewport() ? ui->dir_list_1 : ui->dir_list_2);
+        }
+        return QWidget::eventFilter(obj, event);
+    }
+
     if (event->type() == QEvent::DragEnter) {
         auto *dragEnterEvent = static_cast<QDragEnterEvent*>(event);
         dragEnterEvent->acceptProposedAction();
@@ -1178,16 +2283,13 @@ bool MainWidget::eventFilter(QObject *obj, QEvent *event) {
 
         const QMimeData *mimeData = dropEvent->mimeData();
         if (mimeData->hasUrls()) {
-            QList<QUrl> urls = mimeData->urls();
-            if (!urls.isEmpty()) {
-                QString sourcePath = urls.first().toLocalFile();
-                QString destinationPath = determineDestinationPath(obj, dropEvent->position().toPoint());
-
-
-                if (!sourcePath.isEmpty() && !destinationPath.isEmpty()) {
-                    moveItem(sourcePath, destinationPath);
+            QStringList sourcePaths;
+            for (const QUrl& url: mimeData->urls()) {
+                if (url.isLocalFile()) {
+                    sourcePaths.append(url.toLocalFile());
                 }
             }
+            moveItems(sourcePaths, determineDestinationPath(obj, dropEvent->position().toPoint()));
         }
         return true;
     }
@@ -10,6 +10,22 @@
 #include <QDragEnterEvent>
 #include <QDropEvent>
 #include <QUrl>
+#include <QElapsedTimer>
+
+#include <functional>
+
+#include "panehistory.h"
+#include "preflight.h"
+
+class DirWatcher;
+class DirPrefetcher;
+class FlatListModel;
+class JobPanel;
+class StatsPanel;
+class SplitJob;
+class PaneFilterModel;
+class PathIndex;
+class QTimer;
 
 namespace Ui {
 class MainWidget;
@@ -52,6 +68,22 @@ private slots:
     void setLightMode();
     void toggleMode();
     void setDarkMode();
+    void resumeInterruptedJobs();
+    void syncWatchedDirectories();
+    void applyDirectoryChanges(const QString& directory, const QStringList& created,
+                               const QStringList& modified, const QStringList& removed);
+    void rescanDirectory(const QString& directory);
+    void revalidateSnapshot(const QString& path);
+    void viewCurrentFile();
+    void openPathPalette();
+    void applyPrefetch(const QString& directory);
+    void goBack();
+    void goForward();
+    void deduplicateDirectory();
+    void showJobPanel();
+    void showStatistics();
+    void splitSelectedFile();
+    void joinSelectedFile();
 
 protected:
     bool eventFilter(QObject *obj, QEvent *event) override;
@@ -61,6 +93,10 @@ private:
     Ui::MainWidget *ui;
     QFileSystemModel *model_1;
     QFileSystemModel *model_2;
+    PaneFilterModel* filterModel_1;
+    PaneFilterModel* filterModel_2;
+    FlatListModel* flatModel_1;
+    FlatListModel* flatModel_2;
     QStringList similarFiles;
     QStringList differentFiles;
     QMenu* contextMenu;
@@ -70,9 +106,59 @@ private:
     QAction* renameAction;
     QAction* copyAction;
     QAction* sortAction;
+    QAction* dedupeAction;
+    QAction* splitAction;
+    QAction* joinAction;
+    QAction* jobsAction;
+    QAction* statsAction;
+    QAction* verifyAction;
     QAbstractItemView* contextMenuView;
+    DirWatcher* dirWatcher;
+    QHash<QTreeView*, QSet<QString>> expandedDirectories;
+    DirPrefetcher* prefetcher;
+    JobPanel* jobPanel;
+    StatsPanel* statsPanel;
+    QHash<QString, QFileSystemModel*> prefetchTargets;
+    QTimer* hoverTimer;
+    QAbstractItemView* hoveredView;
+    QPersistentModelIndex hoveredIndex;
+    void setListRoot(QAbstractItemView* view, const QModelIndex& index);
+    void prefetchDirectory(QAbstractItemView* view, const QModelIndex& index, bool withNeighbours);
+    QString listRootPath(QAbstractItemView* listView);
+    bool isDirectoryShown(QFileSystemModel* model, const QString& path);
+    void relistDirectory(QFileSystemModel* model, const QString& path);
+    void forgetDirectories(const QString& directory, const QStringList& names);
+    QElapsedTimer startupTimer;
+    bool firstFrameReported;
+    PathIndex* pathIndex;
+    QElapsedTimer pathIndexAge;
+    QHash<QFileSystemModel*, QString> pendingRevalidation;
+    PaneHistory history_1;
+    PaneHistory history_2;
+    QHash<QAbstractItemView*, HistoryEntry> pendingViewState;
+    void restoreSnapshot();
+    void saveSnapshot();
+    void attachListModel(QFileSystemModel* model, const QString& rootPath);
+    void showListModel(QAbstractItemView* listView, QAbstractItemModel* model, const QModelIndex& root);
+    void applyFilter(QAbstractItemView* listView);
+    void showPlainListing(QAbstractItemView* view);
+    PaneHistory& historyOf(QAbstractItemView* listView);
+    HistoryEntry currentHistoryEntry(QAbstractItemView* listView);
+    void rememberListing(QAbstractItemView* listView);
+    void restoreViewState(QAbstractItemView* listView, const HistoryEntry& entry);
+    void navigateHistory(bool forward);
+    void setFlatView(QAbstractItemView* listView, bool flat);
+    void openFile(const QString& path);
+    bool openArchiveMember(const QString& archivePath, const QString& member);
+    void reportFirstFrame(QAbstractItemView* view);
     QString determineDestinationPath(QObject *dropTarget, const QPoint &dropPosition);
-    void moveItem(QString &sourcePath, QString &destinationPath);
+    void moveItems(const QStringList& sourcePaths, const QString& destinationPath);
+    bool preflight(const QString& title, const QStringList& sources, const QString& destinationDirectory, bool moving,
+                   Preflight::Totals& totals);
+    void runSplitJob(SplitJob* job, const QString& title);
+    bool runTransfer(const QString& title, const QStringList& sources, const QString& destinationDirectory,
+                     bool moving, const std::function<bool()>& work);
+    void bulkRenameItems(QAbstractItemView* view);
     QStringList getFilesRecursively(QString &directoryPath);
 
 
@@ -0,0 +1,89 @@
+#include <QFileInfo>
+#include <QDebug>
+
+#include "mappedfile.h"
+
+
+// Windows start on this boundary so that small moves around the same area
+// of the file keep hitting the current mapping.
+static const qint64 windowAlignment = 1 << 16;
+
+
+MappedFile::MappedFile()
+        : window(nullptr),
+          windowOffset(0),
+          windowLength(0),
+          fileSize(0) {
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const QString& path) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Could not open file for viewing:" << path;
+        return false;
+    }
+    fileSize = file.size();
+    return true;
+}
+
+void MappedFile::close() {
+    unmapWindow();
+    if (file.isOpen()) {
+        file.close();
+    }
+    fileSize = 0;
+}
+
+bool MappedFile::isOpen() const {
+    return file.isOpen();
+}
+
+qint64 MappedFile::size() const {
+    return fileSize;
+}
+
+qint64 MappedFile::refreshSize() {
+    // Growing files keep their current window; a shrunk file must not be
+    // read through a mapping that now extends past its end.
+    qint64 newSize = QFileInfo(file.fileName()).size();
+    if (newSize < windowOffset + windowLength) {
+        unmapWindow();
+    }
+    fileSize = newSize;
+    return fileSize;
+}
+
+const uchar* MappedFile::map(qint64 offset, qint64 length) {
+    if (!file.isOpen() || offset < 0 || length <= 0 || offset + length > fileSize) {
+        return nullptr;
+    }
+
+    if (window && offset >= windowOffset && offset + length <= windowOffset + windowLength) {
+        return window + (offset - windowOffset);
+    }
+
+    unmapWindow();
+    windowOffset = offset - offset % windowAlignment;
+    windowLength = qMin(qMax(windowSize, offset + length - windowOffset), fileSize - windowOffset);
+    window = file.map(windowOffset, windowLength);
+    if (!window) {
+        qWarning() << "Could not map" << file.fileName() << "at offset" << windowOffset;
+        windowLength = 0;
+        return nullptr;
+    }
+    return window + (offset - windowOffset);
+}
+
+void MappedFile::unmapWindow() {
+    if (window) {
+        file.unmap(window);
+        window = nullptr;
+    }
+    windowOffset = 0;
+    windowLength = 0;
+}
@@ -0,0 +1,38 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <QFile>
+#include <QString>
+
+// Read-only view of a file through a sliding memory-mapped window.
+//
+// Only one window of at most windowSize bytes is mapped at a time, so memory
+// use stays constant no matter how large the file is. A pointer returned by
+// map() stays valid until the next call to map() or close().
+class MappedFile {
+public:
+    static constexpr qint64 windowSize = 64 << 20;
+
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const QString& path);
+    void close();
+    bool isOpen() const;
+
+    qint64 size() const;
+    qint64 refreshSize();
+
+    const uchar* map(qint64 offset, qint64 length);
+
+private:
+    void unmapWindow();
+
+    QFile file;
+    uchar* window;
+    qint64 windowOffset;
+    qint64 windowLength;
+    qint64 fileSize;
+};
+
+#endif // MAPPEDFILE_H
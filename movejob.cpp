@@ -0,0 +1,259 @@
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutexLocker>
+#include <QStorageInfo>
+#include <QThread>
+#include <QThreadPool>
+#include <QDebug>
+
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+#include "movejob.h"
+#include "copyjournal.h"
+#include "fileoperations.h"
+#include "ioscheduler.h"
+
+
+// Identifies the filesystem a path lives on. Symbolic links count for the
+// directory that holds them, which is what rename() cares about.
+static quint64 deviceOf(const QString& path) {
+#ifdef Q_OS_UNIX
+    struct stat info;
+    if (::lstat(QFile::encodeName(path).constData(), &info) != 0) {
+        return 0;
+    }
+    return quint64(info.st_dev);
+#else
+    return qHash(QStorageInfo(path).rootPath());
+#endif
+}
+
+
+MoveJob::MoveJob(const QStringList& sourcePaths, const QString& destinationPath, QObject *parent)
+        : QObject(parent),
+          sources(sourcePaths),
+          destination(QDir(destinationPath).absolutePath()),
+          conflictPolicy(Skip),
+          worker(nullptr),
+          moved(0),
+          skipped(0) {
+}
+
+MoveJob::~MoveJob() {
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+QStringList MoveJob::conflicts() const {
+    QStringList existing;
+    for (const QString& sourcePath: sources) {
+        QFileInfo sourceInfo(sourcePath);
+        if (sourceInfo.absolutePath() != destination
+            && QFileInfo::exists(destination + "/" + sourceInfo.fileName())) {
+            existing.append(sourcePath);
+        }
+    }
+    return existing;
+}
+
+void MoveJob::setConflictPolicy(ConflictPolicy policy) {
+    conflictPolicy = policy;
+}
+
+void MoveJob::setExpected(const Preflight::Totals& totals) {
+    transfer.setTotal(totals.bytes, totals.files);
+}
+
+const TransferProgress& MoveJob::progress() const {
+    return transfer;
+}
+
+Throttle& MoveJob::throttle() {
+    return jobThrottle;
+}
+
+void MoveJob::start() {
+    transfer.start();
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+}
+
+void MoveJob::run() {
+    const quint64 destinationDevice = deviceOf(destination);
+    QHash<QString, QList<QPair<QString, QString>>> copyGroups;
+
+    for (const QString& path: sources) {
+        QFileInfo sourceInfo(path);
+        const QString sourcePath = sourceInfo.absoluteFilePath();
+        const QString name = sourceInfo.fileName();
+        const QString targetPath = destination + "/" + name;
+
+        if (!sourceInfo.exists()) {
+            addFailure(sourcePath, tr("does not exist"));
+            continue;
+        }
+        if (name == "." || name == "..") {
+            addFailure(sourcePath, tr("cannot move the current or parent directory"));
+            continue;
+        }
+        if (sourceInfo.absolutePath() == destination) {
+            ++skipped;
+            continue;
+        }
+        if (sourceInfo.isDir() && (destination == sourcePath || destination.startsWith(sourcePath + "/"))) {
+            addFailure(sourcePath, tr("cannot move a directory into itself"));
+            continue;
+        }
+
+        QFileInfo targetInfo(targetPath);
+        if (targetInfo.exists()) {
+            if (conflictPolicy == Skip) {
+                ++skipped;
+                continue;
+            }
+            if (targetInfo.isDir() != sourceInfo.isDir()) {
+                addFailure(sourcePath, tr("a different kind of item with this name already exists"));
+                continue;
+            }
+        }
+
+        if (deviceOf(sourcePath) == destinationDevice) {
+            if (renameItem(sourcePath, targetPath)) {
+                ++moved;
+            }
+        } else {
+            copyGroups[IoScheduler::instance().device(sourcePath).name].append(qMakePair(sourcePath, targetPath));
+        }
+    }
+
+    if (!copyGroups.isEmpty()) {
+        moveByCopy(copyGroups);
+    }
+
+    emit finished(moved, skipped, failures);
+}
+
+bool MoveJob::renameItem(const QString& sourcePath, const QString& targetPath) {
+    QFileInfo sourceInfo(sourcePath);
+    QFileInfo targetInfo(targetPath);
+    if (targetInfo.exists()) {
+        if (targetInfo.isDir() != sourceInfo.isDir()) {
+            addFailure(sourcePath, tr("a different kind of item with this name already exists"));
+            return false;
+        }
+        if (targetInfo.isDir()) {
+            return mergeByRename(sourcePath, targetPath);
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    // rename() replaces an existing file atomically.
+    if (::rename(QFile::encodeName(sourcePath).constData(), QFile::encodeName(targetPath).constData()) != 0) {
+        addFailure(sourcePath, qt_error_string(errno));
+        return false;
+    }
+    return true;
+#else
+    if (targetInfo.exists()) {
+        QFile::remove(targetPath);
+    }
+    if (!QDir().rename(sourcePath, targetPath)) {
+        addFailure(sourcePath, tr("rename failed"));
+        return false;
+    }
+    return true;
+#endif
+}
+
+bool MoveJob::mergeByRename(const QString& sourcePath, const QString& targetPath) {
+    QDir sourceDir(sourcePath);
+    bool merged = true;
+
+    const QFileInfoList entries = sourceDir.entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& entry: entries) {
+        merged = renameItem(entry.absoluteFilePath(), targetPath + "/" + entry.fileName()) && merged;
+    }
+
+    // Anything that could not be moved keeps the source directory alive.
+    return merged && QDir().rmdir(sourcePath);
+}
+
+void MoveJob::moveByCopy(const QHash<QString, QList<QPair<QString, QString>>>& copyGroups) {
+    QStringList sourcePaths;
+    QStringList targetPaths;
+    for (const auto& group: copyGroups) {
+        for (const auto& item: group) {
+            sourcePaths.append(item.first);
+            targetPaths.append(item.second);
+        }
+    }
+
+    // Without a journal nothing would record that a copy is complete before
+    // its source goes.
+    CopyJournal journal;
+    if (!journal.create(CopyJournal::Move, sourcePaths, targetPaths)) {
+        for (const QString& sourcePath: sourcePaths) {
+            addFailure(sourcePath, tr("could not create a journal"));
+        }
+        return;
+    }
+
+    // Each item is only ever written by the thread that copies it.
+    std::vector<char> copied(sourcePaths.size(), false);
+    QList<QThreadPool*> pools;
+    int index = 0;
+    for (auto it = copyGroups.cbegin(); it != copyGroups.cend(); ++it) {
+        // More threads than the disk has slots would only wait in the
+        // scheduler.
+        auto pool = new QThreadPool;
+        pool->setMaxThreadCount(IoScheduler::instance().device(it.value().first().first).concurrency);
+        for (int i = 0; i < it.value().size(); ++i) {
+            const int item = index++;
+            pool->start([this, &journal, &copied, item]() {
+                FileOperations::setProgress(&transfer);
+                FileOperations::setThrottle(&jobThrottle);
+                if (FileOperations::copyJournaled(journal, item)) {
+                    copied[item] = true;
+                } else {
+                    addFailure(journal.sourcePath(item), tr("copy to the destination failed"));
+                }
+                FileOperations::setThrottle(nullptr);
+                FileOperations::setProgress(nullptr);
+            });
+        }
+        pools.append(pool);
+    }
+    for (QThreadPool* pool: pools) {
+        pool->waitForDone();
+    }
+    qDeleteAll(pools);
+
+    QList<int> copiedItems;
+    for (int i = 0; i < int(copied.size()); ++i) {
+        if (copied[i]) {
+            copiedItems.append(i);
+        }
+    }
+    const QList<int> removed = FileOperations::removeMoved(journal, copiedItems);
+    moved += removed.size();
+    for (int item: copiedItems) {
+        if (!removed.contains(item)) {
+            addFailure(journal.sourcePath(item), tr("copied, but the source was kept"));
+        }
+    }
+}
+
+void MoveJob::addFailure(const QString& sourcePath, const QString& reason) {
+    qWarning() << "Could not move" << sourcePath << "-" << reason;
+    QMutexLocker locker(&failureMutex);
+    failures.append(sourcePath + ": " + reason);
+}
@@ -0,0 +1,69 @@
+#ifndef MOVEJOB_H
+#define MOVEJOB_H
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+
+#include <atomic>
+
+#include "preflight.h"
+#include "throttle.h"
+
+class QThread;
+
+// Moves a batch of items into one destination directory as a single job.
+//
+// Items on the destination's device are renamed in place, which is only a
+// metadata update. The rest are grouped by source disk and moved with the
+// journaled streaming copy, each group in its own thread pool sized to what
+// IoScheduler allows for that disk, so different disks are read in parallel.
+// All of them share one journal: an interrupted job is resumed as a whole,
+// and one sync confirms every copy before the sources are removed. The job
+// reports once, when every item has been handled.
+class MoveJob : public QObject {
+    Q_OBJECT
+
+public:
+    enum ConflictPolicy {
+        Skip,
+        Overwrite
+    };
+
+    MoveJob(const QStringList& sourcePaths, const QString& destinationPath, QObject *parent = nullptr);
+    ~MoveJob();
+
+    QStringList conflicts() const;
+    void setConflictPolicy(ConflictPolicy policy);
+    // What the items to be copied hold, for progress() to measure against.
+    void setExpected(const Preflight::Totals& totals);
+    const TransferProgress& progress() const;
+    // Limits for this job alone, on top of Throttle::global().
+    Throttle& throttle();
+    void start();
+
+signals:
+    void finished(int moved, int skipped, const QStringList& failures);
+
+private:
+    void run();
+    bool renameItem(const QString& sourcePath, const QString& targetPath);
+    bool mergeByRename(const QString& sourcePath, const QString& targetPath);
+    void moveByCopy(const QHash<QString, QList<QPair<QString, QString>>>& copyGroups);
+    void addFailure(const QString& sourcePath, const QString& reason);
+
+    QStringList sources;
+    QString destination;
+    ConflictPolicy conflictPolicy;
+    QThread *worker;
+    TransferProgress transfer;
+    Throttle jobThrottle;
+
+    std::atomic<int> moved;
+    std::atomic<int> skipped;
+    QMutex failureMutex;
+    QStringList failures;
+};
+
+#endif // MOVEJOB_H
@@ -0,0 +1,321 @@
+#include <QRegularExpression>
+
+#include <algorithm>
+
+#include "panefilter.h"
+
+
+PaneFilterModel::PaneFilterModel(QObject *parent)
+        : QAbstractProxyModel(parent),
+          mode(Substring),
+          layoutChanging(false) {
+}
+
+void PaneFilterModel::setSourceModel(QAbstractItemModel* model) {
+    beginResetModel();
+    if (sourceModel()) {
+        disconnect(sourceModel(), nullptr, this, nullptr);
+    }
+    QAbstractProxyModel::setSourceModel(model);
+
+    root = QPersistentModelIndex();
+    names.clear();
+    visible.clear();
+
+    if (model) {
+        connect(model, &QAbstractItemModel::rowsInserted, this, &PaneFilterModel::sourceRowsInserted);
+        connect(model, &QAbstractItemModel::rowsRemoved, this, &PaneFilterModel::sourceRowsRemoved);
+        connect(model, &QAbstractItemModel::dataChanged, this, &PaneFilterModel::sourceDataChanged);
+        connect(model, &QAbstractItemModel::layoutAboutToBeChanged, this,
+                [this](const QList<QPersistentModelIndex>& parents) { sourceLayoutAboutToBeChanged(parents); });
+        connect(model, &QAbstractItemModel::layoutChanged, this,
+                [this](const QList<QPersistentModelIndex>& parents) { sourceLayoutChanged(parents); });
+        connect(model, &QAbstractItemModel::modelAboutToBeReset, this, [this]() { beginResetModel(); });
+        connect(model, &QAbstractItemModel::modelReset, this, [this]() {
+            names.clear();
+            visible.clear();
+            endResetModel();
+        });
+    }
+    endResetModel();
+}
+
+void PaneFilterModel::setSourceRoot(const QModelIndex& sourceIndex) {
+    beginResetModel();
+    root = sourceIndex;
+    loadNames();
+    visible = filterRows(nullptr);
+    endResetModel();
+}
+
+QModelIndex PaneFilterModel::sourceRoot() const {
+    return root;
+}
+
+QModelIndex PaneFilterModel::rootIndex() const {
+    return index(0, 0);
+}
+
+void PaneFilterModel::setFilter(const QString& newPattern, Mode newMode) {
+    // Appending to a pattern can only remove matches, so the previous result
+    // is the candidate set. Every mode matches anywhere in the name, which
+    // keeps that true for globs too, except while a [...] set is incomplete.
+    const bool refine = newMode == mode && !pattern.isEmpty() && newPattern.startsWith(pattern)
+                        && (mode != Glob || !pattern.contains(QLatin1Char('[')));
+    pattern = newPattern;
+    mode = newMode;
+
+    QVector<int> matches = filterRows(refine ? &visible : nullptr);
+    beginResetModel();
+    visible.swap(matches);
+    endResetModel();
+}
+
+QString PaneFilterModel::filterPattern() const {
+    return pattern;
+}
+
+QModelIndex PaneFilterModel::index(int row, int column, const QModelIndex& parent) const {
+    if (column < 0 || column >= columnCount(parent)) {
+        return QModelIndex();
+    }
+    if (!parent.isValid()) {
+        return row == 0 ? createIndex(0, column, quintptr(RootLevel)) : QModelIndex();
+    }
+    if (parent.internalId() == RootLevel && row >= 0 && row < visible.size()) {
+        return createIndex(row, column, quintptr(EntryLevel));
+    }
+    return QModelIndex();
+}
+
+QModelIndex PaneFilterModel::parent(const QModelIndex& child) const {
+    if (child.isValid() && child.internalId() == EntryLevel) {
+        return createIndex(0, 0, quintptr(RootLevel));
+    }
+    return QModelIndex();
+}
+
+int PaneFilterModel::rowCount(const QModelIndex& parent) const {
+    if (parent.column() > 0) {
+        return 0;
+    }
+    if (!parent.isValid()) {
+        return sourceModel() ? 1 : 0;
+    }
+    return parent.internalId() == RootLevel ? int(visible.size()) : 0;
+}
+
+int PaneFilterModel::columnCount(const QModelIndex& parent) const {
+    Q_UNUSED(parent);
+    return sourceModel() ? sourceModel()->columnCount(root) : 0;
+}
+
+bool PaneFilterModel::hasChildren(const QModelIndex& parent) const {
+    return rowCount(parent) > 0;
+}
+
+QModelIndex PaneFilterModel::mapToSource(const QModelIndex& proxyIndex) const {
+    if (!proxyIndex.isValid() || !root.isValid()) {
+        return QModelIndex();
+    }
+    if (proxyIndex.internalId() == RootLevel) {
+        return root.sibling(root.row(), proxyIndex.column());
+    }
+    return sourceModel()->index(visible.at(proxyIndex.row()), proxyIndex.column(), root);
+}
+
+QModelIndex PaneFilterModel::mapFromSource(const QModelIndex& sourceIndex) const {
+    if (!sourceIndex.isValid() || !root.isValid()) {
+        return QModelIndex();
+    }
+
+    const QModelIndex sourceParent = sourceIndex.parent();
+    if (sourceParent == root) {
+        const int row = proxyRow(sourceIndex.row());
+        return row < 0 ? QModelIndex() : createIndex(row, sourceIndex.column(), quintptr(EntryLevel));
+    }
+    if (sourceParent == root.parent() && sourceIndex.row() == root.row()) {
+        return createIndex(0, sourceIndex.column(), quintptr(RootLevel));
+    }
+    return QModelIndex();
+}
+
+bool PaneFilterModel::matchesFuzzy(QStringView name, QStringView pattern) {
+    // Every character of the pattern, in order, with anything in between.
+    qsizetype position = 0;
+    for (QChar character: pattern) {
+        position = name.indexOf(character, position);
+        if (position < 0) {
+            return false;
+        }
+        ++position;
+    }
+    return true;
+}
+
+void PaneFilterModel::loadNames() {
+    names.clear();
+    if (!root.isValid()) {
+        return;
+    }
+
+    const int count = sourceModel()->rowCount(root);
+    names.resize(count);
+    for (int row = 0; row < count; ++row) {
+        names[row] = sourceModel()->index(row, 0, root).data().toString().toCaseFolded();
+    }
+}
+
+QVector<int> PaneFilterModel::filterRows(const QVector<int>* candidates) const {
+    const int count = candidates ? int(candidates->size()) : int(names.size());
+    auto rowAt = [candidates](int i) { return candidates ? candidates->at(i) : i; };
+
+    QVector<int> matches;
+    if (pattern.isEmpty()) {
+        matches.reserve(count);
+        for (int i = 0; i < count; ++i) {
+            matches.append(rowAt(i));
+        }
+        return matches;
+    }
+
+    const QString folded = pattern.toCaseFolded();
+    QRegularExpression glob;
+    if (mode == Glob) {
+        glob.setPattern(QRegularExpression::wildcardToRegularExpression(
+                folded, QRegularExpression::UnanchoredWildcardConversion));
+        glob.optimize();
+    }
+
+    for (int i = 0; i < count; ++i) {
+        const int row = rowAt(i);
+        const QString& name = names.at(row);
+
+        bool accepted;
+        if (name == QLatin1String("..")) {
+            // The way back up stays visible whatever the filter says.
+            accepted = true;
+        } else if (mode == Substring) {
+            accepted = name.contains(folded);
+        } else if (mode == Glob) {
+            accepted = glob.match(name).hasMatch();
+        } else {
+            accepted = matchesFuzzy(name, folded);
+        }
+
+        if (accepted) {
+            matches.append(row);
+        }
+    }
+    return matches;
+}
+
+int PaneFilterModel::proxyRow(int sourceRow) const {
+    auto found = std::lower_bound(visible.begin(), visible.end(), sourceRow);
+    return found != visible.end() && *found == sourceRow ? int(found - visible.begin()) : -1;
+}
+
+void PaneFilterModel::sourceRowsInserted(const QModelIndex& parent, int first, int last) {
+    if (!root.isValid() || parent != root) {
+        return;
+    }
+
+    // Entries already shown keep their place; their source rows move down.
+    const int count = last - first + 1;
+    names.insert(first, count, QString());
+    for (int row = first; row <= last; ++row) {
+        names[row] = sourceModel()->index(row, 0, root).data().toString().toCaseFolded();
+    }
+    for (int& row: visible) {
+        if (row >= first) {
+            row += count;
+        }
+    }
+
+    QVector<int> candidates;
+    candidates.reserve(count);
+    for (int row = first; row <= last; ++row) {
+        candidates.append(row);
+    }
+    const QVector<int> matches = filterRows(&candidates);
+    if (matches.isEmpty()) {
+        return;
+    }
+
+    const int position = int(std::lower_bound(visible.begin(), visible.end(), first) - visible.begin());
+    beginInsertRows(rootIndex(), position, position + int(matches.size()) - 1);
+    visible.insert(position, matches.size(), 0);
+    std::copy(matches.begin(), matches.end(), visible.begin() + position);
+    endInsertRows();
+}
+
+void PaneFilterModel::sourceRowsRemoved(const QModelIndex& parent, int first, int last) {
+    if (!root.isValid() || parent != root) {
+        return;
+    }
+
+    const int count = last - first + 1;
+    const int begin = int(std::lower_bound(visible.begin(), visible.end(), first) - visible.begin());
+    const int end = int(std::lower_bound(visible.begin(), visible.end(), last + 1) - visible.begin());
+    if (begin < end) {
+        beginRemoveRows(rootIndex(), begin, end - 1);
+        visible.remove(begin, end - begin);
+        endRemoveRows();
+    }
+
+    names.remove(first, count);
+    for (int i = begin; i < visible.size(); ++i) {
+        visible[i] -= count;
+    }
+}
+
+void PaneFilterModel::sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents) {
+    if (!root.isValid() || (!parents.isEmpty() && !parents.contains(root))) {
+        return;
+    }
+
+    // A re-sort moves every source row, so the names are read again; items
+    // the view holds on to are carried over through their source indexes.
+    layoutChanging = true;
+    emit layoutAboutToBeChanged();
+    layoutProxyIndexes = persistentIndexList();
+    layoutSourceIndexes.clear();
+    for (const QModelIndex& proxyIndex: layoutProxyIndexes) {
+        layoutSourceIndexes.append(QPersistentModelIndex(mapToSource(proxyIndex)));
+    }
+}
+
+void PaneFilterModel::sourceLayoutChanged(const QList<QPersistentModelIndex>& parents) {
+    Q_UNUSED(parents);
+    if (!layoutChanging) {
+        return;
+    }
+    layoutChanging = false;
+
+    loadNames();
+    visible = filterRows(nullptr);
+
+    QModelIndexList updated;
+    updated.reserve(layoutSourceIndexes.size());
+    for (const QPersistentModelIndex& sourceIndex: layoutSourceIndexes) {
+        updated.append(mapFromSource(sourceIndex));
+    }
+    changePersistentIndexList(layoutProxyIndexes, updated);
+    layoutProxyIndexes.clear();
+    layoutSourceIndexes.clear();
+    emit layoutChanged();
+}
+
+void PaneFilterModel::sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight,
+                                        const QList<int>& roles) {
+    if (!root.isValid() || topLeft.parent() != root) {
+        return;
+    }
+
+    const int begin = int(std::lower_bound(visible.begin(), visible.end(), topLeft.row()) - visible.begin());
+    const int end = int(std::lower_bound(visible.begin(), visible.end(), bottomRight.row() + 1) - visible.begin());
+    if (begin < end) {
+        emit dataChanged(index(begin, topLeft.column(), rootIndex()),
+                         index(end - 1, bottomRight.column(), rootIndex()), roles);
+    }
+}
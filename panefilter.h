@@ -0,0 +1,75 @@
+#ifndef PANEFILTER_H
+#define PANEFILTER_H
+
+#include <QAbstractProxyModel>
+#include <QPersistentModelIndex>
+#include <QString>
+#include <QVector>
+
+// Narrows the listing of one directory to the names matching a filter.
+//
+// The proxy keeps the shape the list views expect: a single root item that
+// stands for the listed directory, with the matching entries below it, so a
+// view shows it with setRootIndex(rootIndex()) just like the file system
+// model. Names are case-folded once when the directory is attached; after
+// that, typing another character only re-tests the entries that matched
+// the previous pattern, so each keystroke gets cheaper as the list narrows.
+class PaneFilterModel : public QAbstractProxyModel {
+    Q_OBJECT
+
+public:
+    enum Mode {
+        Substring,
+        Glob,
+        Fuzzy
+    };
+
+    explicit PaneFilterModel(QObject *parent = nullptr);
+
+    void setSourceModel(QAbstractItemModel* model) override;
+    void setSourceRoot(const QModelIndex& root);
+    QModelIndex sourceRoot() const;
+    QModelIndex rootIndex() const;
+
+    void setFilter(const QString& pattern, Mode mode);
+    QString filterPattern() const;
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    bool hasChildren(const QModelIndex& parent = QModelIndex()) const override;
+
+    QModelIndex mapToSource(const QModelIndex& proxyIndex) const override;
+    QModelIndex mapFromSource(const QModelIndex& sourceIndex) const override;
+
+    static bool matchesFuzzy(QStringView name, QStringView pattern);
+
+private:
+    enum Level : quintptr {
+        RootLevel,
+        EntryLevel
+    };
+
+    void loadNames();
+    QVector<int> filterRows(const QVector<int>* candidates) const;
+    int proxyRow(int sourceRow) const;
+
+    void sourceRowsInserted(const QModelIndex& parent, int first, int last);
+    void sourceRowsRemoved(const QModelIndex& parent, int first, int last);
+    void sourceLayoutAboutToBeChanged(const QList<QPersistentModelIndex>& parents);
+    void sourceLayoutChanged(const QList<QPersistentModelIndex>& parents);
+    void sourceDataChanged(const QModelIndex& topLeft, const QModelIndex& bottomRight, const QList<int>& roles);
+
+    QPersistentModelIndex root;
+    QVector<QString> names;
+    QVector<int> visible;
+    QString pattern;
+    Mode mode;
+
+    bool layoutChanging;
+    QModelIndexList layoutProxyIndexes;
+    QList<QPersistentModelIndex> layoutSourceIndexes;
+};
+
+#endif // PANEFILTER_H
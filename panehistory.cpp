@@ -0,0 +1,48 @@
+#include "panehistory.h"
+
+
+PaneHistory::PaneHistory()
+        : snapshots(maxSnapshotEntries) {
+}
+
+void PaneHistory::visit(const HistoryEntry& left) {
+    // Leaving the same directory twice in a row is one step back, not two.
+    if (!backEntries.isEmpty() && backEntries.last().path == left.path) {
+        backEntries.last() = left;
+    } else {
+        backEntries.append(left);
+    }
+    if (backEntries.size() > maxEntries) {
+        backEntries.removeFirst();
+    }
+    forwardEntries.clear();
+}
+
+bool PaneHistory::canGoBack() const {
+    return !backEntries.isEmpty();
+}
+
+bool PaneHistory::canGoForward() const {
+    return !forwardEntries.isEmpty();
+}
+
+HistoryEntry PaneHistory::goBack(const HistoryEntry& current) {
+    forwardEntries.append(current);
+    return backEntries.takeLast();
+}
+
+HistoryEntry PaneHistory::goForward(const HistoryEntry& current) {
+    backEntries.append(current);
+    return forwardEntries.takeLast();
+}
+
+void PaneHistory::storeSnapshot(const PaneSnapshot& snapshot) {
+    if (snapshot.listRoot.isEmpty()) {
+        return;
+    }
+    snapshots.insert(snapshot.listRoot, new PaneSnapshot(snapshot), 1 + int(snapshot.entries.size()));
+}
+
+const PaneSnapshot* PaneHistory::snapshot(const QString& path) {
+    return snapshots.object(path);
+}
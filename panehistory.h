@@ -0,0 +1,46 @@
+#ifndef PANEHISTORY_H
+#define PANEHISTORY_H
+
+#include <QCache>
+#include <QString>
+#include <QVector>
+
+#include "listingsnapshot.h"
+
+// Where a pane was, and how far it was scrolled, when it was left.
+struct HistoryEntry {
+    QString path;
+    int scrollPosition = 0;
+    QString currentName;
+};
+
+// Back/forward history of one pane.
+//
+// Next to the list of places, the listings of the most recently left
+// directories are kept as PaneSnapshots, in the order they were sorted in,
+// so going back can paint the old listing at once while the directory is
+// read again in the background. Snapshots are evicted least recently used
+// first once they hold more than maxSnapshotEntries entries between them.
+class PaneHistory {
+public:
+    static constexpr int maxEntries = 100;
+    static constexpr int maxSnapshotEntries = 200000;
+
+    PaneHistory();
+
+    void visit(const HistoryEntry& left);
+    bool canGoBack() const;
+    bool canGoForward() const;
+    HistoryEntry goBack(const HistoryEntry& current);
+    HistoryEntry goForward(const HistoryEntry& current);
+
+    void storeSnapshot(const PaneSnapshot& snapshot);
+    const PaneSnapshot* snapshot(const QString& path);
+
+private:
+    QVector<HistoryEntry> backEntries;
+    QVector<HistoryEntry> forwardEntries;
+    QCache<QString, PaneSnapshot> snapshots;
+};
+
+#endif // PANEHISTORY_H
@@ -0,0 +1,387 @@
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PATHINDEX_HAVE_SSE2
+#endif
+
+#include "pathindex.h"
+
+
+// Zero bytes kept after the last name, so that a 16-byte load starting
+// anywhere inside a name stays within the pool.
+static const int namePadding = 16;
+// Progress is reported every so many paths, or every so many milliseconds
+// while a slow disk delivers fewer.
+static const int progressInterval = 65536;
+static const int progressMilliseconds = 100;
+// Searches over fewer entries than this are not worth handing to threads.
+static const int entriesPerChunk = 32768;
+
+// The pattern as UTF-8, without spaces, in both ASCII cases. Bytes of
+// other characters match exactly.
+struct Needle {
+    QByteArray lower;
+    QByteArray upper;
+    int length;
+};
+
+static Needle makeNeedle(const QString& pattern) {
+    QByteArray bytes;
+    for (char byte: pattern.toUtf8()) {
+        if (byte != ' ') {
+            bytes.append(byte);
+        }
+    }
+    // Directory progress is counted in a byte per directory.
+    bytes.truncate(255);
+    return {bytes.toLower(), bytes.toUpper(), int(bytes.size())};
+}
+
+// Matches the pattern from character `matched` on against name, taking the
+// leftmost occurrence of each character, and returns how far it got. Taking
+// the leftmost occurrence never misses a match that exists.
+static int consume(const char* name, int length, const Needle& needle, int matched) {
+    int position = 0;
+    while (matched < needle.length && position < length) {
+        const char lower = needle.lower.at(matched);
+        const char upper = needle.upper.at(matched);
+        int found = -1;
+
+#ifdef PATHINDEX_HAVE_SSE2
+        // Most names fit into one 16-byte block, so this is usually a single
+        // compare per pattern character; bits past the name are masked off.
+        const __m128i lowerBytes = _mm_set1_epi8(lower);
+        const __m128i upperBytes = _mm_set1_epi8(upper);
+        for (; position < length; position += 16) {
+            const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(name + position));
+            uint mask = uint(_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, lowerBytes),
+                                                            _mm_cmpeq_epi8(block, upperBytes))));
+            if (length - position < 16) {
+                mask &= (1u << (length - position)) - 1;
+            }
+            if (mask) {
+                found = position + int(qCountTrailingZeroBits(mask));
+                break;
+            }
+        }
+#else
+        for (; position < length; ++position) {
+            if (name[position] == lower || name[position] == upper) {
+                found = position;
+                break;
+            }
+        }
+#endif
+
+        if (found < 0) {
+            break;
+        }
+        position = found + 1;
+        ++matched;
+    }
+    return matched;
+}
+
+static int findRun(const char* name, int length, const Needle& needle) {
+    for (int start = 0; start + needle.length <= length; ++start) {
+        int i = 0;
+        while (i < needle.length && (name[start + i] == needle.lower.at(i) || name[start + i] == needle.upper.at(i))) {
+            ++i;
+        }
+        if (i == needle.length) {
+            return start;
+        }
+    }
+    return -1;
+}
+
+// Higher is better: the whole pattern as one run in the name beats the
+// pattern spread over the name, which beats a match that needs the
+// directories too. Shallow and short paths win ties.
+static int score(const char* name, int length, const Needle& needle, int depth) {
+    int result = 0;
+    const int run = findRun(name, length, needle);
+    if (run == 0) {
+        result = 3000;
+    } else if (run > 0) {
+        const char before = name[run - 1];
+        result = before == '.' || before == '_' || before == '-' || before == ' ' ? 2500 : 2000;
+    } else if (consume(name, length, needle, 0) == needle.length) {
+        result = 1000;
+    }
+    return result - depth * 16 - length;
+}
+
+static bool isBetter(const PathIndex::Match& first, const PathIndex::Match& second) {
+    return first.score != second.score ? first.score > second.score : first.entry < second.entry;
+}
+
+static void listDirectory(const QByteArray& path, QVector<QPair<QByteArray, bool>>& children) {
+#ifdef Q_OS_UNIX
+    DIR* directory = ::opendir(path.constData());
+    if (!directory) {
+        return;
+    }
+    while (const dirent* entry = ::readdir(directory)) {
+        const char* name = entry->d_name;
+        if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+            continue;
+        }
+
+        // Links are never followed, so a link loop cannot make the walk
+        // endless.
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN) {
+            struct stat info;
+            isDir = ::fstatat(::dirfd(directory), name, &info, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(info.st_mode);
+        }
+        children.append({QByteArray(name), isDir});
+    }
+    ::closedir(directory);
+#else
+    const QFileInfoList entries = QDir(QFile::decodeName(path)).entryInfoList(
+            QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& entry: entries) {
+        children.append({QFile::encodeName(entry.fileName()), entry.isDir() && !entry.isSymLink()});
+    }
+#endif
+}
+
+
+PathIndex::PathIndex(QObject *parent)
+        : QObject(parent),
+          worker(nullptr),
+          cancelled(false),
+          building(false) {
+}
+
+PathIndex::~PathIndex() {
+    cancel();
+}
+
+void PathIndex::start(const QString& rootPath) {
+    cancel();
+
+    {
+        QMutexLocker locker(&mutex);
+        entries.clear();
+        directories.clear();
+        names = QByteArray(namePadding, '\0');
+    }
+    root = rootPath;
+    building = true;
+
+    worker = QThread::create([this]() { run(); });
+    worker->start(QThread::LowPriority);
+}
+
+void PathIndex::clear() {
+    cancel();
+    QMutexLocker locker(&mutex);
+    entries.clear();
+    entries.squeeze();
+    directories.clear();
+    directories.squeeze();
+    names.clear();
+    names.squeeze();
+    root.clear();
+}
+
+void PathIndex::cancel() {
+    if (!worker) {
+        return;
+    }
+    cancelled = true;
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    cancelled = false;
+    building = false;
+}
+
+QString PathIndex::rootPath() const {
+    return root;
+}
+
+bool PathIndex::isBuilding() const {
+    return building;
+}
+
+int PathIndex::size() const {
+    QMutexLocker locker(&mutex);
+    return int(entries.size());
+}
+
+QVector<PathIndex::Match> PathIndex::search(const QString& pattern, int limit) const {
+    const Needle needle = makeNeedle(pattern);
+    if (needle.length == 0 || limit <= 0) {
+        return {};
+    }
+
+    QMutexLocker locker(&mutex);
+    const Entry* table = entries.constData();
+    const char* pool = names.constData();
+    const int count = int(entries.size());
+
+    // How much of the pattern each directory's path covers. Parents come
+    // first, so one pass in index order sees every parent before its
+    // children; a '/' in the pattern matches the separator after the name.
+    QVector<quint8> covered(count, 0);
+    for (int directory: directories) {
+        const Entry& entry = table[directory];
+        int matched = entry.parent < 0 ? 0 : covered[entry.parent];
+        matched = consume(pool + entry.nameOffset, entry.nameLength, needle, matched);
+        if (matched < needle.length && needle.lower.at(matched) == '/') {
+            ++matched;
+        }
+        covered[directory] = quint8(matched);
+    }
+
+    // Each chunk keeps its own best `limit` matches in a heap whose top is
+    // the worst of them; the chunks' results are merged at the end.
+    const int chunkCount = qBound(1, count / entriesPerChunk, QThread::idealThreadCount() * 4);
+    QVector<QVector<Match>> chunkMatches(chunkCount);
+    auto searchChunk = [&](int chunk) {
+        const int begin = int(qint64(count) * chunk / chunkCount);
+        const int end = int(qint64(count) * (chunk + 1) / chunkCount);
+        QVector<Match>& best = chunkMatches[chunk];
+
+        for (int i = begin; i < end; ++i) {
+            const Entry& entry = table[i];
+            const char* name = pool + entry.nameOffset;
+            const int matched = entry.parent < 0 ? 0 : covered[entry.parent];
+            if (matched < needle.length && consume(name, entry.nameLength, needle, matched) < needle.length) {
+                continue;
+            }
+
+            const Match match = {i, score(name, entry.nameLength, needle, entry.depth)};
+            if (best.size() < limit) {
+                best.append(match);
+                std::push_heap(best.begin(), best.end(), isBetter);
+            } else if (isBetter(match, best.front())) {
+                std::pop_heap(best.begin(), best.end(), isBetter);
+                best.back() = match;
+                std::push_heap(best.begin(), best.end(), isBetter);
+            }
+        }
+    };
+
+    if (chunkCount == 1) {
+        searchChunk(0);
+    } else {
+        QSemaphore done;
+        for (int chunk = 0; chunk < chunkCount; ++chunk) {
+            QThreadPool::globalInstance()->start([&searchChunk, &done, chunk]() {
+                searchChunk(chunk);
+                done.release();
+            });
+        }
+        done.acquire(chunkCount);
+    }
+
+    QVector<Match> matches;
+    for (const QVector<Match>& best: chunkMatches) {
+        matches += best;
+    }
+    std::sort(matches.begin(), matches.end(), isBetter);
+    if (matches.size() > limit) {
+        matches.resize(limit);
+    }
+    return matches;
+}
+
+QString PathIndex::path(int entry) const {
+    return QDir(root).filePath(relativePath(entry));
+}
+
+QString PathIndex::relativePath(int entry) const {
+    QMutexLocker locker(&mutex);
+    QByteArray path;
+    for (int i = entry; i >= 0; i = entries.at(i).parent) {
+        const Entry& current = entries.at(i);
+        const QByteArray name(names.constData() + current.nameOffset, current.nameLength);
+        path = path.isEmpty() ? name : name + '/' + path;
+    }
+    return QFile::decodeName(path);
+}
+
+bool PathIndex::isDirectory(int entry) const {
+    QMutexLocker locker(&mutex);
+    return entries.at(entry).flags & DirectoryFlag;
+}
+
+QVector<int> PathIndex::filesSince(int& next) const {
+    QMutexLocker locker(&mutex);
+    QVector<int> files;
+    for (; next < entries.size(); ++next) {
+        if (!(entries.at(next).flags & DirectoryFlag)) {
+            files.append(next);
+        }
+    }
+    return files;
+}
+
+void PathIndex::run() {
+    // Depth first, which keeps the list of directories still to read short.
+    QVector<Pending> stack;
+    stack.append({-1, QFile::encodeName(root)});
+    int reported = 0;
+    QElapsedTimer sinceReport;
+    sinceReport.start();
+
+    while (!stack.isEmpty() && !cancelled) {
+        const Pending directory = stack.takeLast();
+        QVector<QPair<QByteArray, bool>> children;
+        listDirectory(directory.path, children);
+        append(directory.entry, children, stack, directory.path);
+
+        const int indexed = int(entries.size());
+        if (indexed - reported >= progressInterval
+            || (indexed > reported && sinceReport.elapsed() >= progressMilliseconds)) {
+            reported = indexed;
+            sinceReport.restart();
+            emit progress(indexed);
+        }
+    }
+
+    building = false;
+    emit progress(int(entries.size()));
+    emit finished();
+}
+
+void PathIndex::append(int parent, const QVector<QPair<QByteArray, bool>>& children, QVector<Pending>& stack,
+                       const QByteArray& parentPath) {
+    // Only this thread changes the tables, so it may read them unlocked.
+    const quint8 depth = parent < 0 ? 0 : quint8(qMin(255, entries.at(parent).depth + 1));
+    const QByteArray prefix = parentPath.endsWith('/') ? parentPath : parentPath + '/';
+
+    QMutexLocker locker(&mutex);
+    names.chop(namePadding);
+    for (const auto& child: children) {
+        const int index = int(entries.size());
+        const quint16 length = quint16(qMin(child.first.size(), qsizetype(0xffff)));
+        entries.append({parent, quint32(names.size()), length, depth, quint8(child.second ? DirectoryFlag : 0)});
+        names.append(child.first.constData(), length);
+        if (child.second) {
+            directories.append(index);
+            stack.append({index, prefix + child.first});
+        }
+    }
+    names.append(QByteArray(namePadding, '\0'));
+}
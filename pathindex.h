@@ -0,0 +1,87 @@
+#ifndef PATHINDEX_H
+#define PATHINDEX_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+
+// In-memory index of every path below a root, built on a background thread,
+// for the "go to file" palette.
+//
+// Paths are not stored as strings. Every entry keeps its parent's entry
+// number and its own name, which lives in one shared byte pool, so a
+// directory's path is stored once however many entries it holds; an entry
+// costs twelve bytes plus its name. Parents always come before their
+// children, which lets a search decide how much of the pattern each
+// directory's path already covers in one pass, and then test every entry
+// against its own name only.
+class PathIndex : public QObject {
+    Q_OBJECT
+
+public:
+    struct Match {
+        int entry;
+        int score;
+    };
+
+    explicit PathIndex(QObject *parent = nullptr);
+    ~PathIndex();
+
+    void start(const QString& rootPath);
+    void cancel();
+    void clear();
+
+    QString rootPath() const;
+    bool isBuilding() const;
+    int size() const;
+
+    QVector<Match> search(const QString& pattern, int limit) const;
+    QString path(int entry) const;
+    QString relativePath(int entry) const;
+    bool isDirectory(int entry) const;
+    QVector<int> filesSince(int& next) const;
+
+signals:
+    void progress(int paths);
+    void finished();
+
+private:
+    enum EntryFlag : quint8 {
+        DirectoryFlag = 1
+    };
+
+    struct Entry {
+        qint32 parent;
+        quint32 nameOffset;
+        quint16 nameLength;
+        quint8 depth;
+        quint8 flags;
+    };
+
+    struct Pending {
+        int entry;
+        QByteArray path;
+    };
+
+    void run();
+    void append(int parent, const QVector<QPair<QByteArray, bool>>& children, QVector<Pending>& stack,
+                const QByteArray& parentPath);
+
+    QString root;
+    QThread *worker;
+    std::atomic<bool> cancelled;
+    std::atomic<bool> building;
+
+    mutable QMutex mutex;
+    QVector<Entry> entries;
+    QVector<int> directories;
+    QByteArray names;
+};
+
+#endif // PATHINDEX_H
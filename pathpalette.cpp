@@ -0,0 +1,105 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QKeyEvent>
+#include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
+#include <QVBoxLayout>
+
+#include "pathpalette.h"
+#include "pathindex.h"
+
+
+PathPalette::PathPalette(PathIndex* index, QWidget *parent)
+        : QDialog(parent),
+          index(index) {
+    setWindowTitle(tr("Go to File"));
+    resize(700, 450);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+
+    patternEdit = new QLineEdit(this);
+    patternEdit->setPlaceholderText(tr("Type part of a path"));
+    patternEdit->installEventFilter(this);
+    layout->addWidget(patternEdit);
+
+    resultList = new QListWidget(this);
+    resultList->setUniformItemSizes(true);
+    layout->addWidget(resultList);
+
+    statusLabel = new QLabel(this);
+    layout->addWidget(statusLabel);
+
+    connect(patternEdit, &QLineEdit::textChanged, this, &PathPalette::updateResults);
+    connect(patternEdit, &QLineEdit::returnPressed, this, &PathPalette::choose);
+    connect(resultList, &QListWidget::itemActivated, this, &PathPalette::choose);
+    connect(index, &PathIndex::progress, this, [this]() {
+        // Paths found since the last keystroke may match too.
+        if (!patternEdit->text().isEmpty()) {
+            updateResults();
+        }
+        updateStatus();
+    });
+    connect(index, &PathIndex::finished, this, &PathPalette::updateStatus);
+
+    updateStatus();
+}
+
+QString PathPalette::chosenPath() const {
+    return chosen;
+}
+
+bool PathPalette::eventFilter(QObject *watched, QEvent *event) {
+    // The cursor keys move through the results while typing goes on.
+    if (watched == patternEdit && event->type() == QEvent::KeyPress) {
+        const int key = static_cast<QKeyEvent*>(event)->key();
+        if (key == Qt::Key_Up || key == Qt::Key_Down || key == Qt::Key_PageUp || key == Qt::Key_PageDown) {
+            QCoreApplication::sendEvent(resultList, event);
+            return true;
+        }
+    }
+    return QDialog::eventFilter(watched, event);
+}
+
+void PathPalette::updateResults() {
+    QElapsedTimer timer;
+    timer.start();
+
+    const QVector<PathIndex::Match> matches = index->search(patternEdit->text(), maxResults);
+    const qint64 searchTime = timer.elapsed();
+
+    resultList->clear();
+    for (const PathIndex::Match& match: matches) {
+        QString text = index->relativePath(match.entry);
+        if (index->isDirectory(match.entry)) {
+            text += '/';
+        }
+        auto item = new QListWidgetItem(text, resultList);
+        item->setData(Qt::UserRole, index->path(match.entry));
+    }
+    if (resultList->count() > 0) {
+        resultList->setCurrentRow(0);
+    }
+
+    statusLabel->setText(tr("%1 matches shown, search took %2 ms").arg(matches.size()).arg(searchTime));
+    if (index->isBuilding()) {
+        updateStatus();
+    }
+}
+
+void PathPalette::updateStatus() {
+    if (index->isBuilding()) {
+        statusLabel->setText(tr("Indexing %1 ... %2 paths so far").arg(index->rootPath()).arg(index->size()));
+    } else if (patternEdit->text().isEmpty()) {
+        statusLabel->setText(tr("%1 paths under %2").arg(index->size()).arg(index->rootPath()));
+    }
+}
+
+void PathPalette::choose() {
+    QListWidgetItem* item = resultList->currentItem();
+    if (!item) {
+        return;
+    }
+    chosen = item->data(Qt::UserRole).toString();
+    accept();
+}
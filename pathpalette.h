@@ -0,0 +1,40 @@
+#ifndef PATHPALETTE_H
+#define PATHPALETTE_H
+
+#include <QDialog>
+
+class QLabel;
+class QLineEdit;
+class QListWidget;
+class PathIndex;
+
+// "Go to file" palette: fuzzy-matches what is typed against every path in a
+// PathIndex and returns the one picked. Results follow each keystroke, and
+// while the index is still being built they are refreshed as it grows.
+class PathPalette : public QDialog {
+    Q_OBJECT
+
+public:
+    static constexpr int maxResults = 200;
+
+    explicit PathPalette(PathIndex* index, QWidget *parent = nullptr);
+
+    QString chosenPath() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void updateResults();
+    void updateStatus();
+    void choose();
+
+private:
+    PathIndex* index;
+    QLineEdit* patternEdit;
+    QListWidget* resultList;
+    QLabel* statusLabel;
+    QString chosen;
+};
+
+#endif // PATHPALETTE_H
@@ -0,0 +1,262 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStorageInfo>
+#include <QThreadPool>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#endif
+
+#include "preflight.h"
+#include "ioscheduler.h"
+#include "uringbackend.h"
+
+
+namespace {
+
+// Shared by all tasks of one walk; each directory found is a task of its
+// own in the same pool.
+struct Walk {
+    QThreadPool pool;
+    std::atomic<qint64> bytes{0};
+    std::atomic<qint64> files{0};
+    std::atomic<qint64> directories{0};
+    QMutex linkMutex;
+    QSet<QPair<quint64, quint64>> linkedInodes;
+
+    void addFile(quint64 device, quint64 inode, quint64 links, qint64 size) {
+        if (links > 1) {
+            QMutexLocker locker(&linkMutex);
+            if (linkedInodes.contains({device, inode})) {
+                return;
+            }
+            linkedInodes.insert({device, inode});
+        }
+        ++files;
+        bytes += size;
+    }
+
+    void addDirectory(const QString& path) {
+        ++directories;
+        pool.start([this, path]() { list(path); });
+    }
+
+    void list(const QString& directory) {
+#ifdef Q_OS_UNIX
+        DIR* handle = ::opendir(QFile::encodeName(directory).constData());
+        if (!handle) {
+            return;
+        }
+        const int fd = ::dirfd(handle);
+        QVector<QByteArray> names;
+        while (const dirent* entry = ::readdir(handle)) {
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            names.append(QByteArray(name));
+        }
+
+        // io_uring stats the directory in batches when it can.
+        QVector<UringBackend::EntryStatus> statuses;
+        if (!UringBackend::statEntries(fd, names, statuses)) {
+            statuses.fill(UringBackend::EntryStatus(), names.size());
+            for (int i = 0; i < names.size(); ++i) {
+                struct stat info;
+                if (::fstatat(fd, names.at(i).constData(), &info, AT_SYMLINK_NOFOLLOW) == 0) {
+                    UringBackend::EntryStatus& status = statuses[i];
+                    status.size = qint64(info.st_size);
+                    status.mode = info.st_mode;
+                    status.inode = quint64(info.st_ino);
+                    status.device = quint64(info.st_dev);
+                    status.links = uint(info.st_nlink);
+                }
+            }
+        }
+        ::closedir(handle);
+
+        for (int i = 0; i < names.size(); ++i) {
+            const UringBackend::EntryStatus& status = statuses.at(i);
+            if (status.size < 0) {
+                continue;
+            }
+            if (S_ISDIR(status.mode)) {
+                addDirectory(QDir(directory).filePath(QFile::decodeName(names.at(i))));
+            } else {
+                // Links and special files are recreated, not read.
+                addFile(status.device, status.inode, status.links, S_ISREG(status.mode) ? status.size : 0);
+            }
+        }
+#else
+        QDirIterator it(directory, QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+        while (it.hasNext()) {
+            it.next();
+            const QFileInfo info = it.fileInfo();
+            if (info.isDir() && !info.isSymLink()) {
+                addDirectory(info.filePath());
+            } else {
+                addFile(0, 0, 1, info.isSymLink() ? 0 : info.size());
+            }
+        }
+#endif
+    }
+};
+
+}
+
+
+Preflight::Totals Preflight::measure(const QStringList& paths) {
+    Totals totals;
+    if (paths.isEmpty()) {
+        return totals;
+    }
+
+    Walk walk;
+    // Listing is mostly seeks on a rotational disk, so it is not done in
+    // parallel there either.
+    walk.pool.setMaxThreadCount(IoScheduler::instance().device(paths.first()).concurrency);
+    for (const QString& path: paths) {
+        const QFileInfo info(path);
+        if (info.isDir() && !info.isSymLink()) {
+            walk.addDirectory(info.absoluteFilePath());
+        } else if (info.exists() || info.isSymLink()) {
+#ifdef Q_OS_UNIX
+            struct stat status;
+            if (::lstat(QFile::encodeName(path).constData(), &status) == 0) {
+                walk.addFile(quint64(status.st_dev), quint64(status.st_ino), quint64(status.st_nlink),
+                             S_ISREG(status.st_mode) ? qint64(status.st_size) : 0);
+            }
+#else
+            walk.addFile(0, 0, 1, info.isSymLink() ? 0 : info.size());
+#endif
+        }
+    }
+    walk.pool.waitForDone();
+
+    totals.bytes = walk.bytes;
+    totals.files = walk.files;
+    totals.directories = walk.directories;
+    return totals;
+}
+
+qint64 Preflight::freeSpace(const QString& path) {
+    // The destination of a copy usually does not exist yet.
+    QFileInfo info(path);
+    while (!info.exists() && !info.isRoot()) {
+        const QString parent = info.absolutePath();
+        if (parent == info.absoluteFilePath()) {
+            break;
+        }
+        info.setFile(parent);
+    }
+#ifdef Q_OS_UNIX
+    struct statvfs status;
+    if (::statvfs(QFile::encodeName(info.absoluteFilePath()).constData(), &status) != 0) {
+        return -1;
+    }
+    // f_bavail leaves out the blocks reserved for root.
+    return qint64(status.f_bavail) * qint64(status.f_frsize);
+#else
+    const QStorageInfo storage(info.absoluteFilePath());
+    return storage.isValid() ? storage.bytesAvailable() : -1;
+#endif
+}
+
+
+static std::atomic<quint64> nextProgressSerial(0);
+
+// The ring a thread reports into, claimed on its first file and found
+// again by the serial of the progress, which unlike its address is never
+// reused.
+struct ProducerSlot {
+    quint64 serial = 0;
+    int ring = -1;
+};
+static thread_local ProducerSlot producerSlot;
+
+TransferProgress::TransferProgress(qint64 totalBytes, qint64 totalFiles)
+        : totalBytes(totalBytes),
+          doneBytes(0),
+          totalFileCount(totalFiles),
+          doneFileCount(0),
+          serial(++nextProgressSerial),
+          producers(0) {
+    timer.start();
+}
+
+void TransferProgress::setTotal(qint64 bytes, qint64 files) {
+    totalBytes = bytes;
+    totalFileCount = files;
+}
+
+void TransferProgress::start() {
+    doneBytes = 0;
+    doneFileCount = 0;
+    timer.restart();
+}
+
+void TransferProgress::add(qint64 bytes) {
+    doneBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void TransferProgress::fileDone(const QString& path) {
+    doneFileCount.fetch_add(1, std::memory_order_relaxed);
+    if (producerSlot.serial != serial) {
+        producerSlot.serial = serial;
+        const int ring = producers.fetch_add(1, std::memory_order_relaxed);
+        producerSlot.ring = ring < maxProducers ? ring : -1;
+    }
+    if (producerSlot.ring >= 0) {
+        finishedFiles[producerSlot.ring].push(path);
+    }
+}
+
+qint64 TransferProgress::total() const {
+    return totalBytes;
+}
+
+qint64 TransferProgress::done() const {
+    return doneBytes;
+}
+
+qint64 TransferProgress::totalFiles() const {
+    return totalFileCount;
+}
+
+qint64 TransferProgress::doneFiles() const {
+    return doneFileCount;
+}
+
+qint64 TransferProgress::remainingSeconds() const {
+    const qint64 elapsed = timer.elapsed();
+    const qint64 bytes = doneBytes;
+    // The first second is mostly opening files and filling caches.
+    if (elapsed < 1000 || bytes <= 0) {
+        return -1;
+    }
+    const qint64 left = qMax<qint64>(0, totalBytes - bytes);
+    return qint64(double(left) * double(elapsed) / double(bytes) / 1000.0);
+}
+
+QString TransferProgress::takeLatestFile() const {
+    // Draining the rings makes room for the next names; only the last one
+    // of each is worth showing.
+    QString latest;
+    const int rings = qMin<int>(producers.load(std::memory_order_acquire), maxProducers);
+    for (int ring = 0; ring < rings; ++ring) {
+        QString path;
+        while (finishedFiles[ring].pop(path)) {
+            latest = path;
+        }
+    }
+    return latest;
+}
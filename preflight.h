@@ -0,0 +1,74 @@
+#ifndef PREFLIGHT_H
+#define PREFLIGHT_H
+
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include <atomic>
+
+#include "progressring.h"
+
+// Sizes up a copy or move before anything is written.
+//
+// The selection is walked in parallel, one task per directory, in a thread
+// pool sized to what IoScheduler allows for the disk it is on, so the walk
+// costs about as long as listing the largest directory chain. Files with
+// several names are counted once, as the copy links rather than copies them.
+class Preflight {
+public:
+    struct Totals {
+        qint64 bytes = 0;
+        qint64 files = 0;
+        qint64 directories = 0;
+    };
+
+    static Totals measure(const QStringList& paths);
+
+    // Space available to unprivileged writers on the file system that holds
+    // path, or its nearest existing parent; -1 when it cannot be told.
+    static qint64 freeSpace(const QString& path);
+};
+
+// Bytes and files done out of those expected, shared between the threads
+// doing a transfer and the one showing it.
+//
+// Workers only touch atomics and, for the names of finished files, a ring
+// of their own, so reporting never takes a lock or posts an event however
+// many files there are. The GUI samples it on a timer.
+class TransferProgress {
+public:
+    explicit TransferProgress(qint64 totalBytes = 0, qint64 totalFiles = 0);
+
+    void setTotal(qint64 bytes, qint64 files = 0);
+    void start();
+    void add(qint64 bytes);
+    // Called by the thread that finished the file.
+    void fileDone(const QString& path);
+
+    qint64 total() const;
+    qint64 done() const;
+    qint64 totalFiles() const;
+    qint64 doneFiles() const;
+    // Seconds left at the average rate so far; -1 until there is a rate.
+    qint64 remainingSeconds() const;
+    // One of the latest files finished since the previous call, or nothing;
+    // for one consumer thread only.
+    QString takeLatestFile() const;
+
+private:
+    // Threads past this many still count, but their file names are not
+    // passed on.
+    static constexpr int maxProducers = 64;
+
+    std::atomic<qint64> totalBytes;
+    std::atomic<qint64> doneBytes;
+    std::atomic<qint64> totalFileCount;
+    std::atomic<qint64> doneFileCount;
+    QElapsedTimer timer;
+
+    const quint64 serial;
+    std::atomic<int> producers;
+    mutable ProgressRing<QString, 16> finishedFiles[maxProducers];
+};
+
+#endif // PREFLIGHT_H
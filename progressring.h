@@ -0,0 +1,48 @@
+#ifndef PROGRESSRING_H
+#define PROGRESSRING_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+// A fixed-size queue between exactly one producer thread and one consumer
+// thread, without locks: each side only writes its own index, and the
+// release/acquire pair on it hands over the slots in between.
+//
+// A full ring refuses the value instead of waiting, so a producer never
+// slows down for a consumer that is behind; what is lost is a report, not
+// work.
+template<typename T, int Capacity>
+class ProgressRing {
+public:
+    // Producer side.
+    bool push(const T& value) {
+        const quint32 head = headIndex.load(std::memory_order_relaxed);
+        if (head - tailIndex.load(std::memory_order_acquire) == quint32(Capacity)) {
+            return false;
+        }
+        slots[head % Capacity] = value;
+        headIndex.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    bool pop(T& value) {
+        const quint32 tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail == headIndex.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[tail % Capacity];
+        tailIndex.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T slots[Capacity];
+    // On lines of their own, so the two sides do not invalidate each
+    // other's cache line with every value.
+    alignas(64) std::atomic<quint32> headIndex{0};
+    alignas(64) std::atomic<quint32> tailIndex{0};
+};
+
+#endif // PROGRESSRING_H
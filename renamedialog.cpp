@@ -0,0 +1,234 @@
+#include <QAbstractTableModel>
+#include <QBrush>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QDialogButtonBox>
+#include <QDir>
+#include <QFormLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QRegularExpression>
+#include <QSpinBox>
+#include <QTableView>
+#include <QTimer>
+#include <QVBoxLayout>
+
+#include "renamedialog.h"
+
+
+// Old name, new name and what stands in the way, one row per item. Only
+// the rows on screen are ever asked for, so the preview of twenty thousand
+// renames costs no more to show than that of twenty.
+class RenamePreviewModel : public QAbstractTableModel {
+public:
+    explicit RenamePreviewModel(QObject* parent)
+            : QAbstractTableModel(parent),
+              plan(nullptr) {
+    }
+
+    void setPlan(const RenamePlan* newPlan) {
+        beginResetModel();
+        plan = newPlan;
+        endResetModel();
+    }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() || !plan ? 0 : int(plan->items().size());
+    }
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : 3;
+    }
+
+    QVariant data(const QModelIndex& index, int role) const override {
+        if (!plan || !index.isValid()) {
+            return QVariant();
+        }
+        const RenamePlan::Item& item = plan->items().at(index.row());
+        const bool problem = item.status != RenamePlan::Ready && item.status != RenamePlan::Unchanged;
+
+        if (role == Qt::ForegroundRole && problem) {
+            return QBrush(Qt::red);
+        }
+        if (role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (index.column()) {
+        case 0:
+            return item.from;
+        case 1:
+            return item.to;
+        default:
+            return statusText(item);
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override {
+        if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+            return QVariant();
+        }
+        switch (section) {
+        case 0:
+            return RenameDialog::tr("Name");
+        case 1:
+            return RenameDialog::tr("New Name");
+        default:
+            return RenameDialog::tr("Status");
+        }
+    }
+
+private:
+    static QString statusText(const RenamePlan::Item& item) {
+        switch (item.status) {
+        case RenamePlan::Unchanged:
+            return RenameDialog::tr("unchanged");
+        case RenamePlan::Ready:
+            return item.inCycle ? RenameDialog::tr("swapped through a temporary name") : QString();
+        case RenamePlan::Invalid:
+            return RenameDialog::tr("not a valid name");
+        case RenamePlan::Duplicate:
+            return RenameDialog::tr("same new name as another item");
+        case RenamePlan::Exists:
+            return RenameDialog::tr("new name is taken");
+        }
+        return QString();
+    }
+
+    const RenamePlan* plan;
+};
+
+
+RenameDialog::RenameDialog(const QString& directory, const QStringList& names, QWidget *parent)
+        : QDialog(parent),
+          directory(directory),
+          names(names) {
+    setWindowTitle(tr("Rename %n Item(s)", "", int(names.size())));
+    resize(800, 550);
+
+    // Listed once; every version of the plan is checked against it.
+    const QStringList entries = QDir(directory).entryList(QDir::AllEntries | QDir::Hidden | QDir::System
+                                                          | QDir::NoDotAndDotDot);
+    existingNames = QSet<QString>(entries.begin(), entries.end());
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    QFormLayout* ruleLayout = new QFormLayout;
+
+    patternEdit = new QLineEdit(this);
+    patternEdit->setPlaceholderText(tr("Text to replace, e.g. ^(.*)$ as a regular expression"));
+    ruleLayout->addRow(tr("Find:"), patternEdit);
+
+    replacementEdit = new QLineEdit(this);
+    replacementEdit->setPlaceholderText(tr("Replacement; \\1 refers to a group, {n} is a running number"));
+    ruleLayout->addRow(tr("Replace with:"), replacementEdit);
+
+    QHBoxLayout* optionLayout = new QHBoxLayout;
+    regexBox = new QCheckBox(tr("Regular expression"), this);
+    caseSensitiveBox = new QCheckBox(tr("Case sensitive"), this);
+    caseSensitiveBox->setChecked(true);
+    extensionBox = new QCheckBox(tr("Keep extension"), this);
+    extensionBox->setChecked(true);
+    optionLayout->addWidget(regexBox);
+    optionLayout->addWidget(caseSensitiveBox);
+    optionLayout->addWidget(extensionBox);
+    optionLayout->addStretch();
+    ruleLayout->addRow(optionLayout);
+
+    caseBox = new QComboBox(this);
+    caseBox->addItems({tr("Keep"), tr("lower case"), tr("UPPER CASE"), tr("Title Case")});
+    ruleLayout->addRow(tr("Case:"), caseBox);
+
+    QHBoxLayout* numberLayout = new QHBoxLayout;
+    numberStartBox = new QSpinBox(this);
+    numberStartBox->setRange(0, 999999999);
+    numberStartBox->setValue(1);
+    numberWidthBox = new QSpinBox(this);
+    numberWidthBox->setRange(1, 9);
+    numberLayout->addWidget(new QLabel(tr("start at"), this));
+    numberLayout->addWidget(numberStartBox);
+    numberLayout->addWidget(new QLabel(tr("digits"), this));
+    numberLayout->addWidget(numberWidthBox);
+    numberLayout->addStretch();
+    ruleLayout->addRow(tr("{n}:"), numberLayout);
+    layout->addLayout(ruleLayout);
+
+    previewModel = new RenamePreviewModel(this);
+    previewView = new QTableView(this);
+    previewView->setModel(previewModel);
+    previewView->verticalHeader()->hide();
+    // Fixed row heights keep the view from measuring every row.
+    previewView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    previewView->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    previewView->setSelectionMode(QAbstractItemView::NoSelection);
+    layout->addWidget(previewView);
+
+    statusLabel = new QLabel(this);
+    layout->addWidget(statusLabel);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Cancel, this);
+    renameButton = buttons->addButton(tr("Rename"), QDialogButtonBox::AcceptRole);
+    connect(buttons, &QDialogButtonBox::accepted, this, &RenameDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, this, &RenameDialog::reject);
+    layout->addWidget(buttons);
+
+    // Typing a regular expression goes through many broken ones; the plan
+    // is worked out once the typing pauses.
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(150);
+    connect(updateTimer, &QTimer::timeout, this, &RenameDialog::updatePlan);
+    auto scheduleUpdate = [this]() { updateTimer->start(); };
+    connect(patternEdit, &QLineEdit::textChanged, this, scheduleUpdate);
+    connect(replacementEdit, &QLineEdit::textChanged, this, scheduleUpdate);
+    connect(regexBox, &QCheckBox::toggled, this, scheduleUpdate);
+    connect(caseSensitiveBox, &QCheckBox::toggled, this, scheduleUpdate);
+    connect(extensionBox, &QCheckBox::toggled, this, scheduleUpdate);
+    connect(caseBox, &QComboBox::currentIndexChanged, this, scheduleUpdate);
+    connect(numberStartBox, &QSpinBox::valueChanged, this, scheduleUpdate);
+    connect(numberWidthBox, &QSpinBox::valueChanged, this, scheduleUpdate);
+
+    updatePlan();
+}
+
+RenamePlan RenameDialog::plan() const {
+    return currentPlan;
+}
+
+RenameRule RenameDialog::currentRule() const {
+    RenameRule rule;
+    rule.pattern = patternEdit->text();
+    rule.replacement = replacementEdit->text();
+    rule.regularExpression = regexBox->isChecked();
+    rule.caseSensitive = caseSensitiveBox->isChecked();
+    rule.keepExtension = extensionBox->isChecked();
+    rule.caseChange = RenameRule::CaseChange(caseBox->currentIndex());
+    rule.numberStart = numberStartBox->value();
+    rule.numberWidth = numberWidthBox->value();
+    return rule;
+}
+
+void RenameDialog::updatePlan() {
+    const RenameRule rule = currentRule();
+    if (rule.regularExpression) {
+        const QRegularExpression expression(rule.pattern);
+        if (!expression.isValid()) {
+            statusLabel->setText(tr("Invalid regular expression: %1").arg(expression.errorString()));
+            renameButton->setEnabled(false);
+            return;
+        }
+    }
+
+    previewModel->setPlan(nullptr);
+    currentPlan = RenamePlan::build(directory, names, existingNames, rule);
+    previewModel->setPlan(&currentPlan);
+
+    const int ready = currentPlan.count(RenamePlan::Ready);
+    const int problems = int(names.size()) - ready - currentPlan.count(RenamePlan::Unchanged);
+    QString status = tr("%n item(s) will be renamed.", "", ready);
+    if (problems > 0) {
+        status += " " + tr("%n item(s) cannot be renamed and will be left as they are.", "", problems);
+    }
+    statusLabel->setText(status);
+    renameButton->setEnabled(ready > 0);
+}
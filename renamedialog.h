@@ -0,0 +1,58 @@
+#ifndef RENAMEDIALOG_H
+#define RENAMEDIALOG_H
+
+#include <QDialog>
+#include <QSet>
+#include <QStringList>
+
+#include "renameplan.h"
+
+class QCheckBox;
+class QComboBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QSpinBox;
+class QTableView;
+class QTimer;
+class RenamePreviewModel;
+
+// Bulk rename: a rule, and a preview of what it does to every selected
+// name, including which renames cannot happen and why. The plan is worked
+// out again shortly after each change to the rule; nothing is renamed until
+// the dialog is accepted.
+class RenameDialog : public QDialog {
+    Q_OBJECT
+
+public:
+    RenameDialog(const QString& directory, const QStringList& names, QWidget *parent = nullptr);
+
+    RenamePlan plan() const;
+
+private slots:
+    void updatePlan();
+
+private:
+    RenameRule currentRule() const;
+
+    QString directory;
+    QStringList names;
+    QSet<QString> existingNames;
+    RenamePlan currentPlan;
+
+    QLineEdit* patternEdit;
+    QLineEdit* replacementEdit;
+    QCheckBox* regexBox;
+    QCheckBox* caseSensitiveBox;
+    QCheckBox* extensionBox;
+    QComboBox* caseBox;
+    QSpinBox* numberStartBox;
+    QSpinBox* numberWidthBox;
+    QTableView* previewView;
+    RenamePreviewModel* previewModel;
+    QLabel* statusLabel;
+    QPushButton* renameButton;
+    QTimer* updateTimer;
+};
+
+#endif // RENAMEDIALOG_H
@@ -0,0 +1,368 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QHash>
+#include <QRegularExpression>
+#include <QSet>
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+#include "renameplan.h"
+
+
+static QString makeName(const QString& name, const RenameRule& rule, const QRegularExpression& expression,
+                        int number) {
+    QString base = name;
+    QString extension;
+    if (rule.keepExtension) {
+        // A leading dot marks a hidden file, not an extension.
+        const int dot = name.lastIndexOf('.');
+        if (dot > 0) {
+            base = name.left(dot);
+            extension = name.mid(dot);
+        }
+    }
+
+    if (!rule.pattern.isEmpty()) {
+        QString replacement = rule.replacement;
+        replacement.replace("{n}", QString::number(number).rightJustified(rule.numberWidth, '0'));
+        if (rule.regularExpression) {
+            base.replace(expression, replacement);
+        } else {
+            base.replace(rule.pattern, replacement, rule.caseSensitive ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
+    }
+
+    switch (rule.caseChange) {
+    case RenameRule::KeepCase:
+        break;
+    case RenameRule::LowerCase:
+        base = base.toLower();
+        break;
+    case RenameRule::UpperCase:
+        base = base.toUpper();
+        break;
+    case RenameRule::TitleCase: {
+        bool startOfWord = true;
+        for (QChar& character: base) {
+            character = startOfWord ? character.toUpper() : character.toLower();
+            startOfWord = !character.isLetterOrNumber();
+        }
+        break;
+    }
+    }
+    return base + extension;
+}
+
+static bool isValidName(const QString& name) {
+    return !name.isEmpty() && name != "." && name != ".." && !name.contains('/') && !name.contains(QChar(0));
+}
+
+
+RenamePlan RenamePlan::build(const QString& directory, const QStringList& names, const QSet<QString>& existingNames,
+                             const RenameRule& rule) {
+    QRegularExpression expression;
+    if (rule.regularExpression) {
+        expression.setPattern(rule.pattern);
+        if (!rule.caseSensitive) {
+            expression.setPatternOptions(QRegularExpression::CaseInsensitiveOption);
+        }
+    }
+    const bool usable = !rule.regularExpression || expression.isValid();
+
+    RenamePlan plan;
+    plan.dir = directory;
+    plan.entries.reserve(names.size());
+    for (int i = 0; i < names.size(); ++i) {
+        const QString& name = names.at(i);
+        const QString to = usable ? makeName(name, rule, expression, rule.numberStart + i) : name;
+        plan.entries.append({name, to, Unchanged, false});
+    }
+    plan.check(existingNames);
+    plan.order(existingNames);
+    return plan;
+}
+
+QString RenamePlan::directory() const {
+    return dir;
+}
+
+const QVector<RenamePlan::Item>& RenamePlan::items() const {
+    return entries;
+}
+
+const QVector<RenamePlan::Step>& RenamePlan::steps() const {
+    return sequence;
+}
+
+int RenamePlan::count(Status status) const {
+    int result = 0;
+    for (const Item& item: entries) {
+        if (item.status == status) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+void RenamePlan::check(const QSet<QString>& existingNames) {
+    const int count = int(entries.size());
+    QHash<QString, int> sourceOf;
+    sourceOf.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        sourceOf.insert(entries.at(i).from, i);
+    }
+
+    QHash<QString, int> targetCount;
+    for (Item& item: entries) {
+        if (item.to == item.from) {
+            item.status = Unchanged;
+        } else if (!isValidName(item.to)) {
+            item.status = Invalid;
+        } else {
+            item.status = Ready;
+            ++targetCount[item.to];
+        }
+    }
+    for (Item& item: entries) {
+        if (item.status == Ready && targetCount.value(item.to) > 1) {
+            item.status = Duplicate;
+        }
+    }
+
+    // Targets are unique now, so at most one item waits for any source name
+    // to become free. An item that does not move keeps its name taken, which
+    // stops whoever waits for it, and so on down the chain.
+    QVector<int> waiting(count, -1);
+    QVector<int> stuck;
+    for (int i = 0; i < count; ++i) {
+        Item& item = entries[i];
+        if (item.status != Ready) {
+            stuck.append(i);
+            continue;
+        }
+        const int source = sourceOf.value(item.to, -1);
+        if (source >= 0) {
+            waiting[source] = i;
+        } else if (existingNames.contains(item.to)) {
+            item.status = Exists;
+            stuck.append(i);
+        }
+    }
+    while (!stuck.isEmpty()) {
+        const int waiter = waiting.at(stuck.takeLast());
+        if (waiter >= 0 && entries.at(waiter).status == Ready) {
+            entries[waiter].status = Exists;
+            stuck.append(waiter);
+        }
+    }
+}
+
+void RenamePlan::order(const QSet<QString>& existingNames) {
+    const int count = int(entries.size());
+    QHash<QString, int> sourceOf;
+    for (int i = 0; i < count; ++i) {
+        if (entries.at(i).status == Ready) {
+            sourceOf.insert(entries.at(i).from, i);
+        }
+    }
+
+    // Each item can only move once the item holding its new name has moved
+    // away; "dependent" is the item waiting for that.
+    QVector<int> dependent(count, -1);
+    QVector<bool> blocked(count, false);
+    for (int i = 0; i < count; ++i) {
+        if (entries.at(i).status != Ready) {
+            continue;
+        }
+        const int holder = sourceOf.value(entries.at(i).to, -1);
+        if (holder >= 0) {
+            blocked[i] = true;
+            dependent[holder] = i;
+        }
+    }
+
+    QVector<bool> done(count, false);
+    for (int i = 0; i < count; ++i) {
+        if (entries.at(i).status != Ready || blocked.at(i)) {
+            continue;
+        }
+        bool first = true;
+        for (int current = i; current >= 0; current = dependent.at(current)) {
+            sequence.append({entries.at(current).from, entries.at(current).to, QString(), false, first});
+            done[current] = true;
+            first = false;
+        }
+    }
+
+    // Whatever is left waits on itself in a circle.
+    int temporaries = 0;
+    for (int i = 0; i < count; ++i) {
+        if (entries.at(i).status != Ready || done.at(i)) {
+            continue;
+        }
+        QString temporary;
+        do {
+            temporary = QString(".rename-%1-%2").arg(QCoreApplication::applicationPid()).arg(temporaries++);
+        } while (existingNames.contains(temporary) || sourceOf.contains(temporary));
+
+        sequence.append({entries.at(i).from, temporary, QString(), true, true});
+        entries[i].inCycle = true;
+        done[i] = true;
+        for (int current = dependent.at(i); current != i; current = dependent.at(current)) {
+            sequence.append({entries.at(current).from, entries.at(current).to, QString(), false, false});
+            entries[current].inCycle = true;
+            done[current] = true;
+        }
+        sequence.append({temporary, entries.at(i).to, entries.at(i).from, false, false});
+    }
+}
+
+
+// Renames within the directory, never replacing an entry.
+static bool renameEntry(const QDir& directory, int directoryFd, const QString& from, const QString& to) {
+#ifdef Q_OS_UNIX
+    Q_UNUSED(directory);
+    const QByteArray source = QFile::encodeName(from);
+    const QByteArray target = QFile::encodeName(to);
+#if defined(Q_OS_LINUX) && defined(RENAME_NOREPLACE)
+    if (::renameat2(directoryFd, source.constData(), directoryFd, target.constData(), RENAME_NOREPLACE) == 0) {
+        return true;
+    }
+    // Some file systems do not take the flag.
+    if (errno != EINVAL && errno != ENOSYS) {
+        return false;
+    }
+#endif
+    // Without the flag, checking right before renaming narrows the window
+    // in which a new file could be replaced to almost nothing.
+    struct stat info;
+    if (::fstatat(directoryFd, target.constData(), &info, AT_SYMLINK_NOFOLLOW) == 0) {
+        errno = EEXIST;
+        return false;
+    }
+    return ::renameat(directoryFd, source.constData(), directoryFd, target.constData()) == 0;
+#else
+    Q_UNUSED(directoryFd);
+    // QDir::rename() refuses to replace an existing file.
+    return QDir(directory).rename(from, to);
+#endif
+}
+
+
+RenameJob::RenameJob(const RenamePlan& plan, QObject *parent)
+        : QObject(parent),
+          plan(plan),
+          worker(nullptr),
+          cancelled(false) {
+}
+
+RenameJob::~RenameJob() {
+    cancel();
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+void RenameJob::start() {
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+}
+
+void RenameJob::cancel() {
+    cancelled = true;
+}
+
+void RenameJob::run() {
+    const QDir directory(plan.directory());
+    const QVector<RenamePlan::Step>& steps = plan.steps();
+    QStringList failures;
+    int renamed = 0;
+
+    int directoryFd = -1;
+#ifdef Q_OS_UNIX
+    directoryFd = ::open(QFile::encodeName(plan.directory()).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryFd < 0) {
+        emit finished(0, {QString("%1: %2").arg(plan.directory(), qt_error_string(errno))});
+        return;
+    }
+#endif
+
+    int groupStart = 0;
+    bool skipGroup = false;
+    for (int i = 0; i < steps.size(); ++i) {
+        const RenamePlan::Step& step = steps.at(i);
+        if (step.startsGroup) {
+            if (cancelled) {
+                break;
+            }
+            groupStart = i;
+            skipGroup = false;
+        }
+        if (skipGroup) {
+            continue;
+        }
+
+        if (renameEntry(directory, directoryFd, step.from, step.to)) {
+            if (!step.toTemporary) {
+                ++renamed;
+            }
+            continue;
+        }
+
+        const QString reason = qt_error_string(errno);
+        if (!steps.at(groupStart).toTemporary) {
+            failures << QString("%1: %2").arg(step.from, reason);
+            continue;
+        }
+
+        // A broken cycle is undone, newest rename first, so that none of
+        // its items is left under the temporary name. A rename that cannot
+        // be undone keeps its new name, which is where the item was going,
+        // except for the temporary one: that item is reported where it is.
+        skipGroup = true;
+        QSet<int> kept;
+        for (int done = i - 1; done >= groupStart; --done) {
+            const RenamePlan::Step& undo = steps.at(done);
+            if (!renameEntry(directory, directoryFd, undo.to, undo.from)) {
+                kept.insert(done);
+            } else if (!undo.toTemporary) {
+                --renamed;
+            }
+        }
+
+        // Every item of the cycle has one step that gives it its final name;
+        // the first item's goes from the temporary name.
+        int groupEnd = groupStart + 1;
+        while (groupEnd < steps.size() && !steps.at(groupEnd).startsGroup) {
+            ++groupEnd;
+        }
+        const int failedItem = i == groupStart ? groupEnd - 1 : i;
+        for (int item = groupStart + 1; item < groupEnd; ++item) {
+            const bool firstItem = !steps.at(item).fallback.isEmpty();
+            const QString name = firstItem ? steps.at(item).fallback : steps.at(item).from;
+            if (firstItem && kept.contains(groupStart)) {
+                failures << tr("%1: %2 (could not be put back, it is now named %3)")
+                                    .arg(name, item == failedItem ? reason : tr("its cycle could not be completed"),
+                                         steps.at(groupStart).to);
+            } else if (item == failedItem) {
+                failures << QString("%1: %2").arg(name, reason);
+            } else if (!kept.contains(item)) {
+                failures << tr("%1: left unchanged, its cycle could not be completed").arg(name);
+            }
+        }
+    }
+
+#ifdef Q_OS_UNIX
+    ::close(directoryFd);
+#endif
+    emit finished(renamed, failures);
+}
@@ -0,0 +1,117 @@
+#ifndef RENAMEPLAN_H
+#define RENAMEPLAN_H
+
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+
+class QThread;
+
+// How new names are made from old ones. The pattern is replaced by the
+// replacement (as a regular expression, with \1 style references, if asked
+// for), "{n}" in the replacement becomes a running number, and the case
+// change is applied last. With keepExtension, only the part before the last
+// dot takes part.
+struct RenameRule {
+    enum CaseChange {
+        KeepCase,
+        LowerCase,
+        UpperCase,
+        TitleCase
+    };
+
+    QString pattern;
+    QString replacement;
+    bool regularExpression = false;
+    bool caseSensitive = true;
+    bool keepExtension = true;
+    CaseChange caseChange = KeepCase;
+    int numberStart = 1;
+    int numberWidth = 1;
+};
+
+// Renames of many entries of one directory, worked out completely before
+// anything is touched.
+//
+// Every new name is checked against the directory and against the other new
+// names. Items whose new name is taken by an entry that stays, is empty or
+// is shared with another item are left out, and so is anything that would
+// have to wait for them. The rest are put in an order in which every target
+// name is free when its rename runs: chains (a to b while b goes to c) are
+// renamed from the far end, and cycles (a and b swapping names) go through
+// a temporary name.
+class RenamePlan {
+public:
+    enum Status {
+        Unchanged,
+        Ready,
+        Invalid,
+        Duplicate,
+        Exists
+    };
+
+    struct Item {
+        QString from;
+        QString to;
+        Status status;
+        bool inCycle;
+    };
+
+    struct Step {
+        QString from;
+        QString to;
+        // For the step out of a temporary name, the item's original name.
+        QString fallback;
+        bool toTemporary;
+        // Steps of one chain or cycle belong together; a cancelled job stops
+        // only before the first step of one.
+        bool startsGroup;
+    };
+
+    static RenamePlan build(const QString& directory, const QStringList& names, const QSet<QString>& existingNames,
+                            const RenameRule& rule);
+
+    QString directory() const;
+    const QVector<Item>& items() const;
+    const QVector<Step>& steps() const;
+    int count(Status status) const;
+
+private:
+    void check(const QSet<QString>& existingNames);
+    void order(const QSet<QString>& existingNames);
+
+    QString dir;
+    QVector<Item> entries;
+    QVector<Step> sequence;
+};
+
+// Runs a RenamePlan on a worker thread. Renames never replace anything:
+// renameat2() with RENAME_NOREPLACE is used where the kernel has it, so a
+// file that appeared after the plan was made is not overwritten. A cycle
+// that breaks halfway is undone, so none of its items stays under the
+// temporary name.
+class RenameJob : public QObject {
+    Q_OBJECT
+
+public:
+    explicit RenameJob(const RenamePlan& plan, QObject *parent = nullptr);
+    ~RenameJob();
+
+    void start();
+    void cancel();
+
+signals:
+    void finished(int renamed, const QStringList& failures);
+
+private:
+    void run();
+
+    RenamePlan plan;
+    QThread *worker;
+    std::atomic<bool> cancelled;
+};
+
+#endif // RENAMEPLAN_H
@@ -0,0 +1,459 @@
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QUrl>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#endif
+
+#include "splitjoin.h"
+#include "checksum.h"
+#include "fileoperations.h"
+#include "ioscheduler.h"
+
+
+static const QByteArray manifestMagic = "FMSPLIT 1";
+
+static QByteArray encodeName(const QString& name) {
+    return QUrl::toPercentEncoding(name);
+}
+
+static QString decodeName(const QByteArray& encoded) {
+    return QUrl::fromPercentEncoding(encoded);
+}
+
+#ifdef Q_OS_UNIX
+// Makes the names created in a directory durable.
+static bool syncDirectory(const QString& path) {
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    const bool synced = ::fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+}
+#endif
+
+
+bool SplitManifest::save(const QString& path) const {
+    // A manifest is either complete or not there at all.
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(manifestMagic + "\n");
+    file.write("FILE " + encodeName(fileName) + "\n");
+    file.write("SIZE " + QByteArray::number(size) + "\n");
+    for (const Part& part: parts) {
+        file.write("PART " + QByteArray::number(part.size) + " " + QByteArray::number(part.checksum, 16) + " "
+                   + encodeName(part.name) + "\n");
+    }
+    return file.commit();
+}
+
+bool SplitManifest::load(const QString& path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.readLine().trimmed() != manifestMagic) {
+        return false;
+    }
+
+    fileName.clear();
+    size = -1;
+    parts.clear();
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        const QList<QByteArray> fields = line.split(' ');
+        if (fields.first() == "FILE" && fields.size() == 2) {
+            fileName = decodeName(fields.at(1));
+        } else if (fields.first() == "SIZE" && fields.size() == 2) {
+            size = fields.at(1).toLongLong();
+        } else if (fields.first() == "PART" && fields.size() == 4) {
+            bool ok;
+            const quint64 checksum = fields.at(2).toULongLong(&ok, 16);
+            if (!ok) {
+                return false;
+            }
+            parts.append({decodeName(fields.at(3)), fields.at(1).toLongLong(), checksum});
+        }
+    }
+
+    // Names are taken from next to the manifest and nowhere else.
+    qint64 total = 0;
+    for (const Part& part: parts) {
+        if (part.name.isEmpty() || part.name.contains('/') || part.size < 0) {
+            return false;
+        }
+        total += part.size;
+    }
+    return !fileName.isEmpty() && !fileName.contains('/') && !parts.isEmpty() && total == size;
+}
+
+
+#ifdef Q_OS_UNIX
+// pread and pwrite may move less than asked, and signals may cut them short.
+static bool readFully(int fd, char* data, qint64 size, qint64 offset) {
+    while (size > 0) {
+        const ssize_t bytesRead = ::pread(fd, data, size_t(size), off_t(offset));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            if (bytesRead == 0) {
+                errno = EIO;
+            }
+            return false;
+        }
+        data += bytesRead;
+        size -= bytesRead;
+        offset += bytesRead;
+    }
+    return true;
+}
+
+static bool writeFully(int fd, const char* data, qint64 size, qint64 offset) {
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, data, size_t(size), off_t(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            return false;
+        }
+        data += written;
+        size -= written;
+        offset += written;
+    }
+    return true;
+}
+
+// Reserves the whole length up front. File systems that cannot, only get
+// the length set; running out of space is the one failure that counts.
+static bool preallocate(int fd, qint64 size) {
+#ifdef Q_OS_LINUX
+    if (::fallocate(fd, 0, 0, off_t(size)) == 0) {
+        return true;
+    }
+    if (errno == ENOSPC) {
+        return false;
+    }
+#endif
+    return ::ftruncate(fd, off_t(size)) == 0;
+}
+#endif
+
+
+SplitJob::SplitJob(const QString& sourcePath, qint64 partSize, QObject *parent)
+        : QObject(parent),
+          joining(false),
+          path(QFileInfo(sourcePath).absoluteFilePath()),
+          partSize(qMax<qint64>(1, partSize)),
+          worker(nullptr),
+          cancelled(false) {
+}
+
+SplitJob::SplitJob(const QString& manifestPath, QObject *parent)
+        : QObject(parent),
+          joining(true),
+          path(QFileInfo(manifestPath).absoluteFilePath()),
+          partSize(0),
+          worker(nullptr),
+          cancelled(false) {
+}
+
+SplitJob::~SplitJob() {
+    cancel();
+    if (worker) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+const TransferProgress& SplitJob::progress() const {
+    return transfer;
+}
+
+Throttle& SplitJob::throttle() {
+    return jobThrottle;
+}
+
+void SplitJob::start() {
+    transfer.start();
+    worker = QThread::create([this]() { run(); });
+    worker->start();
+}
+
+void SplitJob::cancel() {
+    cancelled = true;
+}
+
+void SplitJob::run() {
+#ifdef Q_OS_UNIX
+    if (joining) {
+        join();
+    } else {
+        split();
+    }
+#else
+    addFailure(path, tr("not supported on this platform"));
+#endif
+    emit finished(failures.isEmpty() && !cancelled ? result : QString(), failures);
+}
+
+void SplitJob::split() {
+#ifdef Q_OS_UNIX
+    const QFileInfo info(path);
+    const QDir directory = info.absoluteDir();
+    const qint64 size = info.size();
+    if (!info.isFile() || size <= partSize) {
+        addFailure(path, tr("is not a file larger than one part"));
+        return;
+    }
+
+    const qint64 count = (size + partSize - 1) / partSize;
+    const int width = qMax(3, int(QString::number(count).size()));
+    manifest.fileName = info.fileName();
+    manifest.size = size;
+    for (qint64 i = 0; i < count; ++i) {
+        const QString name = info.fileName() + "." + QString::number(i + 1).rightJustified(width, '0');
+        manifest.parts.append({name, qMin(partSize, size - i * partSize), 0});
+        offsets.append(i * partSize);
+    }
+
+    // Parts of an earlier split are not overwritten.
+    result = directory.filePath(info.fileName() + SplitManifest::suffix);
+    for (const SplitManifest::Part& part: manifest.parts) {
+        if (QFileInfo::exists(directory.filePath(part.name))) {
+            addFailure(directory.filePath(part.name), tr("already exists"));
+        }
+    }
+    if (QFileInfo::exists(result)) {
+        addFailure(result, tr("already exists"));
+    }
+    if (!failures.isEmpty()) {
+        return;
+    }
+
+    const int fd = ::open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        addFailure(path, qt_error_string(errno));
+        return;
+    }
+    transfer.setTotal(size, manifest.parts.size());
+    runParts(path, [this, fd](int index) { splitPart(fd, index); });
+    ::close(fd);
+
+    // The manifest vouches for the parts, so they and their names reach
+    // the disk first.
+    if (failures.isEmpty() && !cancelled && !syncDirectory(directory.absolutePath())) {
+        addFailure(directory.absolutePath(), qt_error_string(errno));
+    }
+    if (failures.isEmpty() && !cancelled && !manifest.save(result)) {
+        addFailure(result, tr("could not write the manifest"));
+    }
+    if (!failures.isEmpty() || cancelled) {
+        for (const SplitManifest::Part& part: manifest.parts) {
+            QFile::remove(directory.filePath(part.name));
+        }
+    }
+#endif
+}
+
+void SplitJob::splitPart(int fd, int index) {
+#ifdef Q_OS_UNIX
+    // Each task fills in its own part only.
+    SplitManifest::Part& part = manifest.parts.data()[index];
+    const QString partPath = QFileInfo(path).absoluteDir().filePath(part.name);
+    const qint64 offset = offsets.at(index);
+
+    IoScheduler::Slot slot(path, partPath);
+    FileOperations::throttleChunk(slot, 0, 2);
+    const int out = ::open(QFile::encodeName(partPath).constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (out < 0) {
+        addFailure(partPath, qt_error_string(errno));
+        return;
+    }
+    if (!preallocate(out, part.size)) {
+        addFailure(partPath, qt_error_string(errno));
+        ::close(out);
+        return;
+    }
+
+    QByteArray buffer(FileOperations::chunkSize, Qt::Uninitialized);
+    Checksum checksum;
+    qint64 done = 0;
+    for (; done < part.size && !cancelled;) {
+        const qint64 length = qMin<qint64>(buffer.size(), part.size - done);
+        FileOperations::throttleChunk(slot, length, 2);
+        if (!readFully(fd, buffer.data(), length, offset + done)) {
+            addFailure(path, qt_error_string(errno));
+            break;
+        }
+        if (!writeFully(out, buffer.constData(), length, done)) {
+            addFailure(partPath, qt_error_string(errno));
+            break;
+        }
+        checksum.update(buffer.constData(), length);
+        FileOperations::reportProgress(length);
+        done += length;
+    }
+    part.checksum = checksum.digest();
+    bool complete = done == part.size;
+    if (complete && ::fdatasync(out) != 0) {
+        addFailure(partPath, qt_error_string(errno));
+        complete = false;
+    }
+    ::close(out);
+    if (complete) {
+        FileOperations::reportFileDone(partPath);
+    }
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(index);
+#endif
+}
+
+void SplitJob::join() {
+#ifdef Q_OS_UNIX
+    if (!manifest.load(path)) {
+        addFailure(path, tr("is not a valid split manifest"));
+        return;
+    }
+    const QDir directory = QFileInfo(path).absoluteDir();
+    result = directory.filePath(manifest.fileName);
+    if (QFileInfo::exists(result)) {
+        addFailure(result, tr("already exists"));
+        return;
+    }
+
+    // Every part has to be there before anything is written.
+    qint64 offset = 0;
+    for (const SplitManifest::Part& part: manifest.parts) {
+        const QFileInfo partInfo(directory.filePath(part.name));
+        if (!partInfo.isFile()) {
+            addFailure(partInfo.filePath(), tr("is missing"));
+        } else if (partInfo.size() != part.size) {
+            addFailure(partInfo.filePath(), tr("has %1 bytes instead of %2").arg(partInfo.size()).arg(part.size));
+        }
+        offsets.append(offset);
+        offset += part.size;
+    }
+    if (!failures.isEmpty()) {
+        return;
+    }
+
+    // Written under a temporary name until every part has been checked.
+    const QString temporary = result + ".join-" + QString::number(QCoreApplication::applicationPid());
+    const QByteArray encodedTemporary = QFile::encodeName(temporary);
+    const int out = ::open(encodedTemporary.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (out < 0) {
+        addFailure(temporary, qt_error_string(errno));
+        return;
+    }
+    if (!preallocate(out, manifest.size)) {
+        addFailure(result, errno == ENOSPC ? tr("not enough space for %1 bytes").arg(manifest.size)
+                                           : qt_error_string(errno));
+        ::close(out);
+        ::unlink(encodedTemporary.constData());
+        return;
+    }
+
+    transfer.setTotal(manifest.size, manifest.parts.size());
+    runParts(result, [this, out](int index) { joinPart(out, index); });
+
+    bool ok = failures.isEmpty() && !cancelled;
+    if (ok && ::fsync(out) != 0) {
+        addFailure(result, qt_error_string(errno));
+        ok = false;
+    }
+    ::close(out);
+    if (ok) {
+        QFile::setPermissions(temporary, QFile::permissions(directory.filePath(manifest.parts.first().name)));
+        if (::rename(encodedTemporary.constData(), QFile::encodeName(result).constData()) != 0) {
+            addFailure(result, qt_error_string(errno));
+            ok = false;
+        } else if (!syncDirectory(directory.absolutePath())) {
+            qWarning() << "Failed to sync directory:" << directory.absolutePath();
+        }
+    }
+    if (!ok) {
+        ::unlink(encodedTemporary.constData());
+    }
+#endif
+}
+
+void SplitJob::joinPart(int fd, int index) {
+#ifdef Q_OS_UNIX
+    const SplitManifest::Part& part = manifest.parts.at(index);
+    const QString partPath = QFileInfo(path).absoluteDir().filePath(part.name);
+    const qint64 offset = offsets.at(index);
+
+    IoScheduler::Slot slot(partPath, result);
+    FileOperations::throttleChunk(slot, 0, 1);
+    const int in = ::open(QFile::encodeName(partPath).constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        addFailure(partPath, qt_error_string(errno));
+        return;
+    }
+
+    QByteArray buffer(FileOperations::chunkSize, Qt::Uninitialized);
+    Checksum checksum;
+    qint64 done = 0;
+    for (; done < part.size && !cancelled;) {
+        const qint64 length = qMin<qint64>(buffer.size(), part.size - done);
+        FileOperations::throttleChunk(slot, length, 2);
+        if (!readFully(in, buffer.data(), length, done)) {
+            addFailure(partPath, qt_error_string(errno));
+            break;
+        }
+        if (!writeFully(fd, buffer.constData(), length, offset + done)) {
+            addFailure(result, qt_error_string(errno));
+            break;
+        }
+        checksum.update(buffer.constData(), length);
+        FileOperations::reportProgress(length);
+        done += length;
+    }
+    ::close(in);
+
+    if (done == part.size && checksum.digest() != part.checksum) {
+        addFailure(partPath, tr("does not match its checksum in the manifest"));
+    } else if (done == part.size) {
+        FileOperations::reportFileDone(partPath);
+    }
+#else
+    Q_UNUSED(fd);
+    Q_UNUSED(index);
+#endif
+}
+
+void SplitJob::runParts(const QString& devicePath, const std::function<void(int)>& task) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(IoScheduler::instance().device(devicePath).concurrency);
+    for (int i = 0; i < manifest.parts.size(); ++i) {
+        pool.start([this, &task, i]() {
+            FileOperations::setProgress(&transfer);
+            FileOperations::setThrottle(&jobThrottle);
+            task(i);
+            FileOperations::setThrottle(nullptr);
+            FileOperations::setProgress(nullptr);
+        });
+    }
+    pool.waitForDone();
+}
+
+void SplitJob::addFailure(const QString& filePath, const QString& reason) {
+    qWarning() << "Could not" << (joining ? "join" : "split") << filePath << "-" << reason;
+    QMutexLocker locker(&failureMutex);
+    failures.append(filePath + ": " + reason);
+}
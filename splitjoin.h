@@ -0,0 +1,90 @@
+#ifndef SPLITJOIN_H
+#define SPLITJOIN_H
+
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+#include "preflight.h"
+#include "throttle.h"
+
+class QThread;
+
+// Describes a file cut into parts: its name and size, and the name, size
+// and XXH64 checksum of every part in order. Saved as "<name>.parts" next
+// to the parts, in the line format of the copy journal.
+struct SplitManifest {
+    struct Part {
+        QString name;
+        qint64 size;
+        quint64 checksum;
+    };
+
+    static constexpr const char* suffix = ".parts";
+
+    QString fileName;
+    qint64 size = 0;
+    QVector<Part> parts;
+
+    bool save(const QString& path) const;
+    bool load(const QString& path);
+};
+
+// Cuts a file into parts of a fixed size, or puts them back together from
+// a manifest.
+//
+// Every part is a task of its own in a thread pool sized to what
+// IoScheduler allows for the disk, and moves its data with positional
+// reads and writes (pread/pwrite), so the tasks share the big file without
+// sharing a file position. Parts are hashed as they are written; joining
+// checks every part against the manifest before its data counts, and only
+// renames the result into place when all of them match. The joined file is
+// preallocated with fallocate, so parallel writes into it do not fragment
+// it and a full disk shows up before any data is written.
+class SplitJob : public QObject {
+    Q_OBJECT
+
+public:
+    // Splits sourcePath into parts of partSize next to it.
+    SplitJob(const QString& sourcePath, qint64 partSize, QObject *parent = nullptr);
+    // Joins the parts a manifest lists into the file it names, next to it.
+    explicit SplitJob(const QString& manifestPath, QObject *parent = nullptr);
+    ~SplitJob();
+
+    const TransferProgress& progress() const;
+    Throttle& throttle();
+    void start();
+    void cancel();
+
+signals:
+    void finished(const QString& resultPath, const QStringList& failures);
+
+private:
+    void run();
+    void split();
+    void join();
+    void splitPart(int fd, int index);
+    void joinPart(int fd, int index);
+    void runParts(const QString& devicePath, const std::function<void(int)>& task);
+    void addFailure(const QString& filePath, const QString& reason);
+
+    bool joining;
+    QString path;
+    QString result;
+    qint64 partSize;
+    SplitManifest manifest;
+    QVector<qint64> offsets;
+    QThread *worker;
+    std::atomic<bool> cancelled;
+
+    TransferProgress transfer;
+    Throttle jobThrottle;
+    QMutex failureMutex;
+    QStringList failures;
+};
+
+#endif // SPLITJOIN_H
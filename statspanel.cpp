@@ -0,0 +1,274 @@
+#include <QDateTime>
+#include <QDir>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLocale>
+#include <QPushButton>
+#include <QSettings>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+#include <algorithm>
+
+#include "statspanel.h"
+#include "dirwatcher.h"
+
+
+StatsPanel::StatsPanel(QWidget *parent)
+        : QWidget(parent, Qt::Tool),
+          stats(nullptr),
+          scanning(nullptr),
+          worker(nullptr),
+          cancelled(false),
+          watcher(nullptr),
+          unwatched(0),
+          treePool(new QThreadPool(this)),
+          treesCancelled(false),
+          statsGeneration(0) {
+    setWindowTitle(tr("Statistics"));
+    setAttribute(Qt::WA_QuitOnClose, false);
+    resize(520, 560);
+    // listTree() reads each tree in parallel already.
+    treePool->setMaxThreadCount(1);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    summaryLabel = new QLabel(this);
+    summaryLabel->setWordWrap(true);
+    layout->addWidget(summaryLabel);
+    oldestLabel = new QLabel(this);
+    oldestLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(oldestLabel);
+    newestLabel = new QLabel(this);
+    newestLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    layout->addWidget(newestLabel);
+
+    sizeTree = new QTreeWidget(this);
+    sizeTree->setRootIsDecorated(false);
+    sizeTree->setHeaderLabels({tr("Size"), tr("Files"), tr("Total"), tr("Of files")});
+    layout->addWidget(sizeTree);
+
+    typeTree = new QTreeWidget(this);
+    typeTree->setRootIsDecorated(false);
+    typeTree->setHeaderLabels({tr("Type"), tr("Files"), tr("Total"), tr("Of space")});
+    layout->addWidget(typeTree, 1);
+
+    QHBoxLayout* buttons = new QHBoxLayout;
+    buttons->addStretch();
+    QPushButton* rescanButton = new QPushButton(tr("Rescan"), this);
+    buttons->addWidget(rescanButton);
+    layout->addLayout(buttons);
+    connect(rescanButton, &QPushButton::clicked, this, [this]() {
+        if (stats) {
+            startScan(stats->rootPath());
+        }
+    });
+
+    // A busy tree reports changes every batch interval; the numbers are
+    // redrawn at most twice a second, and only while they can be seen.
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(500);
+    connect(refreshTimer, &QTimer::timeout, this, &StatsPanel::refresh);
+}
+
+StatsPanel::~StatsPanel() {
+    treesCancelled = true;
+    treePool->waitForDone();
+    stopScan();
+    delete stats;
+}
+
+void StatsPanel::showDirectory(const QString& path) {
+    show();
+    raise();
+    activateWindow();
+
+    const QString root = QDir(path).absolutePath();
+    if (stats && stats->rootPath() == root) {
+        refresh();
+    } else if (!worker || scanningPath != root) {
+        startScan(root);
+    }
+}
+
+void StatsPanel::startScan(const QString& path) {
+    stopScan();
+    scanningPath = path;
+    scanning = new DirStats;
+    worker = QThread::create([this, path]() { scanning->scan(path, cancelled); });
+    connect(worker, &QThread::finished, this, &StatsPanel::scanFinished);
+    worker->start();
+    setWindowTitle(tr("Statistics - %1").arg(QDir::toNativeSeparators(path)));
+    summaryLabel->setText(tr("Scanning %1...").arg(QDir::toNativeSeparators(path)));
+}
+
+void StatsPanel::stopScan() {
+    if (!worker) {
+        return;
+    }
+    cancelled = true;
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    delete scanning;
+    scanning = nullptr;
+    cancelled = false;
+}
+
+void StatsPanel::scanFinished() {
+    // A scan stopped for a newer one may still deliver its signal.
+    if (sender() != worker) {
+        return;
+    }
+    worker->wait();
+    delete worker;
+    worker = nullptr;
+    delete stats;
+    stats = scanning;
+    scanning = nullptr;
+    ++statsGeneration;
+
+    // Changes made while the scan ran are not known, so watching starts
+    // fresh with the tree as scanned.
+    delete watcher;
+    QSettings settings;
+    watcher = new DirWatcher(this);
+    watcher->setBatchInterval(settings.value("watcher/batchInterval", 250).toInt());
+    watcher->setRescanInterval(settings.value("watcher/rescanInterval", 2000).toInt());
+    connect(watcher, &DirWatcher::directoryChanged, this, [this](const QString& directory) {
+        applyChanges(directory);
+    });
+    connect(watcher, &DirWatcher::rescanRequired, this, &StatsPanel::applyChanges);
+    unwatched = 0;
+    watch(stats->directories(), QStringList());
+    refresh();
+}
+
+void StatsPanel::applyChanges(const QString& directory) {
+    if (!stats) {
+        return;
+    }
+    QStringList appeared;
+    QStringList removed;
+    stats->updateDirectory(directory, appeared, removed);
+    watch(QStringList(), removed);
+    for (const QString& subdirectory: appeared) {
+        listTree(subdirectory);
+    }
+    scheduleRefresh();
+}
+
+void StatsPanel::listTree(const QString& directory) {
+    // A directory moved into the tree may hold any number of files; the
+    // GUI thread only merges the listings once they are read.
+    const int generation = statsGeneration;
+    treePool->start([this, generation, directory]() {
+        QHash<QString, DirStats::Listing> tree;
+        if (!DirStats::listTree(directory, tree, treesCancelled)) {
+            return;
+        }
+        QMetaObject::invokeMethod(this, [this, generation, directory, tree]() {
+            addTree(generation, directory, tree);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void StatsPanel::addTree(int generation, const QString& directory, const QHash<QString, DirStats::Listing>& tree) {
+    // A rescan has replaced the statistics the tree was read for.
+    if (generation != statsGeneration || !stats) {
+        return;
+    }
+    QStringList added;
+    stats->addTree(directory, tree, added);
+    watch(added, QStringList());
+    scheduleRefresh();
+}
+
+void StatsPanel::scheduleRefresh() {
+    if (isVisible() && !refreshTimer->isActive()) {
+        refreshTimer->start();
+    }
+}
+
+void StatsPanel::watch(const QStringList& added, const QStringList& removed) {
+    for (const QString& directory: removed) {
+        watcher->removePath(directory);
+    }
+    for (const QString& directory: added) {
+        if (!watcher->addPath(directory)) {
+            ++unwatched;
+        }
+    }
+}
+
+static QString share(qint64 part, qint64 whole) {
+    return whole > 0 ? QLocale().toString(100.0 * double(part) / double(whole), 'f', 1) + " %" : QString();
+}
+
+static QString describe(const DirStats::Extreme& file) {
+    if (file.path.isEmpty()) {
+        return QObject::tr("none");
+    }
+    return QObject::tr("%1 (%2)").arg(QDir::toNativeSeparators(file.path),
+                                      QLocale().toString(QDateTime::fromSecsSinceEpoch(file.modified),
+                                                         QLocale::ShortFormat));
+}
+
+void StatsPanel::refresh() {
+    if (!stats) {
+        return;
+    }
+    QLocale locale;
+    const DirStats::Totals totals = stats->totals();
+    QString summary = tr("%1 files in %2 directories, %3.")
+                          .arg(locale.toString(totals.files), locale.toString(stats->directoryCount()),
+                               locale.formattedDataSize(totals.bytes));
+    if (unwatched > 0) {
+        summary += " " + tr("%n directory(s) could not be watched; changes in them show after a rescan.", "",
+                            unwatched);
+    }
+    summaryLabel->setText(summary);
+    oldestLabel->setText(tr("Oldest: %1").arg(describe(stats->oldest())));
+    newestLabel->setText(tr("Newest: %1").arg(describe(stats->newest())));
+
+    sizeTree->clear();
+    for (int bucket = 0; bucket < DirStats::bucketCount; ++bucket) {
+        QString range;
+        if (bucket == 0) {
+            range = tr("Empty");
+        } else if (bucket == DirStats::bucketCount - 1) {
+            range = tr("%1 and over").arg(locale.formattedDataSize(DirStats::bucketLimit(bucket - 1)));
+        } else {
+            range = tr("Under %1").arg(locale.formattedDataSize(DirStats::bucketLimit(bucket)));
+        }
+        const DirStats::Totals sizes = stats->bucket(bucket);
+        sizeTree->addTopLevelItem(new QTreeWidgetItem({range, locale.toString(sizes.files),
+                                                       locale.formattedDataSize(sizes.bytes),
+                                                       share(sizes.files, totals.files)}));
+    }
+
+    // Largest share of the space first.
+    QVector<QPair<QString, DirStats::Totals>> types;
+    for (auto it = stats->types().cbegin(); it != stats->types().cend(); ++it) {
+        types.append({it.key(), it.value()});
+    }
+    std::sort(types.begin(), types.end(), [](const auto& first, const auto& second) {
+        return first.second.bytes > second.second.bytes;
+    });
+    typeTree->clear();
+    QList<QTreeWidgetItem*> items;
+    for (const auto& type: types) {
+        items.append(new QTreeWidgetItem({type.first.isEmpty() ? tr("(none)") : type.first,
+                                          locale.toString(type.second.files),
+                                          locale.formattedDataSize(type.second.bytes),
+                                          share(type.second.bytes, totals.bytes)}));
+    }
+    typeTree->addTopLevelItems(items);
+    for (QTreeWidget* tree: {sizeTree, typeTree}) {
+        tree->header()->resizeSections(QHeaderView::ResizeToContents);
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+
+#include <QWidget>
+
+#include <atomic>
+
+#include "dirstats.h"
+
+class QLabel;
+class QThread;
+class QThreadPool;
+class QTimer;
+class QTreeWidget;
+class DirWatcher;
+
+// Shows DirStats for a directory tree: counts and size, a size histogram,
+// the breakdown by file type and the oldest and newest file.
+//
+// The tree is scanned once in the background and then kept current by a
+// DirWatcher on every directory in it, each batch of changes relisting only
+// the directory it is for; a subdirectory that appears is read on a pool
+// and counted once it has been. The statistics of the last tree shown stay
+// cached, so showing the same directory again costs nothing.
+//
+// Like the job panel, the panel is a window of its own without a parent.
+class StatsPanel : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit StatsPanel(QWidget *parent = nullptr);
+    ~StatsPanel();
+
+    void showDirectory(const QString& path);
+
+private slots:
+    void scanFinished();
+    void applyChanges(const QString& directory);
+    void refresh();
+
+private:
+    void startScan(const QString& path);
+    void stopScan();
+    void watch(const QStringList& added, const QStringList& removed);
+    void listTree(const QString& directory);
+    void addTree(int generation, const QString& directory, const QHash<QString, DirStats::Listing>& tree);
+    void scheduleRefresh();
+
+    DirStats* stats;
+    DirStats* scanning;
+    QString scanningPath;
+    QThread* worker;
+    std::atomic<bool> cancelled;
+    DirWatcher* watcher;
+    int unwatched;
+    QThreadPool* treePool;
+    std::atomic<bool> treesCancelled;
+    // Counts the statistics replaced, so trees read for older ones are
+    // dropped.
+    int statsGeneration;
+
+    QLabel* summaryLabel;
+    QLabel* oldestLabel;
+    QLabel* newestLabel;
+    QTreeWidget* sizeTree;
+    QTreeWidget* typeTree;
+    QTimer* refreshTimer;
+};
+
+#endif // STATSPANEL_H
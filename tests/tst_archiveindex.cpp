@@ -0,0 +1,194 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+
+#include "archiveindex.h"
+
+
+class TestArchiveIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void listsTar();
+    void rejectsTarSizePastEnd();
+    void rejectsNegativeTarSize();
+    void rejectsTarChecksum();
+    void rejectsOversizedLongName();
+    void listsZip();
+    void rejectsZipDirectoryPastEnd();
+    void rejectsZipEntryCount();
+    void splitsMemberPaths();
+    void refusesOptionLikeZipMember();
+
+private:
+    QString write(const QString& name, const QByteArray& data);
+
+    QTemporaryDir dir;
+};
+
+// A ustar header; the checksum is filled in by seal().
+static QByteArray tarHeader(const QByteArray& name, qint64 size, char type) {
+    QByteArray header(512, '\0');
+    header.replace(0, name.size(), name);
+    header.replace(100, 8, QByteArray("0000644").append('\0'));
+    header.replace(124, 12, QByteArray::number(size, 8).rightJustified(11, '0').append('\0'));
+    header.replace(136, 12, QByteArray("00000000000").append('\0'));
+    header[156] = type;
+    header.replace(257, 8, QByteArray("ustar\0" "00", 8));
+    return header;
+}
+
+static QByteArray seal(QByteArray header) {
+    header.replace(148, 8, QByteArray(8, ' '));
+    int sum = 0;
+    for (char byte: header) {
+        sum += uchar(byte);
+    }
+    header.replace(148, 8, QByteArray::number(sum, 8).rightJustified(6, '0').append('\0').append(' '));
+    return header;
+}
+
+static QByteArray tarData(const QByteArray& data) {
+    return data + QByteArray((512 - data.size() % 512) % 512, '\0');
+}
+
+static QByteArray paxRecord(const QByteArray& keyword, const QByteArray& value) {
+    // The length counts itself.
+    const QByteArray body = " " + keyword + "=" + value + "\n";
+    int length = int(body.size()) + 1;
+    while (QByteArray::number(length).size() + body.size() != length) {
+        ++length;
+    }
+    return QByteArray::number(length) + body;
+}
+
+static QByteArray tarEnd() {
+    return QByteArray(1024, '\0');
+}
+
+struct ZipEntry {
+    QByteArray name;
+    bool utf8;
+};
+
+// A central directory and its end record behind some stand-in member data.
+// Nothing else is read when listing.
+static QByteArray zipArchive(const QList<ZipEntry>& entries, quint16 entryCount, quint32 directoryOffsetShift = 0) {
+    QByteArray archive(64, 'x');
+    const quint32 directoryOffset = quint32(archive.size());
+    for (const ZipEntry& entry: entries) {
+        QByteArray record(46, '\0');
+        qToLittleEndian<quint32>(0x02014b50, record.data());
+        qToLittleEndian<quint16>(entry.utf8 ? 0x800 : 0, record.data() + 8);
+        qToLittleEndian<quint16>(quint16(entry.name.size()), record.data() + 28);
+        archive += record + entry.name;
+    }
+    QByteArray end(22, '\0');
+    end.replace(0, 4, QByteArray("PK\x05\x06", 4));
+    qToLittleEndian<quint16>(entryCount, end.data() + 8);
+    qToLittleEndian<quint16>(entryCount, end.data() + 10);
+    qToLittleEndian<quint32>(quint32(archive.size()) - directoryOffset, end.data() + 12);
+    qToLittleEndian<quint32>(directoryOffset + directoryOffsetShift, end.data() + 16);
+    return archive + end;
+}
+
+void TestArchiveIndex::initTestCase() {
+    QVERIFY(dir.isValid());
+}
+
+QString TestArchiveIndex::write(const QString& name, const QByteArray& data) {
+    const QString path = dir.filePath(name);
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()) {
+        return QString();
+    }
+    return path;
+}
+
+void TestArchiveIndex::listsTar() {
+    const QByteArray longName = "long/" + QByteArray(150, 'n') + ".txt";
+    QByteArray tar;
+    tar += seal(tarHeader("dir/", 0, '5'));
+    tar += seal(tarHeader("dir/a.txt", 5, '0')) + tarData("hello");
+    tar += seal(tarHeader("././@LongLink", longName.size() + 1, 'L')) + tarData(longName + '\0');
+    tar += seal(tarHeader("truncated", 0, '0'));
+    const QByteArray pax = paxRecord("path", "pax/name.txt");
+    tar += seal(tarHeader("PaxHeader", pax.size(), 'x')) + tarData(pax);
+    tar += seal(tarHeader("ignored", 0, '0'));
+    tar += tarEnd();
+
+    QStringList members;
+    QVERIFY(ArchiveIndex::list(write("plain.tar", tar), members));
+    QCOMPARE(members, QStringList({"dir", "dir/a.txt", QString::fromLatin1(longName), "pax/name.txt"}));
+}
+
+void TestArchiveIndex::rejectsTarSizePastEnd() {
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("past-end.tar", seal(tarHeader("a", 10000, '0')) + tarEnd()), members));
+}
+
+void TestArchiveIndex::rejectsNegativeTarSize() {
+    // Base-256 with the sign bit set.
+    QByteArray header = tarHeader("a", 0, '0');
+    header.replace(124, 12, QByteArray(12, '\xff'));
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("negative.tar", seal(header) + tarEnd()), members));
+}
+
+void TestArchiveIndex::rejectsTarChecksum() {
+    QByteArray header = seal(tarHeader("a", 0, '0'));
+    header[0] = 'b';
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("checksum.tar", header + tarEnd()), members));
+}
+
+void TestArchiveIndex::rejectsOversizedLongName() {
+    const qint64 size = 2 << 20;
+    const QByteArray tar = seal(tarHeader("././@LongLink", size, 'L')) + QByteArray(size, 'n')
+                           + seal(tarHeader("a", 0, '0')) + tarEnd();
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("long-name.tar", tar), members));
+}
+
+void TestArchiveIndex::listsZip() {
+    const QByteArray accented("\xc3\xa9t\xc3\xa9.txt");
+    const QByteArray zip = zipArchive({{"a.txt", false}, {"sub/", false}, {"sub/b.txt", false}, {accented, true}}, 4);
+    QStringList members;
+    QVERIFY(ArchiveIndex::list(write("plain.zip", zip), members));
+    QCOMPARE(members, QStringList({"a.txt", "sub", "sub/b.txt", QString::fromUtf8(accented)}));
+}
+
+void TestArchiveIndex::rejectsZipDirectoryPastEnd() {
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("past-end.zip", zipArchive({{"a.txt", false}}, 1, 1 << 20)), members));
+}
+
+void TestArchiveIndex::rejectsZipEntryCount() {
+    // More entries claimed than the directory holds.
+    QStringList members;
+    QVERIFY(!ArchiveIndex::list(write("count.zip", zipArchive({{"a.txt", false}}, 2)), members));
+}
+
+void TestArchiveIndex::splitsMemberPaths() {
+    const QString archive = write("nested.zip", zipArchive({{"a.txt", false}}, 1));
+    const QString path = ArchiveIndex::memberPath(archive, "dir/a.txt");
+    QString archivePath;
+    QString member;
+    QVERIFY(ArchiveIndex::splitMemberPath(path, archivePath, member));
+    QCOMPARE(archivePath, archive);
+    QCOMPARE(member, QString("dir/a.txt"));
+    QVERIFY(!ArchiveIndex::splitMemberPath(dir.filePath("missing.zip") + ArchiveIndex::separator + "a", archivePath,
+                                           member));
+}
+
+void TestArchiveIndex::refusesOptionLikeZipMember() {
+    const QString archive = write("options.zip", zipArchive({{"-x", false}}, 1));
+    const QString destination = dir.filePath("extracted");
+    QVERIFY(!ArchiveIndex::extractMember(archive, "-x", destination));
+    QVERIFY(!QFile::exists(destination));
+}
+
+QTEST_GUILESS_MAIN(TestArchiveIndex)
+#include "tst_archiveindex.moc"
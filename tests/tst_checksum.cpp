@@ -0,0 +1,125 @@
+#include <QtTest>
+
+#include <cstring>
+
+#include "checksum.h"
+
+
+class TestChecksum : public QObject {
+    Q_OBJECT
+
+private slots:
+    void matchesReference_data();
+    void matchesReference();
+    void usesSeed();
+    void streamsInPieces();
+    void hashesZeros();
+    void pipeMatchesChecksum_data();
+    void pipeMatchesChecksum();
+};
+
+// A byte pattern that is neither zeros nor repeating at any lane width.
+static QByteArray pattern(int size) {
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        data[i] = char((i * 31 + 7) & 0xff);
+    }
+    return data;
+}
+
+static quint64 hashOf(const QByteArray& data, quint64 seed = 0) {
+    return Checksum::of(data.constData(), data.size(), seed);
+}
+
+// Reference values from the xxHash library's XXH64.
+void TestChecksum::matchesReference_data() {
+    QTest::addColumn<QByteArray>("data");
+    QTest::addColumn<quint64>("expected");
+
+    QTest::newRow("empty") << QByteArray() << quint64(0xef46db3751d8e999ULL);
+    QTest::newRow("abc") << QByteArray("abc") << quint64(0x44bc2cf5ad770999ULL);
+    // Below 32 bytes only the tail rounds run: bytes, a 4-byte word, 8-byte
+    // words, and all of them.
+    QTest::newRow("1") << pattern(1) << quint64(0xa96c7f0ce858bbb7ULL);
+    QTest::newRow("3") << pattern(3) << quint64(0x56e6957632a487f9ULL);
+    QTest::newRow("4") << pattern(4) << quint64(0xc60d15b1e3ff8f04ULL);
+    QTest::newRow("8") << pattern(8) << quint64(0x3da5c7aa269683e0ULL);
+    QTest::newRow("15") << pattern(15) << quint64(0xae2a37eb9357caa7ULL);
+    QTest::newRow("31") << pattern(31) << quint64(0x4a74f3a1a39ad4a1ULL);
+    // From 32 bytes on the four lanes run, followed by the tail.
+    QTest::newRow("32") << pattern(32) << quint64(0x8d57d6a4671cc43dULL);
+    QTest::newRow("33, 1-byte tail") << pattern(33) << quint64(0x62c9fd21ed857664ULL);
+    QTest::newRow("36, 4-byte tail") << pattern(36) << quint64(0xa4475c606b0abc3cULL);
+    QTest::newRow("40, 8-byte tail") << pattern(40) << quint64(0x49b45332e280f187ULL);
+    QTest::newRow("63") << pattern(63) << quint64(0x5c320a0d2707057fULL);
+    QTest::newRow("64") << pattern(64) << quint64(0x7bbabbc45729d17eULL);
+    QTest::newRow("100") << pattern(100) << quint64(0xefa0ad2d3e70c151ULL);
+    QTest::newRow("1000") << pattern(1000) << quint64(0x99594f4828043d35ULL);
+}
+
+void TestChecksum::matchesReference() {
+    QFETCH(QByteArray, data);
+    QFETCH(quint64, expected);
+    QCOMPARE(hashOf(data), expected);
+}
+
+void TestChecksum::usesSeed() {
+    QCOMPARE(hashOf(pattern(40), 0x9e3779b97f4a7c15ULL), quint64(0x36758d31812c0e57ULL));
+}
+
+void TestChecksum::streamsInPieces() {
+    // Pieces that fill the pending block partly, exactly, and past it.
+    const QByteArray data = pattern(1000);
+    Checksum checksum;
+    int offset = 0;
+    for (int size: {1, 2, 29, 3, 64, 7, 500}) {
+        checksum.update(data.constData() + offset, size);
+        offset += size;
+    }
+    checksum.update(data.constData() + offset, data.size() - offset);
+    QCOMPARE(checksum.digest(), quint64(0x99594f4828043d35ULL));
+}
+
+void TestChecksum::hashesZeros() {
+    // The hole of a sparse file, longer than the block of zeros fed per
+    // update, between data that leaves the lanes half filled.
+    Checksum checksum;
+    checksum.update("head", 4);
+    checksum.updateZeros(100000);
+    checksum.update("tail", 4);
+    QCOMPARE(checksum.digest(), quint64(0x41dda76a46ef4febULL));
+
+    Checksum zeros;
+    zeros.updateZeros(70000);
+    QCOMPARE(zeros.digest(), quint64(0x11ac2d3b5eeb65f8ULL));
+    QCOMPARE(zeros.digest(), hashOf(QByteArray(70000, '\0')));
+}
+
+void TestChecksum::pipeMatchesChecksum_data() {
+    QTest::addColumn<bool>("threaded");
+    QTest::newRow("inline") << false;
+    QTest::newRow("threaded") << true;
+}
+
+void TestChecksum::pipeMatchesChecksum() {
+    QFETCH(bool, threaded);
+    const qint64 bufferSize = 4096;
+    const QByteArray data = pattern(int(3 * bufferSize + 123));
+
+    ChecksumPipe pipe(bufferSize, threaded);
+    for (qint64 offset = 0; offset < data.size(); offset += bufferSize) {
+        const qint64 size = qMin(bufferSize, qint64(data.size()) - offset);
+        char* buffer = pipe.acquire();
+        std::memcpy(buffer, data.constData() + offset, size_t(size));
+        pipe.submit(buffer, size);
+    }
+    pipe.submitZeros(5000);
+
+    Checksum expected;
+    expected.update(data.constData(), data.size());
+    expected.updateZeros(5000);
+    QCOMPARE(pipe.finish(), expected.digest());
+}
+
+QTEST_GUILESS_MAIN(TestChecksum)
+#include "tst_checksum.moc"
@@ -0,0 +1,89 @@
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QtTest>
+
+#include "copyjournal.h"
+
+
+class TestCopyJournal : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void reloadsSeveralItems();
+    void readsSingleItemJournal();
+    void finishRemovesJournal();
+};
+
+void TestCopyJournal::initTestCase() {
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestCopyJournal::cleanup() {
+    QDir(CopyJournal::journalDirectory()).removeRecursively();
+}
+
+void TestCopyJournal::reloadsSeveralItems() {
+    QString journalPath;
+    {
+        CopyJournal journal;
+        QVERIFY(journal.create(CopyJournal::Move, {"/a/one", "/a/two", "/b/three"},
+                               {"/dst/one", "/dst/two", "/dst/three"}));
+        QCOMPARE(journal.itemKey(1), QString("1"));
+        journal.recordCompleted(journal.itemKey(0));
+        journal.recordPartial(journal.itemKey(1) + "/big", 4096);
+        journal.recordCompleted(journal.itemKey(2) + "/small");
+        QVERIFY(journal.confirmCopy({0, 2}));
+        journal.recordRemoved(0);
+        journalPath = journal.journalPath();
+    }
+    QCOMPARE(CopyJournal::pendingJournals(), QStringList{journalPath});
+
+    CopyJournal journal;
+    QVERIFY(journal.load(journalPath));
+    QCOMPARE(journal.operation(), CopyJournal::Move);
+    QCOMPARE(journal.itemCount(), 3);
+    QCOMPARE(journal.sourcePath(2), QString("/b/three"));
+    QCOMPARE(journal.destinationPath(1), QString("/dst/two"));
+    QVERIFY(journal.isCompleted("0"));
+    QVERIFY(journal.isCompleted("2/small"));
+    QCOMPARE(journal.resumeOffset("1/big"), qint64(4096));
+    QVERIFY(journal.isCopyConfirmed(0));
+    QVERIFY(!journal.isCopyConfirmed(1));
+    QVERIFY(journal.isCopyConfirmed(2));
+    QVERIFY(journal.isRemoved(0));
+    QVERIFY(!journal.isRemoved(2));
+}
+
+void TestCopyJournal::readsSingleItemJournal() {
+    // The layout written before journals held several items.
+    QDir().mkpath(CopyJournal::journalDirectory());
+    const QString journalPath = CopyJournal::journalDirectory() + "/old.journal";
+    QFile file(journalPath);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("FMJOURNAL 1\nOP move\nSRC /src/dir\nDST /dst/dir\nDONE a/b\nCOPIED\n");
+    file.close();
+
+    CopyJournal journal;
+    QVERIFY(journal.load(journalPath));
+    QCOMPARE(journal.itemCount(), 1);
+    QCOMPARE(journal.itemKey(0), QString());
+    QCOMPARE(journal.sourcePath(), QString("/src/dir"));
+    QVERIFY(journal.isCompleted("a/b"));
+    QVERIFY(journal.isCopyConfirmed());
+}
+
+void TestCopyJournal::finishRemovesJournal() {
+    CopyJournal journal;
+    QVERIFY(journal.create(CopyJournal::Copy, "/src", "/dst"));
+    const QString journalPath = journal.journalPath();
+    QVERIFY(QFile::exists(journalPath));
+    journal.finish();
+    QVERIFY(!QFile::exists(journalPath));
+    QVERIFY(CopyJournal::pendingJournals().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestCopyJournal)
+#include "tst_copyjournal.moc"
@@ -0,0 +1,101 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "copyplan.h"
+
+
+class TestCopyPlan : public QObject {
+    Q_OBJECT
+
+private slots:
+    void collectsFilesAndDirectories();
+    void keepsLinksAsLinks();
+    void rejectsSpecialFiles();
+};
+
+static void writeFile(const QString& path) {
+    QFile file(path);
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("data");
+}
+
+static const CopyPlan::Item* findItem(const QVector<CopyPlan::Item>& items, const QString& relativePath) {
+    for (const CopyPlan::Item& item: items) {
+        if (item.relativePath == relativePath) {
+            return &item;
+        }
+    }
+    return nullptr;
+}
+
+void TestCopyPlan::collectsFilesAndDirectories() {
+    QTemporaryDir source;
+    QTemporaryDir destination;
+    QVERIFY(QDir(source.path()).mkpath("sub/empty"));
+    writeFile(source.filePath("a"));
+    writeFile(source.filePath("sub/.hidden"));
+
+    QVector<CopyPlan::Item> items;
+    QVERIFY(CopyPlan::collect(source.path(), destination.path(), QString(), items));
+    QCOMPARE(items.size(), 2);
+    QVERIFY(findItem(items, "a"));
+    QVERIFY(findItem(items, "sub/.hidden"));
+    QVERIFY(!findItem(items, "a")->symLink);
+    // Empty directories are made while planning.
+    QVERIFY(QFileInfo(destination.filePath("sub/empty")).isDir());
+}
+
+void TestCopyPlan::keepsLinksAsLinks() {
+#ifdef Q_OS_UNIX
+    QTemporaryDir source;
+    QTemporaryDir destination;
+    QTemporaryDir outside;
+    writeFile(outside.filePath("big"));
+    QVERIFY(QDir(source.path()).mkdir("sub"));
+    writeFile(source.filePath("file"));
+    QVERIFY(QFile::link("file", source.filePath("toFile")));
+    QVERIFY(QFile::link(outside.path(), source.filePath("outside")));
+    QVERIFY(QFile::link("missing", source.filePath("broken")));
+    QVERIFY(QFile::link("..", source.filePath("sub/cycle")));
+
+    QVector<CopyPlan::Item> items;
+    QVERIFY(CopyPlan::collect(source.path(), destination.path(), QString(), items));
+    QCOMPARE(items.size(), 5);
+    for (const QString& link: {"toFile", "outside", "broken", "sub/cycle"}) {
+        QVERIFY2(findItem(items, link), qPrintable(link));
+        QVERIFY2(findItem(items, link)->symLink, qPrintable(link));
+    }
+    QVERIFY(!findItem(items, "outside/big"));
+
+    // Stat describes the links, not their targets.
+    CopyPlan::stat(items);
+    QVERIFY(S_ISLNK(findItem(items, "outside")->mode));
+    QVERIFY(S_ISLNK(findItem(items, "broken")->mode));
+    QVERIFY(S_ISREG(findItem(items, "file")->mode));
+#else
+    QSKIP("Needs symbolic links");
+#endif
+}
+
+void TestCopyPlan::rejectsSpecialFiles() {
+#ifdef Q_OS_UNIX
+    QTemporaryDir source;
+    QTemporaryDir destination;
+    writeFile(source.filePath("file"));
+    QCOMPARE(::mkfifo(QFile::encodeName(source.filePath("pipe")).constData(), 0600), 0);
+
+    QVector<CopyPlan::Item> items;
+    QVERIFY(!CopyPlan::collect(source.path(), destination.path(), QString(), items));
+#else
+    QSKIP("Needs FIFOs");
+#endif
+}
+
+QTEST_GUILESS_MAIN(TestCopyPlan)
+#include "tst_copyplan.moc"
@@ -0,0 +1,82 @@
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "dirwatcher.h"
+
+
+class TestDirWatcher : public QObject {
+    Q_OBJECT
+
+private slots:
+    void growingFileOnlyReportsModified();
+    void reportsCreatedAndRemoved();
+};
+
+// A log being written to: the watcher must report it as modified, which the
+// panes take without listing the directory again, and no more than once per
+// batch window.
+void TestDirWatcher::growingFileOnlyReportsModified() {
+    QTemporaryDir dir;
+    QFile log(dir.filePath("growing.log"));
+    QVERIFY(log.open(QIODevice::WriteOnly | QIODevice::Unbuffered));
+
+    DirWatcher watcher;
+    if (watcher.backend() == DirWatcher::Polling) {
+        QSKIP("Needs kernel file notifications");
+    }
+    const int interval = 100;
+    const int duration = 1500;
+    watcher.setBatchInterval(interval);
+    QSignalSpy changes(&watcher, &DirWatcher::directoryChanged);
+    QSignalSpy rescans(&watcher, &DirWatcher::rescanRequired);
+    QVERIFY(watcher.addPath(dir.path()));
+
+    QElapsedTimer timer;
+    timer.start();
+    while (timer.elapsed() < duration) {
+        log.write("another line\n");
+        QTest::qWait(5);
+    }
+    QTest::qWait(interval * 3);
+
+    QVERIFY(changes.size() >= 2);
+    QVERIFY(changes.size() <= duration / interval + 2);
+    QCOMPARE(rescans.size(), 0);
+    for (const QList<QVariant>& change: changes) {
+        QCOMPARE(change.at(0).toString(), dir.path());
+        QVERIFY(change.at(1).toStringList().isEmpty());
+        QCOMPARE(change.at(2).toStringList(), QStringList{"growing.log"});
+        QVERIFY(change.at(3).toStringList().isEmpty());
+    }
+}
+
+void TestDirWatcher::reportsCreatedAndRemoved() {
+    QTemporaryDir dir;
+    QFile old(dir.filePath("old"));
+    QVERIFY(old.open(QIODevice::WriteOnly));
+    old.close();
+
+    DirWatcher watcher;
+    if (watcher.backend() == DirWatcher::Polling) {
+        QSKIP("Needs kernel file notifications");
+    }
+    watcher.setBatchInterval(50);
+    QSignalSpy changes(&watcher, &DirWatcher::directoryChanged);
+    QVERIFY(watcher.addPath(dir.path()));
+
+    QFile created(dir.filePath("new"));
+    QVERIFY(created.open(QIODevice::WriteOnly));
+    created.close();
+    QVERIFY(QFile::remove(dir.filePath("old")));
+    QTRY_COMPARE(changes.size(), 1);
+
+    const QList<QVariant> change = changes.first();
+    QCOMPARE(change.at(1).toStringList(), QStringList{"new"});
+    QCOMPARE(change.at(3).toStringList(), QStringList{"old"});
+}
+
+QTEST_GUILESS_MAIN(TestDirWatcher)
+#include "tst_dirwatcher.moc"
@@ -0,0 +1,91 @@
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "pathindex.h"
+
+
+class TestPathIndex : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void indexesEveryEntry();
+    void ranksRunsAboveScatteredMatches();
+    void matchesAcrossDirectories();
+    void ignoresCase();
+    void rejectsEmptyPattern();
+    void listsFilesSince();
+
+private:
+    QStringList relativePaths(const QVector<PathIndex::Match>& matches) const;
+
+    QTemporaryDir root;
+    PathIndex index;
+};
+
+void TestPathIndex::initTestCase() {
+    QVERIFY(root.isValid());
+    const QDir dir(root.path());
+    QVERIFY(dir.mkpath("alpha/beta"));
+    QVERIFY(dir.mkpath("gamma"));
+    for (const QString& name: {"alpha/beta/report.txt", "alpha/notes.md", "gamma/rep_ort.cfg", "README"}) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+    }
+
+    index.start(root.path());
+    QTRY_VERIFY(!index.isBuilding());
+}
+
+QStringList TestPathIndex::relativePaths(const QVector<PathIndex::Match>& matches) const {
+    QStringList paths;
+    for (const PathIndex::Match& match: matches) {
+        paths.append(index.relativePath(match.entry));
+    }
+    return paths;
+}
+
+void TestPathIndex::indexesEveryEntry() {
+    QCOMPARE(index.rootPath(), root.path());
+    QCOMPARE(index.size(), 7);
+}
+
+void TestPathIndex::ranksRunsAboveScatteredMatches() {
+    const QStringList paths = relativePaths(index.search("report", 10));
+    QCOMPARE(paths, QStringList({"alpha/beta/report.txt", "gamma/rep_ort.cfg"}));
+}
+
+void TestPathIndex::matchesAcrossDirectories() {
+    // "beta/" is covered by the directory, "rep" by the name.
+    QCOMPARE(relativePaths(index.search("beta/rep", 10)), QStringList({"alpha/beta/report.txt"}));
+    QCOMPARE(relativePaths(index.search("gamma/notes", 10)), QStringList());
+}
+
+void TestPathIndex::ignoresCase() {
+    const QVector<PathIndex::Match> matches = index.search("readme", 10);
+    QCOMPARE(relativePaths(matches), QStringList({"README"}));
+    QCOMPARE(index.path(matches.first().entry), QDir(root.path()).filePath("README"));
+    QVERIFY(!index.isDirectory(matches.first().entry));
+}
+
+void TestPathIndex::rejectsEmptyPattern() {
+    QVERIFY(index.search(QString(), 10).isEmpty());
+    QVERIFY(index.search("   ", 10).isEmpty());
+    QVERIFY(index.search("report", 0).isEmpty());
+}
+
+void TestPathIndex::listsFilesSince() {
+    int next = 0;
+    const QVector<int> files = index.filesSince(next);
+    QCOMPARE(next, index.size());
+    QCOMPARE(files.size(), 4);
+    for (int entry: files) {
+        QVERIFY(!index.isDirectory(entry));
+    }
+    QVERIFY(index.filesSince(next).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestPathIndex)
+#include "tst_pathindex.moc"
@@ -0,0 +1,95 @@
+#include <QThread>
+#include <QtTest>
+
+#include "progressring.h"
+
+
+class TestProgressRing : public QObject {
+    Q_OBJECT
+
+private slots:
+    void popsInOrder();
+    void refusesWhenFull();
+    void wrapsAround();
+    void handsOverBetweenThreads();
+};
+
+void TestProgressRing::popsInOrder() {
+    ProgressRing<QString, 4> ring;
+    QString value;
+    QVERIFY(!ring.pop(value));
+    QVERIFY(ring.push("a"));
+    QVERIFY(ring.push("b"));
+    QVERIFY(ring.pop(value));
+    QCOMPARE(value, QString("a"));
+    QVERIFY(ring.pop(value));
+    QCOMPARE(value, QString("b"));
+    QVERIFY(!ring.pop(value));
+}
+
+void TestProgressRing::refusesWhenFull() {
+    ProgressRing<int, 4> ring;
+    for (int i = 0; i < 4; ++i) {
+        QVERIFY(ring.push(i));
+    }
+    QVERIFY(!ring.push(4));
+
+    // The refused value is lost; the ones before it are not.
+    int value;
+    QVERIFY(ring.pop(value));
+    QCOMPARE(value, 0);
+    QVERIFY(ring.push(5));
+    for (int expected: {1, 2, 3, 5}) {
+        QVERIFY(ring.pop(value));
+        QCOMPARE(value, expected);
+    }
+}
+
+void TestProgressRing::wrapsAround() {
+    ProgressRing<int, 3> ring;
+    int value;
+    for (int i = 0; i < 1000; ++i) {
+        QVERIFY(ring.push(i));
+        QVERIFY(ring.push(-i));
+        QVERIFY(ring.pop(value));
+        QCOMPARE(value, i);
+        QVERIFY(ring.pop(value));
+        QCOMPARE(value, -i);
+    }
+}
+
+void TestProgressRing::handsOverBetweenThreads() {
+    static const int count = 200000;
+    ProgressRing<int, 16> ring;
+    QThread* producer = QThread::create([&ring]() {
+        for (int i = 0; i < count;) {
+            if (ring.push(i)) {
+                ++i;
+            } else {
+                QThread::yieldCurrentThread();
+            }
+        }
+    });
+    producer->start();
+
+    // Every value arrives once and in order. All are taken before
+    // checking, so the producer is never left waiting on a full ring.
+    int outOfOrder = -1;
+    for (int next = 0; next < count;) {
+        int value;
+        if (ring.pop(value)) {
+            if (value != next && outOfOrder < 0) {
+                outOfOrder = next;
+            }
+            ++next;
+        } else {
+            QThread::yieldCurrentThread();
+        }
+    }
+    QVERIFY(producer->wait(5000));
+    delete producer;
+    QCOMPARE(outOfOrder, -1);
+}
+
+QTEST_GUILESS_MAIN(TestProgressRing)
+#include "tst_progressring.moc"
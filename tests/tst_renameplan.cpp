@@ -0,0 +1,170 @@
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "renameplan.h"
+
+
+class TestRenamePlan : public QObject {
+    Q_OBJECT
+
+private slots:
+    void renamesSingleItem();
+    void keepsExtension();
+    void changesCase();
+    void ordersChains();
+    void breaksCyclesWithTemporaryName();
+    void flagsDuplicates();
+    void flagsTakenNamesAndTheirChains();
+    void flagsInvalidNames();
+    void ignoresInvalidExpression();
+    void undoesBrokenCycle();
+};
+
+static RenameRule replaceRule(const QString& pattern, const QString& replacement, bool regularExpression = false) {
+    RenameRule rule;
+    rule.pattern = pattern;
+    rule.replacement = replacement;
+    rule.regularExpression = regularExpression;
+    return rule;
+}
+
+static RenamePlan buildPlan(const QStringList& names, const RenameRule& rule,
+                            const QStringList& others = QStringList()) {
+    QSet<QString> existing(names.begin(), names.end());
+    existing.unite(QSet<QString>(others.begin(), others.end()));
+    return RenamePlan::build("/dir", names, existing, rule);
+}
+
+void TestRenamePlan::renamesSingleItem() {
+    const RenamePlan plan = buildPlan({"a.txt", "b.txt"}, replaceRule("a", "x"));
+    QCOMPARE(plan.directory(), QString("/dir"));
+    QCOMPARE(plan.items().at(0).to, QString("x.txt"));
+    QCOMPARE(plan.items().at(0).status, RenamePlan::Ready);
+    QCOMPARE(plan.items().at(1).status, RenamePlan::Unchanged);
+    QCOMPARE(plan.steps().size(), 1);
+    QCOMPARE(plan.steps().first().from, QString("a.txt"));
+    QCOMPARE(plan.steps().first().to, QString("x.txt"));
+    QVERIFY(plan.steps().first().startsGroup);
+}
+
+void TestRenamePlan::keepsExtension() {
+    RenameRule rule = replaceRule("txt", "md");
+    QCOMPARE(buildPlan({"txt.txt"}, rule).items().first().to, QString("md.txt"));
+    // A leading dot is a hidden file's name, not an extension.
+    QCOMPARE(buildPlan({".txt"}, rule).items().first().to, QString(".md"));
+    rule.keepExtension = false;
+    QCOMPARE(buildPlan({"txt.txt"}, rule).items().first().to, QString("md.md"));
+}
+
+void TestRenamePlan::changesCase() {
+    RenameRule rule;
+    rule.caseChange = RenameRule::TitleCase;
+    QCOMPARE(buildPlan({"hello wORLD.TXT"}, rule).items().first().to, QString("Hello World.TXT"));
+    rule.caseChange = RenameRule::UpperCase;
+    QCOMPARE(buildPlan({"abc.txt"}, rule).items().first().to, QString("ABC.txt"));
+}
+
+void TestRenamePlan::ordersChains() {
+    // "1" goes to "2" while "2" goes to "3", so "2" has to move first.
+    RenameRule rule = replaceRule(".+", "{n}", true);
+    rule.numberStart = 2;
+    const RenamePlan plan = buildPlan({"1", "2"}, rule);
+    QCOMPARE(plan.count(RenamePlan::Ready), 2);
+    QCOMPARE(plan.steps().size(), 2);
+    QCOMPARE(plan.steps().at(0).from, QString("2"));
+    QCOMPARE(plan.steps().at(0).to, QString("3"));
+    QVERIFY(plan.steps().at(0).startsGroup);
+    QCOMPARE(plan.steps().at(1).from, QString("1"));
+    QCOMPARE(plan.steps().at(1).to, QString("2"));
+    QVERIFY(!plan.steps().at(1).startsGroup);
+}
+
+void TestRenamePlan::breaksCyclesWithTemporaryName() {
+    // "2" and "1" swap names.
+    const RenamePlan plan = buildPlan({"2", "1"}, replaceRule(".+", "{n}", true));
+    QCOMPARE(plan.items().at(0).to, QString("1"));
+    QCOMPARE(plan.items().at(1).to, QString("2"));
+    QVERIFY(plan.items().at(0).inCycle);
+    QVERIFY(plan.items().at(1).inCycle);
+
+    const QVector<RenamePlan::Step>& steps = plan.steps();
+    QCOMPARE(steps.size(), 3);
+    const QString temporary = steps.at(0).to;
+    QCOMPARE(steps.at(0).from, QString("2"));
+    QVERIFY(steps.at(0).toTemporary);
+    QVERIFY(steps.at(0).startsGroup);
+    QCOMPARE(steps.at(1).from, QString("1"));
+    QCOMPARE(steps.at(1).to, QString("2"));
+    QCOMPARE(steps.at(2).from, temporary);
+    QCOMPARE(steps.at(2).to, QString("1"));
+    QCOMPARE(steps.at(2).fallback, QString("2"));
+}
+
+void TestRenamePlan::flagsDuplicates() {
+    const RenamePlan plan = buildPlan({"a1", "a2", "b"}, replaceRule("\\d", "", true));
+    QCOMPARE(plan.count(RenamePlan::Duplicate), 2);
+    QCOMPARE(plan.count(RenamePlan::Unchanged), 1);
+    QVERIFY(plan.steps().isEmpty());
+}
+
+void TestRenamePlan::flagsTakenNamesAndTheirChains() {
+    QCOMPARE(buildPlan({"a"}, replaceRule("a", "b"), {"b"}).items().first().status, RenamePlan::Exists);
+
+    // "3" stays where it is, so "2" cannot move, and neither can "1".
+    RenameRule rule = replaceRule(".+", "{n}", true);
+    rule.numberStart = 2;
+    const RenamePlan plan = buildPlan({"1", "2"}, rule, {"3"});
+    QCOMPARE(plan.count(RenamePlan::Exists), 2);
+    QVERIFY(plan.steps().isEmpty());
+}
+
+void TestRenamePlan::flagsInvalidNames() {
+    QCOMPARE(buildPlan({"a"}, replaceRule("a", "x/y")).items().first().status, RenamePlan::Invalid);
+    QCOMPARE(buildPlan({"a"}, replaceRule("a", "")).items().first().status, RenamePlan::Invalid);
+    QCOMPARE(buildPlan({"a"}, replaceRule("a", "..")).items().first().status, RenamePlan::Invalid);
+}
+
+void TestRenamePlan::ignoresInvalidExpression() {
+    const RenamePlan plan = buildPlan({"a", "b"}, replaceRule("(", "x", true));
+    QCOMPARE(plan.count(RenamePlan::Unchanged), 2);
+    QVERIFY(plan.steps().isEmpty());
+}
+
+void TestRenamePlan::undoesBrokenCycle() {
+    // The temporary name is taken after planning, so the cycle breaks at its
+    // first step, and nothing may be left renamed halfway.
+    QTemporaryDir dir;
+    for (const QString& name: {"1", "2"}) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(name.toUtf8());
+    }
+    const RenamePlan plan = RenamePlan::build(dir.path(), {"2", "1"}, {"1", "2"}, replaceRule(".+", "{n}", true));
+    QFile blocker(dir.filePath(plan.steps().at(0).to));
+    QVERIFY(blocker.open(QIODevice::WriteOnly));
+    blocker.close();
+
+    // The job reports from its worker thread; this queues the report here.
+    RenameJob job(plan);
+    int renamed = -1;
+    QStringList failures;
+    connect(&job, &RenameJob::finished, this, [&renamed, &failures](int count, const QStringList& failed) {
+        renamed = count;
+        failures = failed;
+    });
+    job.start();
+    QTRY_VERIFY_WITH_TIMEOUT(renamed >= 0, 5000);
+
+    QCOMPARE(renamed, 0);
+    QCOMPARE(failures.size(), 2);
+    QVERIFY(failures.at(0).startsWith("1: left unchanged"));
+    QVERIFY(failures.at(1).startsWith("2: "));
+    for (const QString& name: {"1", "2"}) {
+        QFile file(dir.filePath(name));
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QCOMPARE(file.readAll(), name.toUtf8());
+    }
+}
+
+QTEST_GUILESS_MAIN(TestRenamePlan)
+#include "tst_renameplan.moc"
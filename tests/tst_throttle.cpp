@@ -0,0 +1,114 @@
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtTest>
+
+#include "throttle.h"
+
+
+class TestThrottle : public QObject {
+    Q_OBJECT
+
+private slots:
+    void unlimitedNeverWaits();
+    void clampsNegativeRate();
+    void callerPaysOwnDebt();
+    void nextCallerStartsAfterDebt();
+    void rateChangeWakesWaiter();
+    void waitHandlerOnlyRunsInDebt();
+    void throttleReportsLimits();
+};
+
+void TestThrottle::unlimitedNeverWaits() {
+    TokenBucket bucket;
+    QElapsedTimer timer;
+    timer.start();
+    bucket.acquire(qint64(1) << 40);
+    bucket.setRate(1000);
+    bucket.acquire(0);
+    QVERIFY(timer.elapsed() < 50);
+}
+
+void TestThrottle::clampsNegativeRate() {
+    TokenBucket bucket;
+    bucket.setRate(-5);
+    QCOMPARE(bucket.rate(), qint64(0));
+}
+
+void TestThrottle::callerPaysOwnDebt() {
+    // Setting the rate empties the bucket, so a request of 0.3 s worth
+    // waits that long itself.
+    TokenBucket bucket;
+    bucket.setRate(1000);
+    QElapsedTimer timer;
+    timer.start();
+    bucket.acquire(300);
+    QVERIFY2(timer.elapsed() >= 280, qPrintable(QString::number(timer.elapsed())));
+    QVERIFY2(timer.elapsed() < 1000, qPrintable(QString::number(timer.elapsed())));
+}
+
+void TestThrottle::nextCallerStartsAfterDebt() {
+    // Once the first request's debt is paid off, the next one only waits
+    // for its own amount.
+    TokenBucket bucket;
+    bucket.setRate(1000);
+    bucket.acquire(300);
+    QElapsedTimer timer;
+    timer.start();
+    bucket.acquire(100);
+    QVERIFY2(timer.elapsed() >= 80, qPrintable(QString::number(timer.elapsed())));
+    QVERIFY2(timer.elapsed() < 280, qPrintable(QString::number(timer.elapsed())));
+}
+
+void TestThrottle::rateChangeWakesWaiter() {
+    TokenBucket bucket;
+    bucket.setRate(1000);
+    QThread* waiter = QThread::create([&bucket]() { bucket.acquire(60000); });
+    waiter->start();
+    QThread::msleep(50);
+    bucket.setRate(0);
+    QVERIFY(waiter->wait(2000));
+    delete waiter;
+}
+
+void TestThrottle::waitHandlerOnlyRunsInDebt() {
+    // A transfer gives up its disk slot through the handler, which must not
+    // happen for requests the bucket can serve at once.
+    TokenBucket bucket;
+    int waits = 0;
+    const TokenBucket::WaitHandler countWaits = [&waits](const std::function<void()>& wait) {
+        ++waits;
+        wait();
+    };
+
+    bucket.acquire(100, countWaits);
+    QCOMPARE(waits, 0);
+
+    bucket.setRate(1000);
+    QElapsedTimer timer;
+    timer.start();
+    bucket.acquire(100, countWaits);
+    QCOMPARE(waits, 1);
+    QVERIFY2(timer.elapsed() >= 80, qPrintable(QString::number(timer.elapsed())));
+
+    // A second's worth is saved up again after waiting that long.
+    QThread::msleep(1000);
+    bucket.acquire(500, countWaits);
+    QCOMPARE(waits, 1);
+}
+
+void TestThrottle::throttleReportsLimits() {
+    Throttle throttle;
+    QVERIFY(!throttle.isLimited());
+    throttle.setOperationsPerSecond(10);
+    QVERIFY(throttle.isLimited());
+    QCOMPARE(throttle.operationsPerSecond(), qint64(10));
+    throttle.setOperationsPerSecond(0);
+    throttle.setBytesPerSecond(1 << 20);
+    QVERIFY(throttle.isLimited());
+    QCOMPARE(throttle.bytesPerSecond(), qint64(1 << 20));
+    throttle.setIdlePriority(true);
+    QVERIFY(throttle.idlePriority());
+}
+
+QTEST_GUILESS_MAIN(TestThrottle)
+#include "tst_throttle.moc"
@@ -0,0 +1,146 @@
+#include <QMutexLocker>
+#include <QThread>
+#include <QDebug>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+#include "throttle.h"
+
+
+#ifdef Q_OS_LINUX
+// From linux/ioprio.h, which older kernel headers lack.
+static const int ioprioWhoProcess = 1;
+static const int ioprioClassShift = 13;
+static const int ioprioClassIdle = 3;
+#endif
+
+// A waiter wakes up this often to see whether the rate was changed.
+static const int waitSliceMilliseconds = 100;
+
+
+TokenBucket::TokenBucket()
+        : ratePerSecond(0),
+          tokens(0),
+          lastRefill(0),
+          generation(0) {
+    clock.start();
+}
+
+void TokenBucket::setRate(qint64 perSecond) {
+    QMutexLocker locker(&mutex);
+    ratePerSecond = qMax<qint64>(0, perSecond);
+    // Debt run up at the old rate is forgiven, so a raised limit takes
+    // effect at once.
+    tokens = 0;
+    lastRefill = clock.nsecsElapsed();
+    ++generation;
+}
+
+qint64 TokenBucket::rate() const {
+    QMutexLocker locker(&mutex);
+    return ratePerSecond;
+}
+
+void TokenBucket::acquire(qint64 amount, const WaitHandler& aroundWait) {
+    qint64 deadline;
+    int startGeneration;
+    {
+        QMutexLocker locker(&mutex);
+        if (ratePerSecond <= 0 || amount <= 0) {
+            return;
+        }
+        const qint64 now = clock.nsecsElapsed();
+        tokens = qMin(double(ratePerSecond), tokens + double(now - lastRefill) * double(ratePerSecond) / 1e9);
+        lastRefill = now;
+        tokens -= double(amount);
+        if (tokens >= 0) {
+            return;
+        }
+        deadline = now + qint64(-tokens * 1e9 / double(ratePerSecond));
+        startGeneration = generation;
+    }
+
+    const auto wait = [this, deadline, startGeneration]() {
+        forever {
+            const qint64 left = deadline - clock.nsecsElapsed();
+            if (left <= 0 || generation != startGeneration) {
+                return;
+            }
+            QThread::msleep(quint64(qMin<qint64>(left / 1000000 + 1, waitSliceMilliseconds)));
+        }
+    };
+    if (aroundWait) {
+        aroundWait(wait);
+    } else {
+        wait();
+    }
+}
+
+
+Throttle& Throttle::global() {
+    static Throttle throttle;
+    return throttle;
+}
+
+void Throttle::setBytesPerSecond(qint64 bytes) {
+    byteBucket.setRate(bytes);
+}
+
+qint64 Throttle::bytesPerSecond() const {
+    return byteBucket.rate();
+}
+
+void Throttle::setOperationsPerSecond(qint64 operations) {
+    operationBucket.setRate(operations);
+}
+
+qint64 Throttle::operationsPerSecond() const {
+    return operationBucket.rate();
+}
+
+bool Throttle::isLimited() const {
+    return bytesPerSecond() > 0 || operationsPerSecond() > 0;
+}
+
+void Throttle::setIdlePriority(bool idlePriority) {
+    idle = idlePriority;
+}
+
+bool Throttle::idlePriority() const {
+    return idle;
+}
+
+void Throttle::consume(qint64 byteCount, int operationCount, const TokenBucket::WaitHandler& aroundWait) {
+    operationBucket.acquire(operationCount, aroundWait);
+    byteBucket.acquire(byteCount, aroundWait);
+}
+
+void Throttle::applyIdlePriority(bool idle) {
+#ifdef Q_OS_LINUX
+    // Pool threads run one job after another, so whatever a job set is
+    // undone when it lets go of the thread.
+    static thread_local bool applied = false;
+    static thread_local long previous = 0;
+    if (idle == applied) {
+        return;
+    }
+    if (idle) {
+        // With "who" 0 the calls apply to the calling thread only.
+        const long current = ::syscall(SYS_ioprio_get, ioprioWhoProcess, 0);
+        if (current < 0 || ::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, ioprioClassIdle << ioprioClassShift) != 0) {
+            qWarning() << "Could not lower the I/O priority:" << qt_error_string(errno);
+            return;
+        }
+        previous = current;
+    } else if (::syscall(SYS_ioprio_set, ioprioWhoProcess, 0, previous) != 0) {
+        qWarning() << "Could not restore the I/O priority:" << qt_error_string(errno);
+    }
+    applied = idle;
+#else
+    Q_UNUSED(idle);
+#endif
+}
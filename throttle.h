@@ -0,0 +1,70 @@
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+#include <QElapsedTimer>
+#include <QMutex>
+
+#include <atomic>
+#include <functional>
+
+// Paces a stream of requests to a rate, allowing bursts of up to one
+// second's worth. A request larger than what is saved up puts the bucket
+// in debt, and its caller sleeps until the debt is paid off, so chunks
+// bigger than the rate still work. A rate of 0 means unlimited.
+class TokenBucket {
+public:
+    // Runs the blocking part of acquire(), so a caller can let go of what it
+    // holds for just as long.
+    using WaitHandler = std::function<void(const std::function<void()>& wait)>;
+
+    TokenBucket();
+
+    void setRate(qint64 perSecond);
+    qint64 rate() const;
+
+    // Takes amount from the bucket and, if that leaves it in debt, blocks
+    // until the refill has paid it off or the rate is changed. The block
+    // goes through aroundWait when there is one, and only then.
+    void acquire(qint64 amount, const WaitHandler& aroundWait = nullptr);
+
+private:
+    mutable QMutex mutex;
+    qint64 ratePerSecond;
+    double tokens;
+    QElapsedTimer clock;
+    qint64 lastRefill;
+    std::atomic<int> generation;
+};
+
+// Bytes and operations per second for one job, or for all of them through
+// global(). The limits and the idle priority can change while a job runs;
+// the next chunk it copies goes by the new ones.
+class Throttle {
+public:
+    Throttle() = default;
+
+    static Throttle& global();
+
+    void setBytesPerSecond(qint64 bytes);
+    qint64 bytesPerSecond() const;
+    void setOperationsPerSecond(qint64 operations);
+    qint64 operationsPerSecond() const;
+    bool isLimited() const;
+
+    // Idle I/O priority: the job's reads and writes are only served while
+    // the disk has nothing else to do. Linux only.
+    void setIdlePriority(bool idle);
+    bool idlePriority() const;
+
+    void consume(qint64 byteCount, int operationCount, const TokenBucket::WaitHandler& aroundWait = nullptr);
+
+    // Switches the calling thread's I/O priority to idle and back.
+    static void applyIdlePriority(bool idle);
+
+private:
+    TokenBucket byteBucket;
+    TokenBucket operationBucket;
+    std::atomic<bool> idle{false};
+};
+
+#endif // THROTTLE_H
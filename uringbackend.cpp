@@ -0,0 +1,372 @@
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QDebug>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_LINUX
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <cerrno>
+#endif
+
+#include "uringbackend.h"
+#include "iouring.h"
+
+
+#ifdef Q_OS_LINUX
+// Steps of the chain that copies one small file.
+enum CopyStep {
+    OpenSource,
+    OpenDestination,
+    Read,
+    Write,
+    CloseSource,
+    CloseDestination,
+    StepCount
+};
+
+// Submits everything queued on the ring and hands each of the expected
+// completions to handle.
+static bool drain(IoUring& ring, int expected, const std::function<void(quint64, int)>& handle) {
+    if (!ring.submit()) {
+        return false;
+    }
+    while (expected > 0) {
+        quint64 userData;
+        int result;
+        if (ring.nextCompletion(userData, result)) {
+            handle(userData, result);
+            --expected;
+        } else if (!ring.waitForCompletion()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Queues one STATX per path, relative to directoryFd, a batch per submission,
+// and hands each result to store; a failed stat has a negative result.
+static bool statAll(IoUring& ring, int directoryFd, int count, const std::function<QByteArray(int)>& pathAt,
+                    const std::function<void(int, int, const struct statx&)>& store) {
+    std::vector<struct statx> results(UringBackend::pathsPerBatch);
+    for (int start = 0; start < count; start += UringBackend::pathsPerBatch) {
+        const int batch = qMin(UringBackend::pathsPerBatch, count - start);
+        std::vector<QByteArray> encoded(batch);
+
+        for (int i = 0; i < batch; ++i) {
+            encoded[i] = pathAt(start + i);
+            io_uring_sqe* entry = ring.nextEntry();
+            entry->opcode = IORING_OP_STATX;
+            entry->fd = directoryFd;
+            entry->addr = reinterpret_cast<quint64>(encoded[i].constData());
+            entry->len = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_INO | STATX_SIZE | STATX_MTIME;
+            entry->statx_flags = AT_SYMLINK_NOFOLLOW;
+            entry->off = reinterpret_cast<quint64>(&results[i]);
+            entry->user_data = quint64(i);
+        }
+
+        bool drained = drain(ring, batch, [&](quint64 index, int result) {
+            store(start + int(index), result, results[index]);
+        });
+        if (!drained) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef IORING_RSRC_REGISTER_SPARSE
+// Files are created with the source mode, which the umask may narrow; those
+// few get the exact mode afterwards, like the streaming copy does.
+static mode_t processUmask() {
+    static const mode_t mask = []() {
+        QFile status("/proc/self/status");
+        if (status.open(QIODevice::ReadOnly)) {
+            for (const QByteArray& line: status.readAll().split('\n')) {
+                if (line.startsWith("Umask:")) {
+                    return mode_t(line.mid(6).trimmed().toUInt(nullptr, 8));
+                }
+            }
+        }
+        return mode_t(022);
+    }();
+    return mask;
+}
+#endif
+
+static void collectTree(const QString& path, int depth, QStringList& files, QVector<QStringList>& directories) {
+    if (directories.size() <= depth) {
+        directories.resize(depth + 1);
+    }
+    directories[depth].append(path);
+
+    const QFileInfoList entries = QDir(path).entryInfoList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot);
+    for (const QFileInfo& entry: entries) {
+        // Links are removed themselves, never followed.
+        if (entry.isDir() && !entry.isSymLink()) {
+            collectTree(entry.absoluteFilePath(), depth + 1, files, directories);
+        } else {
+            files.append(entry.absoluteFilePath());
+        }
+    }
+}
+
+static bool unlinkAll(IoUring& ring, const QStringList& paths, int flags) {
+    bool removed = true;
+    for (int start = 0; start < paths.size(); start += UringBackend::pathsPerBatch) {
+        const int count = qMin(UringBackend::pathsPerBatch, int(paths.size()) - start);
+        std::vector<QByteArray> encoded(count);
+
+        for (int i = 0; i < count; ++i) {
+            encoded[i] = QFile::encodeName(paths.at(start + i));
+            io_uring_sqe* entry = ring.nextEntry();
+            entry->opcode = IORING_OP_UNLINKAT;
+            entry->fd = AT_FDCWD;
+            entry->addr = reinterpret_cast<quint64>(encoded[i].constData());
+            entry->unlink_flags = flags;
+            entry->user_data = quint64(i);
+        }
+
+        bool drained = drain(ring, count, [&](quint64 index, int result) {
+            if (result < 0 && result != -ENOENT) {
+                qWarning() << "Could not remove" << paths.at(start + int(index)) << "-" << qt_error_string(-result);
+                removed = false;
+            }
+        });
+        if (!drained) {
+            return false;
+        }
+    }
+    return removed;
+}
+#endif
+
+
+bool UringBackend::isEnabled() {
+    // "io/backend=threads" forces the regular per-file path, for comparing
+    // the two or working around a misbehaving kernel.
+    static const bool enabled = IoUring::isSupported()
+            && QSettings().value("io/backend", "uring").toString() != "threads";
+    return enabled;
+}
+
+bool UringBackend::statFiles(QVector<CopyPlan::Item>& items) {
+#ifdef Q_OS_LINUX
+    IoUring ring;
+    if (!isEnabled() || !ring.init(pathsPerBatch)) {
+        return false;
+    }
+
+    return statAll(ring, AT_FDCWD, items.size(),
+                   [&](int i) { return QFile::encodeName(items.at(i).sourcePath); },
+                   [&](int i, int result, const struct statx& info) {
+        CopyPlan::Item& item = items[i];
+        if (result < 0) {
+            item.size = -1;
+            return;
+        }
+        item.size = qint64(info.stx_size);
+        item.mode = info.stx_mode;
+        item.inode = info.stx_ino;
+        item.device = quint64(makedev(info.stx_dev_major, info.stx_dev_minor));
+        item.links = info.stx_nlink;
+    });
+#else
+    Q_UNUSED(items);
+    return false;
+#endif
+}
+
+bool UringBackend::statEntries(int directoryFd, const QVector<QByteArray>& names, QVector<EntryStatus>& statuses) {
+#ifdef Q_OS_LINUX
+    // Directory walks call this once per directory from their pool threads,
+    // so every thread keeps its ring instead of setting one up each time.
+    thread_local std::unique_ptr<IoUring> ring;
+    if (!isEnabled()) {
+        return false;
+    }
+    if (!ring) {
+        ring.reset(new IoUring);
+        if (!ring->init(pathsPerBatch)) {
+            ring.reset();
+            return false;
+        }
+    }
+
+    statuses.fill(EntryStatus(), names.size());
+    bool done = statAll(*ring, directoryFd, names.size(),
+                        [&](int i) { return names.at(i); },
+                        [&](int i, int result, const struct statx& info) {
+        if (result < 0) {
+            return;
+        }
+        EntryStatus& status = statuses[i];
+        status.size = qint64(info.stx_size);
+        status.mode = info.stx_mode;
+        status.inode = info.stx_ino;
+        status.device = quint64(makedev(info.stx_dev_major, info.stx_dev_minor));
+        status.links = info.stx_nlink;
+        status.modified = qint64(info.stx_mtime.tv_sec);
+    });
+    if (!done) {
+        // Results of a failed submission may still arrive; a new ring starts
+        // without them.
+        ring.reset();
+    }
+    return done;
+#else
+    Q_UNUSED(directoryFd);
+    Q_UNUSED(names);
+    Q_UNUSED(statuses);
+    return false;
+#endif
+}
+
+bool UringBackend::copyFiles(const QVector<CopyPlan::Item>& items, QVector<bool>& copied) {
+    // The chains open files straight into slots with file_index, which
+    // headers without sparse file tables do not have either.
+#if defined(Q_OS_LINUX) && defined(IORING_RSRC_REGISTER_SPARSE)
+    copied.fill(false, items.size());
+
+    IoUring ring;
+    if (!isEnabled() || !ring.init(filesPerBatch * StepCount) || !ring.registerFileSlots(filesPerBatch * 2)) {
+        return false;
+    }
+
+    // One more byte than the limit is read so that a file that grew since
+    // it was planned is noticed instead of being cut short.
+    const qint64 slotSize = smallFileLimit + 1;
+    QByteArray buffers(filesPerBatch * slotSize, Qt::Uninitialized);
+    const mode_t creationMask = processUmask();
+
+    for (int start = 0; start < items.size(); start += filesPerBatch) {
+        const int count = qMin(filesPerBatch, int(items.size()) - start);
+        std::vector<QByteArray> sources(count);
+        std::vector<QByteArray> destinations(count);
+        std::vector<int> results(count * StepCount, -1);
+
+        for (int i = 0; i < count; ++i) {
+            const CopyPlan::Item& item = items.at(start + i);
+            const unsigned sourceSlot = unsigned(2 * i);
+            const unsigned destinationSlot = sourceSlot + 1;
+            char* buffer = buffers.data() + i * slotSize;
+            sources[i] = QFile::encodeName(item.sourcePath);
+            destinations[i] = QFile::encodeName(item.destinationPath);
+
+            // A source that cannot be opened cancels the rest of the chain,
+            // so no empty destination is left behind. After that, hard links
+            // keep the chain going past failed steps so both slots are always
+            // closed again; failures are read from the individual results.
+            // Direct descriptors are never inherited, and the kernel rejects
+            // O_CLOEXEC for them.
+            io_uring_sqe* entry = ring.nextEntry();
+            entry->opcode = IORING_OP_OPENAT;
+            entry->fd = AT_FDCWD;
+            entry->addr = reinterpret_cast<quint64>(sources[i].constData());
+            entry->open_flags = O_RDONLY;
+            entry->file_index = sourceSlot + 1;
+            entry->flags = IOSQE_IO_LINK;
+            entry->user_data = quint64(i) * StepCount + OpenSource;
+
+            entry = ring.nextEntry();
+            entry->opcode = IORING_OP_OPENAT;
+            entry->fd = AT_FDCWD;
+            entry->addr = reinterpret_cast<quint64>(destinations[i].constData());
+            entry->open_flags = O_WRONLY | O_CREAT | O_TRUNC;
+            entry->len = item.mode & 07777;
+            entry->file_index = destinationSlot + 1;
+            entry->flags = IOSQE_IO_HARDLINK;
+            entry->user_data = quint64(i) * StepCount + OpenDestination;
+
+            entry = ring.nextEntry();
+            entry->opcode = IORING_OP_READ;
+            entry->fd = int(sourceSlot);
+            entry->addr = reinterpret_cast<quint64>(buffer);
+            entry->len = unsigned(item.size + 1);
+            entry->off = 0;
+            entry->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            entry->user_data = quint64(i) * StepCount + Read;
+
+            entry = ring.nextEntry();
+            entry->opcode = IORING_OP_WRITE;
+            entry->fd = int(destinationSlot);
+            entry->addr = reinterpret_cast<quint64>(buffer);
+            entry->len = unsigned(item.size);
+            entry->off = 0;
+            entry->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            entry->user_data = quint64(i) * StepCount + Write;
+
+            entry = ring.nextEntry();
+            entry->opcode = IORING_OP_CLOSE;
+            entry->file_index = sourceSlot + 1;
+            entry->flags = IOSQE_IO_HARDLINK;
+            entry->user_data = quint64(i) * StepCount + CloseSource;
+
+            entry = ring.nextEntry();
+            entry->opcode = IORING_OP_CLOSE;
+            entry->file_index = destinationSlot + 1;
+            entry->user_data = quint64(i) * StepCount + CloseDestination;
+        }
+
+        bool drained = drain(ring, count * StepCount, [&](quint64 userData, int result) {
+            results[userData] = result;
+        });
+        if (!drained) {
+            return false;
+        }
+
+        for (int i = 0; i < count; ++i) {
+            const CopyPlan::Item& item = items.at(start + i);
+            const int* steps = &results[i * StepCount];
+            copied[start + i] = steps[OpenSource] >= 0 && steps[OpenDestination] >= 0
+                                && steps[Read] == item.size && steps[Write] == item.size
+                                && steps[CloseDestination] >= 0;
+
+            if (copied[start + i] && (item.mode & 07777 & creationMask)) {
+                ::chmod(destinations[i].constData(), item.mode & 07777);
+            }
+        }
+    }
+    return true;
+#else
+    Q_UNUSED(items);
+    Q_UNUSED(copied);
+    return false;
+#endif
+}
+
+bool UringBackend::removeTree(const QString& path) {
+#ifdef Q_OS_LINUX
+    IoUring ring;
+    if (!isEnabled() || !ring.init(pathsPerBatch)) {
+        return false;
+    }
+
+    QFileInfo info(path);
+    if (!info.isDir() || info.isSymLink()) {
+        return unlinkAll(ring, {info.absoluteFilePath()}, 0);
+    }
+
+    // Files can go all at once; directories only after everything below
+    // them, so they are removed one depth level at a time, deepest first.
+    QStringList files;
+    QVector<QStringList> directories;
+    collectTree(info.absoluteFilePath(), 0, files, directories);
+
+    bool removed = unlinkAll(ring, files, 0);
+    for (int depth = directories.size() - 1; depth >= 0 && removed; --depth) {
+        removed = unlinkAll(ring, directories.at(depth), AT_REMOVEDIR);
+    }
+    return removed;
+#else
+    Q_UNUSED(path);
+    return false;
+#endif
+}